@@ -0,0 +1,85 @@
+#if !defined __EPOCH_H__
+#define __EPOCH_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+
+// threads that can be pinned at the same time, more wait for a free slot
+#define EPOCH_READERS 64
+
+// epoch based reclamation. a reader pins the global epoch while it uses
+// published objects, an object that is replaced gets retired with the
+// epoch it was replaced in and is deleted once every reader pinned at or
+// before that epoch has unpinned. readers take no lock.
+class Epoch
+{
+public:
+  // pins nest, the outermost pin takes a reader slot
+  static void   pin();
+  static void   unpin();
+
+  // deletes _object once no pinned reader can still hold it
+  template< typename T >
+  static void   retire( const T* _object )
+  {
+    retire( _object, &destroy< T > );
+  }
+  static void   retire( const void* _object, void ( *_deleter )( const void* ) );
+
+  // deletes what no reader can still hold, returns what is left pending
+  static size_t collect();
+  static size_t pending();
+
+private:
+  template< typename T >
+  static void   destroy( const void* _object )
+  {
+    delete static_cast< const T* >( _object );
+  }
+};
+
+// pins the epoch for the enclosing scope
+class EpochGuard
+{
+public:
+  EpochGuard()  { Epoch::pin(); }
+  ~EpochGuard() { Epoch::unpin(); }
+
+private:
+  EpochGuard( const EpochGuard& );
+  EpochGuard& operator=( const EpochGuard& );
+};
+
+// an immutable object replaced as a whole. get() is only valid while
+// pinned, publish() can be called from any thread and retires the object
+// it replaces.
+template< typename T >
+class Published
+{
+public:
+  Published( void ) : m_current( 0 ) {}
+  // nothing may read it any more
+  ~Published( void ) { delete m_current.load(); }
+
+  const T* get() const { return m_current.load(); }
+
+  // takes ownership of _next, 0 empties it
+  void publish( const T* _next )
+  {
+    const T* previous = m_current.exchange( _next );
+
+    if ( previous )
+    {
+      Epoch::retire( previous );
+    }
+  }
+
+private:
+  Published( const Published& );
+  Published& operator=( const Published& );
+
+  std::atomic< const T* > m_current;
+};
+
+#endif // __EPOCH_H__
@@ -0,0 +1,77 @@
+#if !defined __FLOCK_KERNEL_H__
+#define __FLOCK_KERNEL_H__
+
+#include <cstddef>
+#include "cinder/Vector.h"
+
+// separation / alignment / cohesion forces of one particle against a span
+// of cell-sorted neighbors. the scalar path is the reference, the SSE4.1
+// and AVX2 paths handle 4 / 8 neighbors at once and are picked at runtime.
+class FlockKernel
+{
+public:
+  enum Mode
+  {
+    MODE_AUTO = 0,
+    MODE_SCALAR,
+    MODE_SSE41,
+    MODE_AVX2
+  };
+
+  struct Params
+  {
+    ci::Vec2f m_bounds;
+    float     m_zoneRadiusSqrd;
+    float     m_lowThresh;
+    float     m_highThresh;
+    float     m_repelStrength;
+    float     m_alignStrength;
+    float     m_attractStrength;
+    float     m_updateRatio;
+  };
+
+  // neighbor data, in the same (cell sorted) order
+  struct Neighbors
+  {
+    const float* m_x;
+    const float* m_y;
+    const float* m_dirX;
+    const float* m_dirY;
+  };
+
+  typedef void ( *Function )( const Params& _params, const Neighbors& _neighbors, size_t _begin, size_t _end, float _x, float _y, float& _accelerationX, float& _accelerationY );
+
+  // adds the forces of neighbors [_begin, _end) to _acceleration.
+  // the particle itself may be in the span, zero distances are skipped.
+  static inline void accumulate( const Params& _params, const Neighbors& _neighbors, size_t _begin, size_t _end, const ci::Vec2f& _position, ci::Vec2f& _acceleration )
+  {
+    s_function( _params, _neighbors, _begin, _end, _position.x, _position.y, _acceleration.x, _acceleration.y );
+  }
+
+  // MODE_AUTO picks the widest path the cpu supports. until the first
+  // select() the mode reads MODE_AUTO and the scalar path is used.
+  static void        select( Mode _mode = MODE_AUTO );
+  static Mode        mode() { return s_mode; }
+  static const char* modeName( Mode _mode );
+  static bool        isSupported( Mode _mode );
+
+  // cohesion alone toward _mass neighbors sharing one position, _offset
+  // being the particle minus that position. used for far away mass.
+  static void        cohesion( const Params& _params, const ci::Vec2f& _offset, float _mass, ci::Vec2f& _acceleration );
+
+  // runs the path of _mode against the scalar one on synthetic data, false
+  // when it is not supported
+  static bool        validate( Mode _mode, float _tolerance = 1e-4f );
+  // validates every supported path
+  static bool        validate( float _tolerance = 1e-4f );
+
+  static void        scalar( const Params& _params, const Neighbors& _neighbors, size_t _begin, size_t _end, float _x, float _y, float& _accelerationX, float& _accelerationY );
+  static void        sse41(  const Params& _params, const Neighbors& _neighbors, size_t _begin, size_t _end, float _x, float _y, float& _accelerationX, float& _accelerationY );
+  static void        avx2(   const Params& _params, const Neighbors& _neighbors, size_t _begin, size_t _end, float _x, float _y, float& _accelerationX, float& _accelerationY );
+
+private:
+  static Function    s_function;
+  static Mode        s_mode;
+};
+
+#endif // __FLOCK_KERNEL_H__
@@ -0,0 +1,75 @@
+#if !defined __FLOCK_PARAMS_H__
+#define __FLOCK_PARAMS_H__
+
+// everything a step reads that can be changed while the flocks run: the
+// emitter's flocking vars and the particle ratios. published as a whole,
+// so a step never sees half of an edit.
+struct FlockParams
+{
+  FlockParams() :
+    m_zoneRadiusSqrd( 75.0f * 75.0f ),
+    m_repelStrength( 0.04f ),
+    m_alignStrength( 0.04f ),
+    m_attractStrength( 0.02f ),
+    m_lowThresh( 0.125f ),
+    m_highThresh( 0.65f ),
+    m_mergeGroups( false ),
+    m_flockSlices( 0 ),
+    m_flockBudget( 0 ),
+    m_barnesHut( false ),
+    m_openingAngle( 0.5f ),
+    m_particleSizeRatio( 1.0f ),
+    m_particleSpeedRatio( 1.0f ),
+    m_dampness( 0.9f ),
+    m_colorRedirection( 1.0f ),
+    m_sampleRadius( 5.0f )
+  {
+  }
+
+  bool operator==( const FlockParams& _other ) const
+  {
+    return m_zoneRadiusSqrd     == _other.m_zoneRadiusSqrd     &&
+           m_repelStrength      == _other.m_repelStrength      &&
+           m_alignStrength      == _other.m_alignStrength      &&
+           m_attractStrength    == _other.m_attractStrength    &&
+           m_lowThresh          == _other.m_lowThresh          &&
+           m_highThresh         == _other.m_highThresh         &&
+           m_mergeGroups        == _other.m_mergeGroups        &&
+           m_flockSlices        == _other.m_flockSlices        &&
+           m_flockBudget        == _other.m_flockBudget        &&
+           m_barnesHut          == _other.m_barnesHut          &&
+           m_openingAngle       == _other.m_openingAngle       &&
+           m_particleSizeRatio  == _other.m_particleSizeRatio  &&
+           m_particleSpeedRatio == _other.m_particleSpeedRatio &&
+           m_dampness           == _other.m_dampness           &&
+           m_colorRedirection   == _other.m_colorRedirection   &&
+           m_sampleRadius       == _other.m_sampleRadius;
+  }
+
+  bool operator!=( const FlockParams& _other ) const
+  {
+    return !( *this == _other );
+  }
+
+  // ParticleEmitter
+  float m_zoneRadiusSqrd;
+  float m_repelStrength;
+  float m_alignStrength;
+  float m_attractStrength;
+  float m_lowThresh;
+  float m_highThresh;
+  bool  m_mergeGroups;
+  int   m_flockSlices;
+  int   m_flockBudget;
+  bool  m_barnesHut;
+  float m_openingAngle;
+
+  // Particle
+  float m_particleSizeRatio;
+  float m_particleSpeedRatio;
+  float m_dampness;
+  float m_colorRedirection;
+  float m_sampleRadius;
+};
+
+#endif // __FLOCK_PARAMS_H__
@@ -0,0 +1,75 @@
+#if !defined __FRAME_CAPTURE_H__
+#define __FRAME_CAPTURE_H__
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "cinder/Surface.h"
+#include "cinder/Filesystem.h"
+
+// writes captured frames to disk on encoder threads. frame buffers come
+// from a bounded pool and are recycled once written, so a slow disk pushes
+// back on the renderer instead of growing memory.
+class FrameCapture
+{
+public:
+  struct Stats
+  {
+    size_t              m_submitted;
+    size_t              m_written;
+    size_t              m_failed;
+    size_t              m_delayed;  // acquire() had to wait for a buffer
+    size_t              m_dropped;  // acquire() gave up, m_dropWhenFull only
+    size_t              m_pending;
+  };
+
+  // _frames bounds the buffers queued or being encoded
+  FrameCapture( size_t _encoders = 2, size_t _frames = 8 );
+  ~FrameCapture( void );
+
+  // a free _width x _height RGB buffer. when all of them are in flight it
+  // waits for one, or returns 0 if m_dropWhenFull is set.
+  ci::Surface* acquire( int _width, int _height );
+
+  // queues a buffer from acquire() to be written to _path, in submission
+  // order. _flip turns it upside down first (GL read backs).
+  void         submit( ci::Surface* _frame, const ci::fs::path& _path, bool _flip = false );
+
+  // hands a buffer from acquire() back unwritten
+  void         release( ci::Surface* _frame );
+
+  // waits until everything submitted is on disk
+  void         flush();
+
+  Stats        stats();
+  void         resetStats();
+
+  bool         m_dropWhenFull;
+
+private:
+  struct Job
+  {
+    ci::Surface*        m_frame;
+    ci::fs::path        m_path;
+    bool                m_flip;
+  };
+
+  void         encoderLoop();
+
+  std::vector< ci::Surface* >  m_frames;
+  std::vector< ci::Surface* >  m_free;
+  std::deque< Job >            m_jobs;
+  size_t                       m_maxFrames;
+  size_t                       m_encoding;
+  Stats                        m_stats;
+  bool                         m_stop;
+  std::mutex                   m_lock;
+  std::condition_variable      m_jobReady;
+  std::condition_variable      m_frameFree;
+  std::vector< std::thread >   m_encoders;
+};
+
+#endif // __FRAME_CAPTURE_H__
@@ -0,0 +1,131 @@
+#if !defined __FRAME_RING_H__
+#define __FRAME_RING_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// slots of a ring are kept by default, enough for a reader a frame behind
+#define FRAME_RING_SLOTS       4
+// the writer waits that long for a slot while a reader is attached, then
+// drops the frame and every frame after it until the reader moves again,
+// so a reader that died does not stall it
+#define FRAME_RING_WAIT_MS     1000
+// rows of a frame are padded to 4 bytes, like GL packs and unpacks them
+#define FRAME_RING_ROW_ALIGN   4
+// offset of the pixels in a slot, past its FrameHeader
+#define FRAME_RING_PIXELS      64
+
+// hands finished frames to another process through named shared memory,
+// without encoding or copying them. one writer and one reader: the writer
+// fills the slot at the head and moves the head, the reader reads the slot
+// at the tail and moves the tail. the indices are the only thing they
+// share, so neither takes a lock.
+//
+// the segment is a header of 4k, then the slots, every one a FrameHeader
+// and the packed 8 bit rgb rows of a frame of up to the ring's size. names
+// are plain words, "/name" under posix shm_open and "Local\name" on windows.
+class FrameRing
+{
+public:
+  enum Flags
+  {
+    // the rows go bottom up, as GL reads them back
+    FLAG_BOTTOM_UP = 1
+  };
+
+  // at the start of every slot, the pixels follow at FRAME_RING_PIXELS
+  struct FrameHeader
+  {
+    uint64_t          m_frameId;
+    // microseconds of the writer's steady clock, see now()
+    uint64_t          m_timestamp;
+    uint32_t          m_width;
+    uint32_t          m_height;
+    // bytes from one row to the next
+    uint32_t          m_stride;
+    uint32_t          m_flags;
+  };
+
+  struct Stats
+  {
+    size_t            m_written;
+    size_t            m_delayed;  // waited for the reader
+    size_t            m_dropped;  // no slot in time, or too large
+  };
+
+  FrameRing( void );
+  ~FrameRing( void );
+
+  // writer: a new segment of _slots frames of up to _width x _height,
+  // replacing any left over under _name
+  bool              create( const std::string& _name, int _width, int _height, size_t _slots = FRAME_RING_SLOTS );
+  // reader: attaches to the segment a writer created
+  bool              open( const std::string& _name );
+  // the writer marks the ring closed and takes the name away, so the
+  // reader knows to stop or to open it again. mappings stay until closed.
+  void              close();
+
+  bool              isOpen() const { return m_header != 0; }
+  bool              isWriter() const { return m_writer; }
+  // the writer closed the ring
+  bool              closed() const;
+
+  int               getWidth() const;
+  int               getHeight() const;
+  // largest stride a slot holds
+  size_t            getStride() const;
+  size_t            getSlots() const;
+
+  // writer. the pixels of the next free slot, at least getStride() x
+  // getHeight(), or 0 when the frame has to be dropped. waits for the
+  // reader unless m_dropWhenFull is set, there is no reader or the reader
+  // has not moved since the last wait timed out.
+  uint8_t*          beginWrite();
+  // publishes the slot beginWrite() returned
+  void              endWrite( uint64_t _frameId, int _width, int _height, uint32_t _flags = 0, uint64_t _timestamp = now() );
+
+  // reader. the oldest frame not read yet, or 0 when there is none. the
+  // slot is the reader's until endRead().
+  const FrameHeader* beginRead();
+  const uint8_t*    pixels( const FrameHeader* _frame ) const { return reinterpret_cast< const uint8_t* >( _frame ) + FRAME_RING_PIXELS; }
+  void              endRead();
+  // skips to the newest frame, for readers that only show the latest
+  void              skipToLatest();
+  // frames written and not read yet
+  size_t            pending() const;
+
+  Stats             stats() const { return m_stats; }
+  void              resetStats() { m_stats = Stats(); }
+
+  static uint64_t   now();
+
+  bool              m_dropWhenFull;
+
+private:
+  struct Header;
+
+  FrameRing( const FrameRing& );
+  FrameRing& operator=( const FrameRing& );
+
+  bool              map( size_t _size, bool _create );
+  uint8_t*          slot( uint64_t _index ) const;
+
+  std::string       m_name;
+  Header*           m_header;
+  size_t            m_size;
+  bool              m_writer;
+  bool              m_writing;
+  bool              m_reading;
+  // the reader let a wait time out at m_stalledTail, frames are dropped
+  // without waiting until its tail moves
+  bool              m_stalled;
+  uint64_t          m_stalledTail;
+  Stats             m_stats;
+
+#if defined _WIN32
+  void*             m_mapping;
+#endif
+};
+
+#endif // __FRAME_RING_H__
@@ -0,0 +1,112 @@
+#if !defined __FRAME_SOURCE_H__
+#define __FRAME_SOURCE_H__
+
+#include <cstdio>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "cinder/Vector.h"
+#include "cinder/Surface.h"
+#include "cinder/Filesystem.h"
+
+#include "ImageLoader.h"
+
+// frames prepared ahead of the one in use, the ring holds one more
+#define FRAME_SOURCE_RING 4
+
+class ThreadPool;
+
+// a moving reference: the images of a directory, or a YUV4MPEG2 or raw RGB
+// stream from a file or stdin. a decoder thread fits every frame and builds
+// its lookup tables into a ring of slots, stepping to the next frame only
+// moves an index.
+class FrameSource
+{
+public:
+  FrameSource( ThreadPool* _pool );
+  ~FrameSource( void );
+
+  // the directory's images in name order, starting over at the end when
+  // _loop is set
+  bool openDirectory( const ci::fs::path& _directory, const ci::Vec2i& _fitSize, bool _loop );
+  // YUV4MPEG2 (4:2:0, 4:2:2, 4:4:4 or mono, 8 bit), "-" reads stdin
+  bool openY4m( const ci::fs::path& _path, const ci::Vec2i& _fitSize );
+  // packed 8 bit RGB frames of _frameSize, "-" reads stdin
+  bool openRaw( const ci::fs::path& _path, const ci::Vec2i& _frameSize, const ci::Vec2i& _fitSize );
+  // picks the above by what _path is: a directory, a .y4m file or "-"
+  bool open( const ci::fs::path& _path, const ci::Vec2i& _fitSize, bool _loop );
+  // stops the decoder, it may finish reading the frame it is on first
+  void close();
+
+  // steps to the next prepared frame and hands the one in use back to the
+  // decoder. without one ready it keeps the current frame and returns
+  // false, unless m_blocking, where it waits for the decoder.
+  bool advance();
+  // frame in use, 0 before the first advance()
+  PreparedImage* current();
+
+  bool   isOpen() const { return m_source != SOURCE_NONE; }
+  // the stream ended and every frame was stepped through
+  bool   finished();
+  // frames stepped through, and steps that found none ready
+  size_t position() const { return m_position; }
+  size_t starved() const { return m_starved; }
+
+  // offline rendering waits for every frame instead of holding one
+  bool                      m_blocking;
+
+  // true when _path looks like something open() takes
+  static bool isStream( const ci::fs::path& _path );
+
+private:
+  enum Source
+  {
+    SOURCE_NONE,
+    SOURCE_DIRECTORY,
+    SOURCE_Y4M,
+    SOURCE_RAW
+  };
+
+  bool start( Source _source, const ci::Vec2i& _fitSize );
+  bool openFile( const ci::fs::path& _path );
+  void decoderLoop();
+  bool decode( PreparedImage& _slot );
+  bool readFrame();
+  void fitInto( const ci::Surface& _frame, ci::Surface& _fitted );
+
+  ThreadPool*               m_threadPool;
+  Source                    m_source;
+  ci::Vec2i                 m_fitSize;
+
+  // directory
+  std::vector< ci::fs::path > m_files;
+  size_t                    m_nextFile;
+  bool                      m_loop;
+
+  // streams, decoded at their own size before being fitted
+  FILE*                     m_file;
+  ci::Vec2i                 m_frameSize;
+  int                       m_chromaShiftX;
+  int                       m_chromaShiftY;
+  bool                      m_mono;
+  std::vector< uint8_t >    m_planes;
+  ci::Surface               m_decoded;
+
+  // m_slots[ m_current ] is in use, the m_filled after it are ready
+  PreparedImage             m_slots[ FRAME_SOURCE_RING ];
+  size_t                    m_current;
+  size_t                    m_filled;
+  bool                      m_started;
+  bool                      m_ended;
+  bool                      m_stop;
+  size_t                    m_position;
+  size_t                    m_starved;
+
+  std::mutex                m_lock;
+  std::condition_variable   m_wake;
+  std::condition_variable   m_ready;
+  std::thread               m_thread;
+};
+
+#endif // __FRAME_SOURCE_H__
@@ -0,0 +1,80 @@
+#if !defined __IMAGE_LOADER_H__
+#define __IMAGE_LOADER_H__
+
+#include <list>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "cinder/Vector.h"
+#include "cinder/Surface.h"
+#include "cinder/Filesystem.h"
+
+#include "SteeringField.h"
+#include "SummedAreaTable.h"
+
+class ThreadPool;
+
+// a decoded image, fitted and ready to be used as reference
+struct PreparedImage
+{
+  PreparedImage() : m_loaded( false ) {}
+
+  ci::fs::path          m_path;
+  ci::Surface           m_surface;
+  SteeringField         m_steeringField;
+  SummedAreaTable       m_summedAreaTable;
+  bool                  m_loaded;
+};
+
+// decodes, fits and builds the lookup tables of upcoming images on a
+// background thread, so swapping images does not stall the frame
+class ImageLoader
+{
+public:
+  ImageLoader( ThreadPool* _pool );
+  ~ImageLoader( void );
+
+  // keeps _paths prepared (in order, fitted into _fitSize) and forgets
+  // everything else
+  void   prefetch( const std::vector< ci::fs::path >& _paths, const ci::Vec2i& _fitSize );
+
+  // true when _path is prepared, loaded or not
+  bool   ready( const ci::fs::path& _path, const ci::Vec2i& _fitSize );
+
+  // hands _path over: waits for it if it is being prepared, or prepares it
+  // on the calling thread if it was never asked for. false if it failed.
+  bool   take( const ci::fs::path& _path, const ci::Vec2i& _fitSize, PreparedImage& _image );
+
+  // fits _image into _fitSize keeping its aspect, 0 x 0 keeps the size
+  static ci::Surface fitImage( const ci::Surface& _image, const ci::Vec2i& _fitSize );
+
+private:
+  enum State
+  {
+    STATE_QUEUED,
+    STATE_LOADING,
+    STATE_READY
+  };
+
+  struct Entry
+  {
+    PreparedImage       m_image;
+    ci::Vec2i           m_fitSize;
+    State               m_state;
+  };
+
+  void   loaderLoop();
+  void   prepare( const ci::fs::path& _path, const ci::Vec2i& _fitSize, PreparedImage& _image );
+  std::list< Entry >::iterator find( const ci::fs::path& _path, const ci::Vec2i& _fitSize );
+
+  ThreadPool*             m_threadPool;
+  std::list< Entry >      m_entries;
+  std::mutex              m_lock;
+  std::condition_variable m_wake;
+  std::condition_variable m_prepared;
+  bool                    m_stop;
+  std::thread             m_thread;
+};
+
+#endif // __IMAGE_LOADER_H__
@@ -3,83 +3,37 @@
 
 #include "cinder/Vector.h"
 #include "cinder/Surface.h"
+#include "ParticleStore.h"
+#include "FlockParams.h"
+#include "ReferenceImage.h"
 
 class ParticleEmitter;
+class SoftwareRasterizer;
 
+// particle behaviour, applied to ranges of a ParticleStore
 class Particle
 {
 public:
-  struct PointAccessFunctor
-  {
-    static inline ci::Vec2f& position( Particle* p )
-    {
-      return p->m_position;
-    }
-
-    static inline ci::Vec2f& stable_position( Particle* p )
-    {
-      return p->m_stablePosition;
-    }
-  }; 
-
-public:
-  Particle( ParticleEmitter* _owner, ci::Vec2f& _position, ci::Vec2f& _direction );
-
-  virtual ~Particle( void );
-
-  virtual void update( double _currentTime, double _delta );
-  virtual void draw( void );
-  virtual void debugDraw( void );
-  
-  ci::Vec2f&   position() { return m_position; }
+  static void   update( ParticleStore& _store, const ParticleRange& _range, const ReferenceImage& _reference, const FlockParams& _params, double _delta );
+  static void   rasterize( const ParticleStore& _store, const ParticleRange& _range, const ReferenceImage& _reference, const FlockParams& _params, const ci::Vec2f& _offset, float _interpolation, SoftwareRasterizer& _rasterizer );
+#if !defined FLOCKDRAW_HEADLESS
+  static void   draw( const ParticleStore& _store, const ParticleRange& _range, const ReferenceImage& _reference, const FlockParams& _params, const ci::Vec2f& _offset, float _interpolation );
+  static void   debugDraw( const ParticleStore& _store, const ParticleRange& _range, const ParticleEmitter& _owner );
+#endif
 
 protected:
-  void         limitSpeed();
-
+  static void   limitSpeed( ParticleStore& _store, size_t _index );
 
 public:
-  ci::Vec2f           m_position;
-  ci::Vec2f           m_stablePosition;
-  ci::Vec2f           m_direction;
-  ci::Vec2f           m_velocity;
-  ci::Vec2f           m_acceleration;
-
-  ci::ColorA          m_color;
-
-  float               m_maxSpeedSquared;
-  float               m_minSpeedSquared;
-  
-  double              m_spawnTime;
-  double              m_timeOfDeath;
-    
-  ci::Surface*        m_referenceSurface;
-
-  ParticleEmitter*    m_owner;
-
-  int                 m_group;
-  
-public:
+  // the ratios below are what the GUI edits, the emitter publishes them
+  // with its own vars and the particles read that copy
   static float        s_maxRadius;
   static float        s_particleSizeRatio;
   static float        s_particleSpeedRatio;
   static float        s_dampness;
   static float        s_colorRedirection;
-
-private:
-  // temporary variables to avoid construction every update
-  ci::Area            t_sourceArea;
-  ci::ColorA          t_color;
-  ci::Vec2f           t_tempDir;
-  float               t_angle;
-  ci::Vec2f           t_nextPos[ 3 ];
-  float               t_l[ 3 ];
-  ci::ColorA          t_currentColor;
-  ci::ColorA          t_c;
-
-  size_t              m_id;
-  static size_t       s_idGenerator;
-
-
+  // half size of the box a particle takes its color from, 0 for one pixel
+  static float        s_sampleRadius;
 };
 
-#endif // __PARTICLE_H__
\ No newline at end of file
+#endif // __PARTICLE_H__
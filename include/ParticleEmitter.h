@@ -2,19 +2,29 @@
 #define __PARTICLE_EMITTER_H__
 
 #include <vector>
-#include <thread>
-#include <mutex>
-#include <condition_variable>
-#include <atomic>
 #include <unordered_map>
 #include "cinder/Vector.h"
 #include "cinder/Surface.h"
 #include "cinder/gl/Texture.h"
+#include "cinder/Rand.h"
 
 #include "Particle.h"
+#include "ParticleStore.h"
+#include "SpatialGrid.h"
+#include "QuadTree.h"
+#include "FlockKernel.h"
+#include "ThreadPool.h"
+#include "SteeringField.h"
+#include "SummedAreaTable.h"
+#include "ReferenceImage.h"
+#include "ImageLoader.h"
+#include "FlockParams.h"
+#include "Epoch.h"
 
 
 class b2World;
+class SoftwareRasterizer;
+class FrameSource;
 
 class ParticleEmitter
 {
@@ -22,16 +32,68 @@ public:
   ParticleEmitter( void );
   virtual ~ParticleEmitter( void );
 
+  // spawns into the group's free slots first, the store only grows when
+  // the group has none left
   void addParticles( int _aumont, int _group = -1 );
   
+#if !defined FLOCKDRAW_HEADLESS
   virtual void draw( void );
   virtual void debugDraw( void );
+#endif
+  virtual void rasterize( SoftwareRasterizer& _rasterizer );
   virtual void update( double _currentTime, double _delta );
 
+  // fixed step clock: runs as many m_fixedStep updates as the time since
+  // the last frame covers, at most m_maxSubSteps (the rest of a slow frame
+  // is dropped), and draws the remainder as a fraction of a step.
+  // returns the steps taken.
+  int          advance( double _frameDelta );
+
+  // leaves groups [ 0, _groups ) with _count live particles each, spawning
+  // the missing ones and pooling the extra ones; other groups are pooled
+  void         populate( int _groups, int _count );
+  // keeps the live particles across an image change: their positions are
+  // scaled from the old reference size to the new one
+  void         retarget( const ci::Vec2f& _fromSize, const ci::Vec2f& _toSize );
+
+  // returns every particle to the pool, the store keeps its slots
   virtual void killAll();
+  // drops the pooled slots too
+  void         releasePool();
+
+  // live particles, and free slots waiting to be respawned into
+  size_t       liveCount() const;
+  size_t       pooledCount() const;
+
+  // every random draw of the emitter comes from m_rand. seeded, with a
+  // fixed delta, a run gives the same particles whatever the thread count.
+  void         seed( uint32_t _seed );
+  // FNV-1a of every live particle's state, groups in ascending order
+  uint64_t     stateHash() const;
 
-  std::unordered_map< int, std::vector< Particle* > > m_particles;
+  // a step reads its parameters and its reference from snapshots taken
+  // when it starts. these swap new ones in for the next step from any
+  // thread, without stopping the pool, and what they replace is freed
+  // once no step or draw holds it any more.
+  void         publishParams( const FlockParams& _params );
+  // takes ownership of _image, 0 goes back to m_referenceSurface and co.
+  // a frame source, while set, is used instead.
+  void         publishReference( const PreparedImage* _image );
+  // the flocking vars and the particle ratios as they are now. edits to
+  // them are published by the next update(), rasterize() or draw().
+  FlockParams  fieldParams() const;
+  // sets the vars from _params and publishes them, ratios included, without
+  // going through the Particle statics. emitters that run side by side with
+  // different ratios are set up this way.
+  void         applyParams( const FlockParams& _params );
+
+  // each group owns a slab of the store: its live particles in
+  // m_particles, followed by its free slots up to the end of the slab.
+  ParticleStore            m_store;
+  std::unordered_map< int, ParticleRange > m_particles;
   ci::Vec2f                m_position;
+  ci::Rand                 m_rand;
+  // particles live between min and max seconds, max 0 lives forever
   double                   m_maxLifeTime;
   double                   m_minLifeTime;
                            
@@ -44,31 +106,116 @@ public:
   float                    m_attractStrength;
   float                    m_lowThresh;
   float                    m_highThresh;
+  // flock every group with every other, as one
+  bool                     m_mergeGroups;
+  // a flock tick is spread over this many updates, every update flocks one
+  // interleaved slice of each group and scales its forces by the time since
+  // that slice was last flocked. 0 spreads it over m_updateFlockEvery, 1
+  // flocks everything at once every m_updateFlockEvery.
+  int                      m_flockSlices;
+  // most particles flocked by one update, more slices are used when the
+  // live particles do not fit. 0 has no limit.
+  int                      m_flockBudget;
+  // separation and alignment stay exact on the grid, cohesion toward mass
+  // farther than the alignment zone goes through a quadtree, whose nodes
+  // are taken as a whole when they look smaller than m_openingAngle
+  bool                     m_barnesHut;
+  float                    m_openingAngle;
                            
+  // used while no reference is published, only changed between steps
   ci::Surface*             m_referenceSurface;
+  // read instead of m_referenceSurface when set, the particles live at its
+  // full size
+  const TiledImage*        m_tiledImage;
+  // built for m_referenceSurface, or for m_tiledImage's overview, optional
+  const SteeringField*     m_steeringField;
+  const SummedAreaTable*   m_summedAreaTable;
+  // moving reference, optional: every update steps it one frame and points
+  // the three above at it
+  FrameSource*             m_frameSource;
   ci::gl::Texture*         m_screenTexture;
   ci::Surface              m_screenSurface;
 
+  double                   m_fixedStep;
+  int                      m_maxSubSteps;
+
+  // shared by default, survives killAll()
+  ThreadPool*              m_threadPool;
+
+  // wall time of the last flock tick and integration pass, in seconds
+  double                   m_flockSeconds;
+  double                   m_integrateSeconds;
+  size_t                   m_flockTicks;
+
   static bool              s_debugDraw;
 private:
-  void updateParticles( double _currentTime, double _delta, std::vector< Particle* >& _particles );
-  void threadProcessParticles( int _group );
-
-  std::vector< std::thread >  m_threads;
-  std::atomic< bool >         m_stop;
-  std::mutex                  m_startLock;
-  std::condition_variable     m_startCondition;
-  std::mutex                  m_doneLock;
-  std::condition_variable     m_doneCondition;
-  std::atomic< size_t >       m_processing;
+  // per group scratch for the flock tick. the grid's sorted positions and
+  // the directions below are the snapshot the forces are computed from,
+  // the store is only written to (own acceleration of each particle).
+  struct FlockScratch
+  {
+    ParticleRange            m_range;
+    // store slot of every particle, when they are gathered from several
+    // slabs, with their positions. empty when m_range is used as is.
+    std::vector< size_t >    m_slots;
+    std::vector< ci::Vec2f > m_positions;
+    SpatialGrid              m_grid;
+    // Barnes-Hut only
+    QuadTree                 m_tree;
+    std::vector< float >     m_dirX;
+    std::vector< float >     m_dirY;
+  };
+
+  // cell sorted slots [ m_begin, m_end ) of one group
+  struct FlockChunk
+  {
+    FlockScratch*          m_scratch;
+    size_t                 m_begin;
+    size_t                 m_end;
+  };
+
+  // what a step or a draw works on, the published image or the pointers.
+  // callers are pinned.
+  ReferenceImage reference() const;
+  void syncParams();
+
+  void retireParticles();
+  size_t flockSlices( double _delta ) const;
+  void updateFlock( float _updateRatio, size_t _slices, size_t _slice );
+  void buildFlockGroup( FlockScratch& _scratch );
+  void flockParticles( const FlockScratch& _scratch, size_t _begin, size_t _end, float _updateRatio, size_t _slices, size_t _slice );
+
+  // end of each group's slab, past its live range
+  std::unordered_map< int, size_t >       m_slabEnd;
+  std::vector< ParticleRange >            m_liveRanges;
+
+  std::unordered_map< int, FlockScratch > m_flockScratch;
+  FlockScratch                            m_mergedScratch;
+  std::vector< FlockScratch* >            m_flockGroups;
+  std::vector< FlockChunk >               m_flockChunks;
   
   double                      m_currentTime;
-  double                      m_delta;
+  double                      m_clockTime;
+  double                      m_clockAccumulator;
+  float                       m_interpolation;
 
   float                  m_particlesPerSecondLeftOver;
   double                 m_updateFlockEvery;
   double                 m_updateFlockTimer;
   double                 m_lastFlockUpdateTime;
+  // the next slice to flock, particles fall in the slice of their id
+  size_t                 m_flockSlice;
+  // ids of the emitter's particles, its own so that they do not depend on
+  // what other emitters spawn
+  size_t                 m_nextId;
+
+  Published< FlockParams >   m_params;
+  Published< PreparedImage > m_reference;
+  // the vars as last published by syncParams()
+  FlockParams            m_fieldParams;
+  // snapshots of the step being run, what its workers read
+  const FlockParams*     m_step;
+  ReferenceImage         m_stepReference;
 };
 
 #endif //__PARTICLE_EMITTER_H__
@@ -0,0 +1,58 @@
+#if !defined __PARTICLE_STORE_H__
+#define __PARTICLE_STORE_H__
+
+#include <vector>
+#include "cinder/Vector.h"
+
+// contiguous slice of the store, one per particle group
+struct ParticleRange
+{
+  ParticleRange( size_t _begin = 0, size_t _end = 0 ) :
+    m_begin( _begin ),
+    m_end( _end )
+  {
+  }
+
+  size_t size() const { return m_end - m_begin; }
+  bool   empty() const { return m_end == m_begin; }
+
+  size_t m_begin;
+  size_t m_end;
+};
+
+// structure-of-arrays particle storage: every field lives in its own
+// contiguous array, so the update loops only pull the fields they touch
+class ParticleStore
+{
+public:
+  ParticleStore( void );
+
+  size_t size() const { return m_position.size(); }
+
+  // opens _count zeroed slots at _at, moving everything after it
+  void   insert( size_t _at, size_t _count );
+  // overwrites slot _to with the particle in slot _from
+  void   copy( size_t _from, size_t _to );
+  void   clear();
+
+public:
+  // hot data, touched by every update
+  std::vector< ci::Vec2f > m_position;
+  std::vector< ci::Vec2f > m_velocity;
+  std::vector< ci::Vec2f > m_acceleration;
+  std::vector< ci::Vec2f > m_direction;
+  std::vector< float >     m_maxSpeedSquared;
+  std::vector< float >     m_minSpeedSquared;
+  // position before the last step, drawing interpolates from it
+  std::vector< ci::Vec2f > m_stablePosition;
+
+  // cold data
+  std::vector< int >       m_group;
+  std::vector< size_t >    m_id;
+  std::vector< double >    m_spawnTime;
+  std::vector< double >    m_timeOfDeath;
+  // when the particle was last flocked, -1 before its first flock
+  std::vector< double >    m_flockTime;
+};
+
+#endif // __PARTICLE_STORE_H__
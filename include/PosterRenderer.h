@@ -0,0 +1,54 @@
+#if !defined __POSTER_RENDERER_H__
+#define __POSTER_RENDERER_H__
+
+#include <deque>
+#include <vector>
+#include "cinder/Filesystem.h"
+
+#include "SoftwareRasterizer.h"
+
+// pixels of one band of rows, at most
+#define POSTER_BAND_PIXELS ( 4 * 1024 * 1024 )
+// splats kept at most, the oldest steps are dropped first
+#define POSTER_MAX_SPLATS  ( 8 * 1024 * 1024 )
+
+class ThreadPool;
+
+// renders the last steps of a run at a size no canvas could hold. the
+// splats of every step are recorded, older ones fade by the trail decay as
+// the trail buffer would have faded them, and the poster is drawn band of
+// rows after band of rows into a binary ppm.
+class PosterRenderer
+{
+public:
+  PosterRenderer( int _width, int _height, float _decay );
+
+  // for ParticleEmitter::rasterize(), it only records
+  SoftwareRasterizer& recorder() { return m_recorder; }
+  // the splats recorded since the last call are one step
+  void   endStep();
+
+  size_t splatCount() const { return m_splats.size() - m_first; }
+  size_t stepCount() const { return m_stepEnd.size(); }
+
+  bool   write( const ci::fs::path& _path, ThreadPool& _pool );
+
+private:
+  PosterRenderer( const PosterRenderer& );
+  PosterRenderer& operator=( const PosterRenderer& );
+
+  int                                      m_width;
+  int                                      m_height;
+  float                                    m_decay;
+  // steps older than this would not change a pixel
+  size_t                                   m_maxSteps;
+
+  SoftwareRasterizer                       m_recorder;
+  std::vector< SoftwareRasterizer::Splat > m_splats;
+  // splats before m_first belong to dropped steps
+  size_t                                   m_first;
+  // end of every kept step in m_splats, oldest first
+  std::deque< size_t >                     m_stepEnd;
+};
+
+#endif // __POSTER_RENDERER_H__
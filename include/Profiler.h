@@ -0,0 +1,131 @@
+#if !defined __PROFILER_H__
+#define __PROFILER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include "cinder/Filesystem.h"
+
+// events kept per thread, the oldest are overwritten
+#define PROFILER_RING_SIZE  8192
+// log2 histogram buckets, 1us to 32ms and over
+#define PROFILER_BUCKETS    16
+
+// per phase frame profiler. every thread records into its own ring, the
+// owner is the only writer so recording takes no lock. readers copy what
+// the rings hold and keep what was not overwritten while copying.
+// optionally reads cpu cycles and last level cache misses per event
+// (linux perf_event_open, where available).
+class Profiler
+{
+public:
+  enum Phase
+  {
+    PHASE_EMIT = 0,
+    PHASE_RETIRE,
+    PHASE_FLOCK,
+    PHASE_INTEGRATE,
+    // once per reference, the lookups of every step are part of integrate
+    PHASE_STEERING_BUILD,
+    PHASE_RASTERIZE,
+    PHASE_TRAIL,
+    PHASE_DRAW,
+    PHASE_PRESENT,
+    PHASE_CAPTURE,
+    PHASE_ENCODE,
+    PHASE_DECODE,
+    PHASE_WORKER_BUSY,
+    PHASE_WORKER_IDLE,
+    PHASE_COUNT
+  };
+
+  struct Event
+  {
+    uint64_t m_start;       // ns since the profiler started
+    uint64_t m_duration;    // ns
+    uint64_t m_cycles;      // 0 without counters
+    uint64_t m_cacheMisses;
+    int      m_phase;
+  };
+
+  // events of a phase still in the rings, over the last _window seconds
+  struct Summary
+  {
+    size_t   m_count;
+    double   m_totalMs;
+    double   m_meanMs;
+    double   m_p50Ms;
+    double   m_p95Ms;
+    double   m_maxMs;
+    uint64_t m_cycles;
+    uint64_t m_cacheMisses;
+    uint32_t m_histogram[ PROFILER_BUCKETS ];
+  };
+
+  static void        enable( bool _enabled );
+  static bool        enabled();
+
+  // returns false when the platform has no counters to read
+  static bool        enableCounters( bool _enabled );
+  static bool        countersEnabled();
+
+  // names the current thread in the trace
+  static void        setThreadName( const char* _name );
+
+  static uint64_t    now();
+  static void        record( Phase _phase, uint64_t _start, uint64_t _end, uint64_t _cycles = 0, uint64_t _cacheMisses = 0 );
+
+  // fills PHASE_COUNT summaries, one per phase
+  static void        summarize( double _window, Summary* _summaries );
+  // chrome://tracing json of everything in the rings
+  static bool        writeChromeTrace( const ci::fs::path& _path );
+  // forgets every recorded event
+  static void        reset();
+
+  static const char* phaseName( Phase _phase );
+
+  // current thread's counters, zero without them
+  static void        readCounters( uint64_t& _cycles, uint64_t& _cacheMisses );
+};
+
+// times the enclosing scope as one event of _phase
+class ProfileScope
+{
+public:
+  ProfileScope( Profiler::Phase _phase ) :
+    m_phase( _phase ),
+    m_active( Profiler::enabled() ),
+    m_cycles( 0 ),
+    m_cacheMisses( 0 )
+  {
+    if ( m_active )
+    {
+      Profiler::readCounters( m_cycles, m_cacheMisses );
+      m_start = Profiler::now();
+    }
+  }
+
+  ~ProfileScope()
+  {
+    if ( m_active )
+    {
+      uint64_t end         = Profiler::now();
+      uint64_t cycles      = 0;
+      uint64_t cacheMisses = 0;
+
+      Profiler::readCounters( cycles, cacheMisses );
+      Profiler::record( m_phase, m_start, end, cycles - m_cycles, cacheMisses - m_cacheMisses );
+    }
+  }
+
+private:
+  ProfileScope( const ProfileScope& );
+  ProfileScope& operator=( const ProfileScope& );
+
+  Profiler::Phase m_phase;
+  bool            m_active;
+  uint64_t        m_start;
+  uint64_t        m_cycles;
+  uint64_t        m_cacheMisses;
+};
+
+#endif // __PROFILER_H__
@@ -0,0 +1,166 @@
+#if !defined __QUAD_TREE_H__
+#define __QUAD_TREE_H__
+
+#include <vector>
+#include <algorithm>
+#include "cinder/Vector.h"
+
+// items per leaf, and the deepest a node goes (coincident items stop there)
+#define QUAD_TREE_LEAF_SIZE 16
+#define QUAD_TREE_MAX_DEPTH 16
+
+// Barnes-Hut quadtree over a toroidal (wrapping) area. every node keeps the
+// center of mass of its items, so a far away node can stand for all of them.
+class QuadTree
+{
+public:
+  struct Node
+  {
+    float    m_x0, m_y0, m_x1, m_y1;
+    float    m_massX, m_massY;   // center of mass
+    float    m_mass;             // items below the node
+    unsigned m_begin, m_end;     // tree sorted slots of the items
+    int      m_children[ 4 ];    // -1 when empty, all -1 for a leaf
+  };
+
+  QuadTree( void );
+
+  void build( const ci::Vec2f* _positions, size_t _count, const ci::Vec2f& _bounds );
+
+  // walks the nodes that may hold items between _innerRadius and
+  // _outerRadius of _position, nodes outside that band are skipped. a node
+  // whose size seen from _position is under _openingAngle calls
+  // _far( center, mass ), the items of the leaves that have to be opened
+  // call _near( begin, end ) with their tree sorted slots.
+  template< typename Near, typename Far >
+  void forEachInBand( const ci::Vec2f& _position, float _innerRadius, float _outerRadius, float _openingAngle, Near& _near, Far& _far ) const
+  {
+    if ( m_nodes.empty() )
+    {
+      return;
+    }
+
+    float innerSqrd = _innerRadius * _innerRadius;
+    float outerSqrd = _outerRadius * _outerRadius;
+    float angleSqrd = _openingAngle * _openingAngle;
+    int   stack[ 3 * QUAD_TREE_MAX_DEPTH + 4 ];
+    int   top       = 0;
+
+    stack[ top++ ] = 0;
+
+    while ( top > 0 )
+    {
+      const Node& node = m_nodes[ stack[ --top ] ];
+
+      // closest and farthest the node's items can be, across the wrap
+      float nearX, farX, nearY, farY;
+      axisRange( _position.x, node.m_x0, node.m_x1, m_bounds.x, nearX, farX );
+      axisRange( _position.y, node.m_y0, node.m_y1, m_bounds.y, nearY, farY );
+
+      float nearSqrd = nearX * nearX + nearY * nearY;
+      float farSqrd  = farX  * farX  + farY  * farY;
+
+      if ( nearSqrd >= outerSqrd || farSqrd < innerSqrd )
+      {
+        continue;
+      }
+
+      ci::Vec2f center( node.m_massX, node.m_massY );
+      float     size     = std::max( node.m_x1 - node.m_x0, node.m_y1 - node.m_y0 );
+
+      if ( size * size < angleSqrd * wrappedDelta( _position, center ).lengthSquared() )
+      {
+        _far( center, node.m_mass );
+        continue;
+      }
+
+      if ( node.m_children[ 0 ] < 0 && node.m_children[ 1 ] < 0 && node.m_children[ 2 ] < 0 && node.m_children[ 3 ] < 0 )
+      {
+        _near( static_cast< size_t >( node.m_begin ), static_cast< size_t >( node.m_end ) );
+        continue;
+      }
+
+      for ( int i = 0; i < 4; ++i )
+      {
+        if ( node.m_children[ i ] >= 0 )
+        {
+          stack[ top++ ] = node.m_children[ i ];
+        }
+      }
+    }
+  }
+
+  inline size_t size() const { return m_items.size(); }
+  inline size_t nodeCount() const { return m_nodes.size(); }
+
+  // item index stored at tree sorted slot _slot
+  inline size_t item( size_t _slot ) const { return m_items[ _slot ]; }
+
+  // item positions, in tree sorted order
+  inline const float* sortedX() const { return m_sortedX.empty() ? 0 : &m_sortedX[ 0 ]; }
+  inline const float* sortedY() const { return m_sortedY.empty() ? 0 : &m_sortedY[ 0 ]; }
+
+  inline const ci::Vec2f& bounds() const { return m_bounds; }
+
+  // shortest vector from _b to _a, taking the wrap into account
+  inline ci::Vec2f wrappedDelta( const ci::Vec2f& _a, const ci::Vec2f& _b ) const
+  {
+    ci::Vec2f delta = _a - _b;
+
+    if ( delta.x > m_halfBounds.x )
+    {
+      delta.x -= m_bounds.x;
+    }
+    else if ( delta.x < -m_halfBounds.x )
+    {
+      delta.x += m_bounds.x;
+    }
+
+    if ( delta.y > m_halfBounds.y )
+    {
+      delta.y -= m_bounds.y;
+    }
+    else if ( delta.y < -m_halfBounds.y )
+    {
+      delta.y += m_bounds.y;
+    }
+
+    return delta;
+  }
+
+private:
+  // distance range from _p to [ _lo, _hi ] along one wrapping axis. the
+  // far end always holds, the near end is 0 when the span reaches around
+  static inline void axisRange( float _p, float _lo, float _hi, float _size, float& _near, float& _far )
+  {
+    float half   = ( _hi - _lo ) * 0.5f;
+    float center = _lo + half - _p;
+
+    if ( center > _size * 0.5f )
+    {
+      center -= _size;
+    }
+    else if ( center < -_size * 0.5f )
+    {
+      center += _size;
+    }
+
+    center = center < 0.0f ? -center : center;
+    _far   = center + half;
+    _near  = _far <= _size * 0.5f && center > half ? center - half : 0.0f;
+  }
+
+  int  buildNode( size_t _begin, size_t _end, float _x0, float _y0, float _x1, float _y1, int _depth );
+
+  std::vector< Node >     m_nodes;
+  std::vector< size_t >   m_items;
+  std::vector< size_t >   m_scratch;
+  std::vector< float >    m_sortedX;
+  std::vector< float >    m_sortedY;
+  const ci::Vec2f*        m_positions;
+
+  ci::Vec2f               m_bounds;
+  ci::Vec2f               m_halfBounds;
+};
+
+#endif // __QUAD_TREE_H__
@@ -0,0 +1,54 @@
+#if !defined __REFERENCE_IMAGE_H__
+#define __REFERENCE_IMAGE_H__
+
+#include "cinder/Vector.h"
+#include "cinder/Color.h"
+#include "cinder/Surface.h"
+
+#include "TiledImage.h"
+#include "SteeringField.h"
+#include "SummedAreaTable.h"
+
+// what the particles read: the area they wrap in, the pixels they take
+// their color from, and the lookup tables they steer and average with. a
+// tiled image is read instead of the surface when set, its tables are
+// built on the overview and m_tableScale takes positions there.
+struct ReferenceImage
+{
+  ReferenceImage() :
+    m_surface( 0 ),
+    m_tiledImage( 0 ),
+    m_steeringField( 0 ),
+    m_summedAreaTable( 0 ),
+    m_tableScale( 1.0f )
+  {
+  }
+
+  bool       valid() const { return m_surface || m_tiledImage; }
+
+  ci::Vec2i  getSize() const
+  {
+    return m_tiledImage ? m_tiledImage->getSize() : m_surface->getSize();
+  }
+
+  ci::ColorA getPixel( const ci::Vec2f& _position ) const
+  {
+    ci::Vec2i position( static_cast< int >( _position.x ), static_cast< int >( _position.y ) );
+
+    if ( m_tiledImage )
+    {
+      return m_tiledImage->getPixel( position );
+    }
+
+    return m_surface->getPixel( position );
+  }
+
+  const ci::Surface*     m_surface;
+  const TiledImage*      m_tiledImage;
+  // optional
+  const SteeringField*   m_steeringField;
+  const SummedAreaTable* m_summedAreaTable;
+  float                  m_tableScale;
+};
+
+#endif // __REFERENCE_IMAGE_H__
@@ -0,0 +1,75 @@
+#if !defined __SOFTWARE_RASTERIZER_H__
+#define __SOFTWARE_RASTERIZER_H__
+
+#include <vector>
+#include <cstdint>
+#include "cinder/Vector.h"
+#include "cinder/Color.h"
+#include "cinder/Surface.h"
+
+class ThreadPool;
+
+// CPU stand-in for the few GL calls the particles use. the particles are
+// drawn into a premultiplied 16 bit RGBA trail buffer, which decays in
+// place and is resolved into an RGB surface the size of the output.
+class SoftwareRasterizer
+{
+public:
+  struct Splat
+  {
+    float            m_x;
+    float            m_y;
+    float            m_radius;
+    ci::ColorA       m_color;
+  };
+
+  SoftwareRasterizer( int _width, int _height );
+
+  void               clear( const ci::Color& _color );
+
+  // takes _rate of every pixel away, towards black. 16 bits keep the faint
+  // trails fading where 8 bits would round them to a stuck value.
+  void               decay( float _rate, ThreadPool& _pool );
+
+  // converts the trail buffer into the surface getSurface() returns
+  void               resolve( ThreadPool& _pool );
+  // the same into packed 8 bit rgb rows _stride bytes apart, for frames
+  // that go straight into memory someone else owns
+  void               resolve( ThreadPool& _pool, uint8_t* _rgb, size_t _stride );
+
+  // anti aliased circle, drawn right away
+  void               drawSolidCircle( const ci::Vec2f& _center, float _radius, const ci::ColorA& _color );
+
+  // batched circles: queued in draw order, then binned into tiles and
+  // rasterized one tile per task. the result is the same as drawing them
+  // one by one.
+  void               addSplat( const ci::Vec2f& _center, float _radius, const ci::ColorA& _color );
+  void               flushSplats( ThreadPool& _pool );
+  // while recording, flushSplats() appends the queued splats to _splats
+  // instead of drawing them, to be drawn later into canvases that hold a
+  // part of a much larger output. 0 draws again.
+  void               record( std::vector< Splat >* _splats ) { m_recording = _splats; }
+
+  // as of the last resolve()
+  const ci::Surface& getSurface() const { return m_surface; }
+  ci::Vec2i          getSize() const { return m_surface.getSize(); }
+
+private:
+  void               drawSplat( const Splat& _splat, int _x0, int _y0, int _x1, int _y1 );
+  void               resolve( ThreadPool& _pool, uint8_t* _rgb, size_t _stride, uint8_t _inc, const uint8_t* _offsets );
+  void               resolveRows( int _begin, int _end, uint8_t* _rgb, size_t _stride, uint8_t _inc, const uint8_t* _offsets );
+
+  ci::Surface        m_surface;
+  // r, g, b, alpha per pixel, row after row
+  std::vector< uint16_t > m_trail;
+
+  std::vector< Splat >    m_splats;
+  std::vector< uint32_t > m_tileStart;
+  std::vector< uint32_t > m_tileFill;
+  std::vector< uint32_t > m_tileSplats;
+  int                     m_tilesX;
+  int                     m_tilesY;
+  std::vector< Splat >*   m_recording;
+};
+
+#endif // __SOFTWARE_RASTERIZER_H__
@@ -0,0 +1,137 @@
+#if !defined __SPATIAL_GRID_H__
+#define __SPATIAL_GRID_H__
+
+#include <vector>
+#include "cinder/Vector.h"
+
+// uniform grid over a toroidal (wrapping) area, used for the flocking
+// neighbor search. cells are at least _cellSize wide, so every neighbor
+// within _cellSize of a point lives in the 3x3 cells around it.
+class SpatialGrid
+{
+public:
+  SpatialGrid( void );
+
+  void build( const ci::Vec2f* _positions, size_t _count, const ci::Vec2f& _bounds, float _cellSize );
+
+  // calls _visitor( begin, end ) for every run of cell sorted slots in the
+  // cells around _position. cells that are adjacent in a row are merged.
+  template< typename Visitor >
+  void forEachNeighborSpan( const ci::Vec2f& _position, Visitor& _visitor ) const
+  {
+    if ( m_cellItems.empty() )
+    {
+      return;
+    }
+
+    int cellX  = wrapCell( static_cast< int >( _position.x / m_cellWidth  ), m_cellsX );
+    int cellY  = wrapCell( static_cast< int >( _position.y / m_cellHeight ), m_cellsY );
+
+    // with less than 3 cells in an axis the wrapped neighbors would repeat
+    int rangeX = m_cellsX < 3 ? m_cellsX : 3;
+    int rangeY = m_cellsY < 3 ? m_cellsY : 3;
+    int startX = rangeX == 3 ? -1 : 0;
+    int startY = rangeY == 3 ? -1 : 0;
+
+    for ( int y = startY; y < startY + rangeY; ++y )
+    {
+      int    rowOffset = wrapCell( cellY + y, m_cellsY ) * m_cellsX;
+      size_t spanBegin = 0;
+      size_t spanEnd   = 0;
+
+      for ( int x = startX; x < startX + rangeX; ++x )
+      {
+        int cell = rowOffset + wrapCell( cellX + x, m_cellsX );
+
+        if ( spanBegin == spanEnd || m_cellStart[ cell ] != spanEnd )
+        {
+          if ( spanBegin != spanEnd )
+          {
+            _visitor( spanBegin, spanEnd );
+          }
+          spanBegin = m_cellStart[ cell ];
+        }
+        spanEnd = m_cellStart[ cell + 1 ];
+      }
+
+      if ( spanBegin != spanEnd )
+      {
+        _visitor( spanBegin, spanEnd );
+      }
+    }
+  }
+
+  // calls _visitor( index ) for every item in the cells around _position
+  template< typename Visitor >
+  void forEachNeighbor( const ci::Vec2f& _position, Visitor& _visitor ) const
+  {
+    auto items = [ & ]( size_t _begin, size_t _end )
+    {
+      for ( ; _begin != _end; ++_begin )
+      {
+        _visitor( m_cellItems[ _begin ] );
+      }
+    };
+
+    forEachNeighborSpan( _position, items );
+  }
+
+  // item index stored at cell sorted slot _slot
+  inline size_t item( size_t _slot ) const { return m_cellItems[ _slot ]; }
+  inline size_t size() const { return m_cellItems.size(); }
+
+  // item positions, in cell sorted order
+  inline const float* sortedX() const { return m_sortedX.empty() ? 0 : &m_sortedX[ 0 ]; }
+  inline const float* sortedY() const { return m_sortedY.empty() ? 0 : &m_sortedY[ 0 ]; }
+
+  inline const ci::Vec2f& bounds() const { return m_bounds; }
+
+  // shortest vector from _b to _a, taking the wrap into account
+  inline ci::Vec2f wrappedDelta( const ci::Vec2f& _a, const ci::Vec2f& _b ) const
+  {
+    ci::Vec2f delta = _a - _b;
+
+    if ( delta.x > m_halfBounds.x )
+    {
+      delta.x -= m_bounds.x;
+    }
+    else if ( delta.x < -m_halfBounds.x )
+    {
+      delta.x += m_bounds.x;
+    }
+
+    if ( delta.y > m_halfBounds.y )
+    {
+      delta.y -= m_bounds.y;
+    }
+    else if ( delta.y < -m_halfBounds.y )
+    {
+      delta.y += m_bounds.y;
+    }
+
+    return delta;
+  }
+
+private:
+  static inline int wrapCell( int _cell, int _cells )
+  {
+    _cell %= _cells;
+    return _cell < 0 ? _cell + _cells : _cell;
+  }
+
+  std::vector< size_t > m_cellStart;
+  std::vector< size_t > m_cellItems;
+  std::vector< size_t > m_cellFill;
+  std::vector< int >    m_itemCell;
+  std::vector< float >  m_sortedX;
+  std::vector< float >  m_sortedY;
+
+  ci::Vec2f             m_bounds;
+  ci::Vec2f             m_halfBounds;
+  int                   m_cellsX;
+  int                   m_cellsY;
+  float                 m_cellWidth;
+  float                 m_cellHeight;
+};
+
+#endif // __SPATIAL_GRID_H__
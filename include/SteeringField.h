@@ -0,0 +1,43 @@
+#if !defined __STEERING_FIELD_H__
+#define __STEERING_FIELD_H__
+
+#include <vector>
+#include <cstdint>
+#include "cinder/Vector.h"
+#include "cinder/Surface.h"
+
+class ThreadPool;
+
+// per pixel direction of least color change of a reference image, from the
+// smoothed structure tensor of its Sobel gradients. replaces probing the
+// surface around every particle on every update.
+class SteeringField
+{
+public:
+  SteeringField( void );
+
+  void  build( const ci::Surface& _surface, ThreadPool& _pool );
+  void  clear();
+  void  swap( SteeringField& _other );
+  bool  empty() const { return m_field.empty(); }
+
+  // unit isophote direction at _position (its sign is arbitrary), or zero
+  // where the image is flat
+  inline ci::Vec2f direction( const ci::Vec2f& _position ) const
+  {
+    int x = static_cast< int >( _position.x );
+    int y = static_cast< int >( _position.y );
+    x     = x < 0 ? 0 : ( x >= m_width  ? m_width  - 1 : x );
+    y     = y < 0 ? 0 : ( y >= m_height ? m_height - 1 : y );
+
+    const int8_t* t = &m_field[ ( static_cast< size_t >( y ) * m_width + x ) * 2 ];
+    return ci::Vec2f( t[ 0 ], t[ 1 ] ) * ( 1.0f / 127.0f );
+  }
+
+private:
+  std::vector< int8_t > m_field;
+  int                   m_width;
+  int                   m_height;
+};
+
+#endif // __STEERING_FIELD_H__
@@ -0,0 +1,37 @@
+#if !defined __SUMMED_AREA_TABLE_H__
+#define __SUMMED_AREA_TABLE_H__
+
+#include <vector>
+#include <cstdint>
+#include "cinder/Vector.h"
+#include "cinder/Color.h"
+#include "cinder/Surface.h"
+
+class ThreadPool;
+
+// running sums of red, green, blue and luminance over a reference image,
+// so the average of any box costs four lookups whatever its size
+class SummedAreaTable
+{
+public:
+  SummedAreaTable( void );
+
+  void  build( const ci::Surface& _surface, ThreadPool& _pool );
+  void  clear();
+  void  swap( SummedAreaTable& _other );
+  bool  empty() const { return m_sums.empty(); }
+
+  // average color and luminance of the box of half size _radius around
+  // _position, clipped to the image
+  void  average( const ci::Vec2f& _position, float _radius, ci::ColorA& _color, float& _luminance ) const;
+
+private:
+  // ( width + 1 ) x ( height + 1 ) entries of 4 sums, the first row and
+  // column are zero. the sums wrap around, but the box differences are
+  // exact as long as one box holds less than 2^32 / 255 pixels.
+  std::vector< uint32_t > m_sums;
+  int                     m_width;
+  int                     m_height;
+};
+
+#endif // __SUMMED_AREA_TABLE_H__
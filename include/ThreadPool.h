@@ -0,0 +1,77 @@
+#if !defined __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// worker count that sizes a pool to the hardware
+#define THREAD_POOL_HARDWARE ( ~static_cast< size_t >( 0 ) )
+
+// fixed size work-stealing pool. every worker owns a deque: it pops its own
+// work from the back and steals from the front of the others when idle.
+// the thread waiting on a batch runs queued work too, so batches can be
+// started from inside other batches.
+class ThreadPool
+{
+public:
+  typedef std::function< void ( size_t _begin, size_t _end ) > RangeFunction;
+
+  // THREAD_POOL_HARDWARE sizes the pool to the hardware, counting the
+  // caller. with 0 workers batches run on the caller alone.
+  ThreadPool( size_t _workers = THREAD_POOL_HARDWARE );
+  ~ThreadPool( void );
+
+  // threads that take part in a batch: the workers plus the caller
+  size_t concurrency() const { return m_workers.size() + 1; }
+
+  // runs _function over [ _begin, _end ) split in chunks of _grain items,
+  // returns once every chunk is done
+  void   parallelFor( size_t _begin, size_t _end, size_t _grain, const RangeFunction& _function );
+
+  // process wide pool, created on first use (from the main thread)
+  static ThreadPool& shared();
+
+private:
+  struct Batch
+  {
+    std::atomic< size_t >   m_remaining;
+    std::mutex              m_lock;
+    std::condition_variable m_done;
+  };
+
+  struct Job
+  {
+    const RangeFunction*    m_function;
+    size_t                  m_begin;
+    size_t                  m_end;
+    Batch*                  m_batch;
+  };
+
+  struct Queue
+  {
+    std::mutex              m_lock;
+    std::deque< Job >       m_jobs;
+  };
+
+  void   workerLoop( size_t _index );
+  void   push( size_t _queue, const Job& _job );
+  bool   pop( size_t _queue, Job& _job );
+  bool   steal( size_t _thief, Job& _job );
+  bool   runOne( size_t _queue );
+  void   run( const Job& _job );
+
+  std::vector< std::thread >  m_workers;
+  std::vector< Queue* >       m_queues;
+  std::atomic< size_t >       m_pending;
+  std::atomic< size_t >       m_nextQueue;
+  std::atomic< bool >         m_stop;
+  std::mutex                  m_sleepLock;
+  std::condition_variable     m_wake;
+};
+
+#endif // __THREAD_POOL_H__
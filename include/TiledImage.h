@@ -0,0 +1,159 @@
+#if !defined __TILED_IMAGE_H__
+#define __TILED_IMAGE_H__
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include "cinder/Vector.h"
+#include "cinder/Color.h"
+#include "cinder/Surface.h"
+#include "cinder/Filesystem.h"
+
+// side of a tile, a power of two. 8 bit rgb tiles of 256 are 3 x 64k, so
+// every tile starts on a mapping boundary on every platform.
+#define TILED_IMAGE_TILE_SHIFT 8
+#define TILED_IMAGE_TILE_SIZE  ( 1 << TILED_IMAGE_TILE_SHIFT )
+// the header takes the first 64k for the same reason
+#define TILED_IMAGE_HEADER     65536
+// longest side of the overview the lookup tables are built from
+#define TILED_IMAGE_OVERVIEW   2048
+// tiles mapped at once by default, 48MB
+#define TILED_IMAGE_CACHE      256
+
+// a reference image far larger than memory: an .ftl file of 8 bit rgb
+// tiles followed by a small overview of the whole image. pixels are read
+// through a cache of memory mapped tiles, the least recently used one is
+// unmapped when the cache is full. lookups only take a lock on a miss, the
+// tiles they hand out are unmapped through Epoch, so readers are pinned.
+class TiledImage
+{
+public:
+  TiledImage( void );
+  ~TiledImage( void );
+
+  bool open( const ci::fs::path& _path, size_t _cacheTiles = TILED_IMAGE_CACHE );
+  void close();
+
+  bool isOpen() const { return m_tiles != 0; }
+
+  ci::Vec2i getSize() const { return ci::Vec2i( m_width, m_height ); }
+
+  // clamped to the image, like ci::Surface::getPixel(). callers are pinned.
+  inline ci::ColorA getPixel( const ci::Vec2i& _position ) const
+  {
+    int x = _position.x < 0 ? 0 : ( _position.x >= m_width  ? m_width  - 1 : _position.x );
+    int y = _position.y < 0 ? 0 : ( _position.y >= m_height ? m_height - 1 : _position.y );
+
+    size_t         index = static_cast< size_t >( y >> TILED_IMAGE_TILE_SHIFT ) * m_tilesX + ( x >> TILED_IMAGE_TILE_SHIFT );
+    const uint8_t* tile  = m_tiles[ index ].load();
+
+    if ( !tile )
+    {
+      tile = loadTile( index );
+    }
+    else if ( m_lastUse[ index ].load( std::memory_order_relaxed ) != m_clock.load( std::memory_order_relaxed ) )
+    {
+      m_lastUse[ index ].store( m_clock.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+    }
+
+    const uint8_t* pixel = tile + ( ( ( y & ( TILED_IMAGE_TILE_SIZE - 1 ) ) << TILED_IMAGE_TILE_SHIFT ) + ( x & ( TILED_IMAGE_TILE_SIZE - 1 ) ) ) * 3;
+    return ci::ColorA( pixel[ 0 ] / 255.0f, pixel[ 1 ] / 255.0f, pixel[ 2 ] / 255.0f, 1.0f );
+  }
+
+  // the whole image shrunk to TILED_IMAGE_OVERVIEW, and its size over the
+  // image's, to build the steering field and the summed area table from
+  const ci::Surface& overview() const { return m_overview; }
+  float              overviewScale() const { return m_overviewScale; }
+
+  // tiles mapped now, at most, and mapped since open()
+  size_t resident() const;
+  size_t peakResident() const { return m_peakResident; }
+  size_t misses() const { return m_misses; }
+
+  // writes _source as an .ftl, a row at a time: packed 8 bit rgb of
+  // _rawSize from a file or "-" for stdin when _rawSize is set, otherwise
+  // any image cinder loads (which has to fit in memory once)
+  static bool create( const ci::fs::path& _source, const ci::fs::path& _destination, const ci::Vec2i& _rawSize );
+
+private:
+  struct Mapping;
+
+  TiledImage( const TiledImage& );
+  TiledImage& operator=( const TiledImage& );
+
+  const uint8_t* loadTile( size_t _index ) const;
+  Mapping*       map( uint64_t _offset, size_t _size ) const;
+
+  int                                 m_width;
+  int                                 m_height;
+  size_t                              m_tilesX;
+  size_t                              m_tilesY;
+  ci::Surface                         m_overview;
+  float                               m_overviewScale;
+
+#if defined _WIN32
+  void*                               m_file;
+  void*                               m_fileMapping;
+#else
+  int                                 m_file;
+#endif
+
+  // per tile: its pixels while mapped, the mapping to unmap, and the
+  // clock of its last lookup
+  std::atomic< const uint8_t* >*      m_tiles;
+  mutable std::vector< Mapping* >     m_mappings;
+  std::atomic< uint32_t >*            m_lastUse;
+  mutable std::atomic< uint32_t >     m_clock;
+
+  size_t                              m_cacheTiles;
+  mutable std::vector< size_t >       m_resident;
+  mutable size_t                      m_peakResident;
+  mutable size_t                      m_misses;
+  mutable std::mutex                  m_lock;
+};
+
+// builds an .ftl out of rows handed over in order, keeping one row of
+// tiles and one row of the overview in memory
+class TiledImageWriter
+{
+public:
+  TiledImageWriter( void );
+  ~TiledImageWriter( void );
+
+  bool open( const ci::fs::path& _path, int _width, int _height );
+  // _width packed 8 bit rgb pixels
+  bool addRow( const uint8_t* _rgb );
+  // fails when rows are missing or could not be written, the header that
+  // makes the file a valid .ftl is only written when none are
+  bool close();
+
+private:
+  TiledImageWriter( const TiledImageWriter& );
+  TiledImageWriter& operator=( const TiledImageWriter& );
+
+  bool flushBand();
+  void flushOverviewRow();
+
+  FILE*                   m_file;
+  int                     m_width;
+  int                     m_height;
+  int                     m_row;
+  // a band could not be written
+  bool                    m_failed;
+  size_t                  m_tilesX;
+  // the rows of the current row of tiles, tile after tile
+  std::vector< uint8_t >  m_band;
+
+  int                     m_overviewWidth;
+  int                     m_overviewHeight;
+  int                     m_overviewRow;
+  // overview column of every image column
+  std::vector< int >      m_overviewColumn;
+  std::vector< uint32_t > m_overviewSums;
+  std::vector< uint32_t > m_overviewCounts;
+  std::vector< uint8_t >  m_overview;
+};
+
+#endif // __TILED_IMAGE_H__
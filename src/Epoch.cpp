@@ -0,0 +1,141 @@
+#include "Epoch.h"
+
+#include <vector>
+#include <mutex>
+#include <thread>
+
+#if defined _MSC_VER
+#define THREAD_LOCAL __declspec( thread )
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+namespace
+{
+  struct Retired
+  {
+    const void* m_object;
+    void     ( *m_deleter )( const void* );
+    uint64_t    m_epoch;
+  };
+
+  // starts at 1, a slot holding 0 is free
+  std::atomic< uint64_t > s_epoch( 1 );
+  std::atomic< uint64_t > s_readers[ EPOCH_READERS ];
+  std::atomic< size_t >   s_pending( 0 );
+  std::mutex              s_retiredLock;
+  std::vector< Retired >  s_retired;
+
+  THREAD_LOCAL size_t     t_depth = 0;
+  THREAD_LOCAL size_t     t_slot  = 0;
+}
+
+void Epoch::pin()
+{
+  if ( t_depth++ > 0 )
+  {
+    return;
+  }
+
+  // the slot is announced before anything published is loaded, a writer
+  // that misses it retired what it replaced before this epoch was read
+  for ( ;; )
+  {
+    uint64_t epoch = s_epoch.load();
+
+    for ( size_t i = 0; i < EPOCH_READERS; ++i )
+    {
+      uint64_t expected = 0;
+
+      if ( s_readers[ i ].load() == 0 && s_readers[ i ].compare_exchange_strong( expected, epoch ) )
+      {
+        t_slot = i;
+        return;
+      }
+    }
+
+    std::this_thread::yield();
+  }
+}
+
+void Epoch::unpin()
+{
+  if ( --t_depth > 0 )
+  {
+    return;
+  }
+
+  s_readers[ t_slot ].store( 0 );
+
+  if ( s_pending.load() > 0 )
+  {
+    collect();
+  }
+}
+
+void Epoch::retire( const void* _object, void ( *_deleter )( const void* ) )
+{
+  Retired retired;
+  retired.m_object  = _object;
+  retired.m_deleter = _deleter;
+  retired.m_epoch   = s_epoch.fetch_add( 1 );
+
+  {
+    std::lock_guard< std::mutex > lock( s_retiredLock );
+    s_retired.push_back( retired );
+    s_pending.store( s_retired.size() );
+  }
+
+  collect();
+}
+
+size_t Epoch::collect()
+{
+  // readers pinned before an object was retired may still hold it
+  uint64_t oldest = s_epoch.load();
+
+  for ( size_t i = 0; i < EPOCH_READERS; ++i )
+  {
+    uint64_t epoch = s_readers[ i ].load();
+
+    if ( epoch != 0 && epoch < oldest )
+    {
+      oldest = epoch;
+    }
+  }
+
+  std::vector< Retired > expired;
+
+  {
+    std::lock_guard< std::mutex > lock( s_retiredLock );
+
+    for ( size_t i = 0; i < s_retired.size(); )
+    {
+      if ( s_retired[ i ].m_epoch < oldest )
+      {
+        expired.push_back( s_retired[ i ] );
+        s_retired[ i ] = s_retired.back();
+        s_retired.pop_back();
+      }
+      else
+      {
+        ++i;
+      }
+    }
+
+    s_pending.store( s_retired.size() );
+  }
+
+  // deleters run outside the lock, they may retire more
+  for ( size_t i = 0; i < expired.size(); ++i )
+  {
+    expired[ i ].m_deleter( expired[ i ].m_object );
+  }
+
+  return s_pending.load();
+}
+
+size_t Epoch::pending()
+{
+  return s_pending.load();
+}
@@ -9,6 +9,12 @@
 #include "cinder/ip/Resize.h"
 #include "cinder/Utilities.h"
 #include "ParticleEmitter.h"
+#include "ImageLoader.h"
+#include "FrameSource.h"
+#include "FrameCapture.h"
+#include "FrameRing.h"
+#include "SoftwareRasterizer.h"
+#include "Profiler.h"
 #include "SimpleGUI.h"
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -17,6 +23,12 @@
 #define SGUI_CONFIG_FILE_EXT "cfg"
 #define FRAMERATE            60.0f
 #define VIDEO_FRAMERATE      30.0f
+#define CAPTURE_ENCODERS     2
+#define CAPTURE_FRAMES       8
+#define FRAME_RING_NAME      "FlockDraw"
+#define MAX_SUB_STEPS        4
+#define PROFILER_WINDOW      2.0
+#define PROFILER_REFRESH     0.5
 #define WINDOWED
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -34,6 +46,7 @@ class CinderApp : public ci::app::AppNative
 {
 public:
 	void setup();
+  void shutdown();
 	
   // mouse events
   void mouseDown( ci::app::MouseEvent     _event );	
@@ -49,6 +62,14 @@ public:
 	// misc routines
   void updateOutputArea( ci::Vec2i& _imageSize );
   void setImage( ci::fs::path& _path, double _currentTime = 0.0 );
+  bool openStream( const ci::fs::path& _path );
+  void startStream();
+  void closeStream();
+  void prefetchImages();
+  void captureFrame();
+  void exportFrame();
+  void drawSplats();
+  void drawProfiler();
 
   // main routines
   void update();
@@ -57,15 +78,26 @@ public:
 
 
   // properties
+  // shares its pixels with the image published to the emitter
   ci::Surface                 m_surface;
   ci::gl::Texture             m_texture;
   ci::Area                    m_outputArea;
   ParticleEmitter             m_particleEmitter;
   ci::gl::Fbo                 m_frameBufferObject;
+  bool                        m_cpuSplats;
+  float                       m_trailDecay;
+  SoftwareRasterizer*         m_splatCanvas;
+  ci::gl::Texture             m_splatTexture;
   std::vector< ci::fs::path > m_files;
   double                      m_cycleImageEvery;
+  int                         m_prefetchDepth;
+  ImageLoader*                m_imageLoader;
+  // a directory or y4m stream driving the flocks instead of the images
+  FrameSource*                m_frameSource;
+  bool                        m_streamStarted;
   int                         m_particleCount;
   int                         m_particleGroups;
+  bool                        m_keepParticles;
   
   sgui::SimpleGUI*            m_gui;
   sgui::ButtonControl*        m_openImageButton;
@@ -76,16 +108,25 @@ public:
 	sgui::PanelControl*         m_FPSPanel;
   
   ci::fs::path                m_vidPath;
+  FrameCapture*               m_frameCapture;
   long                        m_currentFrame;
+  // frames for another process, while 'r' has it open
+  FrameRing*                  m_frameRing;
+  uint64_t                    m_ringFrame;
 
 private:
   double                      m_lastTime;
   double                      m_currentTime;
   double                      m_cycleCounter;
+  int                         m_prefetchedDepth;
 
   sgui::LabelControl*         m_fps;
   FPSCounter                  m_fpsCounter;
   FPSCounter                  m_upsCounter;
+
+  bool                        m_showProfiler;
+  double                      m_profilerTime;
+  Profiler::Summary           m_profilerSummaries[ Profiler::PHASE_COUNT ];
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -95,14 +136,29 @@ void CinderApp::setup()
 {
   // config vars
   m_cycleImageEvery = 0.0;
+  m_prefetchDepth   = 0;
+  m_prefetchedDepth = 0;
+  m_cpuSplats       = false;
+  m_trailDecay      = 0.0f;
+  m_splatCanvas     = 0;
   m_particleCount   = 0;
   m_particleGroups  = 0;
+  m_keepParticles   = false;
   m_currentFrame    = -1;
+  m_showProfiler    = false;
+  m_profilerTime    = -1.0;
+
+  Profiler::setThreadName( "main" );
 
   // buffer for trails
   ci::Vec2i      displaySz = getWindowSize(); 
 
-  m_frameBufferObject = ci::gl::Fbo( displaySz.x, displaySz.y, true );
+  // half float, so the decay keeps fading the faint trails out instead of
+  // rounding them to a stuck 8 bit value
+  ci::gl::Fbo::Format trailFormat;
+  trailFormat.setColorInternalFormat( GL_RGBA16F_ARB );
+
+  m_frameBufferObject = ci::gl::Fbo( displaySz.x, displaySz.y, trailFormat );
   m_frameBufferObject.bindFramebuffer();
   ci::gl::enableAlphaBlending();
   ci::gl::clear( ci::Color( 0.0f, 0.0f, 0.0f ) ); 
@@ -111,9 +167,23 @@ void CinderApp::setup()
   // emitter
   m_particleEmitter.m_maxLifeTime        = 0.0;
   m_particleEmitter.m_minLifeTime        = 10.0;
-  m_particleEmitter.m_referenceSurface   = &m_surface;
   m_particleEmitter.m_screenTexture      = &m_frameBufferObject.getTexture();
   m_particleEmitter.m_particlesPerSecond = 0;
+  m_particleEmitter.m_fixedStep          = 1.0 / FRAMERATE;
+  m_particleEmitter.m_maxSubSteps        = MAX_SUB_STEPS;
+
+  // upcoming images are decoded in the background
+  m_imageLoader   = new ImageLoader( m_particleEmitter.m_threadPool );
+  m_frameSource   = new FrameSource( m_particleEmitter.m_threadPool );
+  m_streamStarted = false;
+
+  // and captured frames encoded there too
+  m_frameCapture = new FrameCapture( CAPTURE_ENCODERS, CAPTURE_FRAMES );
+
+  // the display never waits for a reader, late frames are dropped
+  m_frameRing                 = new FrameRing();
+  m_frameRing->m_dropWhenFull = true;
+  m_ringFrame                 = 0;
 
   // GUI
   m_gui             = new sgui::SimpleGUI( this );
@@ -125,10 +195,16 @@ void CinderApp::setup()
   // general settings
   m_gui->addLabel( "General Settings" );
 	m_gui->addParam( "Pic. Cycle Time", &m_cycleImageEvery,               3.0f, 120.0f, 15.0f );
+  m_gui->addParam( "Prefetch Depth",  &m_prefetchDepth,                    0,      8,     2 );
+  m_gui->addParam( "Drop Late Frames", &m_frameCapture->m_dropWhenFull, false );
   m_gui->addParam( "Particle Size",   &Particle::s_particleSizeRatio,   0.5f,   3.0f,  1.0f );
   m_gui->addParam( "Particle Speed",  &Particle::s_particleSpeedRatio,  0.2f,   3.0f,  1.0f );
   m_gui->addParam( "Dampness",        &Particle::s_dampness,           0.01f,  0.99f,  0.9f );
   m_gui->addParam( "Color Guidance",  &Particle::s_colorRedirection,    0.0f, 360.0f, 90.0f );
+  m_gui->addParam( "Sample Radius",   &Particle::s_sampleRadius,        0.0f,  20.0f,  5.0f );
+  m_gui->addParam( "CPU Splats",      &m_cpuSplats,                     false );
+  m_gui->addParam( "Trail Decay",     &m_trailDecay,                    0.0f,   0.2f,  0.01f );
+  m_gui->addParam( "Keep Particles",  &m_keepParticles,                 false );
 
 #ifdef WINDOWED
   m_gui->addParam( "#Particles", &m_particleCount,   50, 1000, 500 );
@@ -148,6 +224,11 @@ void CinderApp::setup()
   m_gui->addParam( "Area Size",       &m_particleEmitter.m_zoneRadiusSqrd,      625.0f, 10000.0f, 5625.0f ),
   m_gui->addParam( "Repel Area",      &m_particleEmitter.m_lowThresh,             0.0f,     1.0f,  0.125f );
   m_gui->addParam( "Align Area",      &m_particleEmitter.m_highThresh,            0.0f,     1.0f,   0.65f );
+  m_gui->addParam( "Merge Groups",    &m_particleEmitter.m_mergeGroups,     false );
+  m_gui->addParam( "Flock Slices",    &m_particleEmitter.m_flockSlices,             0,        12,      0 );
+  m_gui->addParam( "Flock Budget",    &m_particleEmitter.m_flockBudget,             0,     20000,      0 );
+  m_gui->addParam( "Barnes-Hut",      &m_particleEmitter.m_barnesHut,       false );
+  m_gui->addParam( "Opening Angle",   &m_particleEmitter.m_openingAngle,          0.0f,      1.5f,   0.5f );
 
   m_gui->addSeparator();
   
@@ -178,7 +259,10 @@ void CinderApp::setup()
   m_gui->addLabel( "'l' to load config"       );
   m_gui->addLabel( "'o' to open image"        );
   m_gui->addLabel( "'c' to start/end capture" );
+  m_gui->addLabel( "'r' to start/end sharing" );
   m_gui->addLabel( "'f' to hide/show fps"     );
+  m_gui->addLabel( "'p' to hide/show profiler" );
+  m_gui->addLabel( "'t' to save a trace"      );
   m_gui->addLabel( "SPACE to skip image"      );
   m_gui->addLabel( "ESC to quit"              );
   
@@ -187,14 +271,20 @@ void CinderApp::setup()
 
   m_gui->addLabel( "Drag multiple files"    );
   m_gui->addLabel( "to slideshow!"          );
+  m_gui->addLabel( "Drag a folder or .y4m"  );
+  m_gui->addLabel( "to stream it!"          );
   
   m_FPSPanel = m_gui->addPanel();
   m_gui->addColumn( 620, 5 );
   m_fps = m_gui->addLabel( "" );
   m_FPSPanel->enabled = false;
 
-  // load images passed via args
-  if ( getArgs().size() > 1 )
+  // load images passed via args, or the stream
+  if ( getArgs().size() == 2 && FrameSource::isStream( getArgs()[ 1 ] ) )
+  {
+    openStream( getArgs()[ 1 ] );
+  }
+  else if ( getArgs().size() > 1 )
   {
     const std::vector< std::string >& args = getArgs();
 
@@ -220,6 +310,28 @@ void CinderApp::setup()
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void CinderApp::shutdown()
+{
+  delete m_imageLoader;
+  m_imageLoader = 0;
+
+  closeStream();
+  delete m_frameSource;
+  m_frameSource = 0;
+
+  delete m_splatCanvas;
+  m_splatCanvas = 0;
+
+  // writes whatever is still queued
+  delete m_frameCapture;
+  m_frameCapture = 0;
+
+  delete m_frameRing;
+  m_frameRing = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void CinderApp::mouseDown( ci::app::MouseEvent _event )
 {
 }
@@ -240,6 +352,12 @@ void CinderApp::mouseDrag( ci::app::MouseEvent _event )
 
 void CinderApp::fileDrop ( ci::app::FileDropEvent _event )
 {
+  if ( _event.getNumFiles() == 1 && FrameSource::isStream( _event.getFile( 0 ) ) )
+  {
+    openStream( _event.getFile( 0 ) );
+    return;
+  }
+
   m_files = _event.getFiles();
   
   setImage( m_files.front(), m_currentTime );
@@ -292,6 +410,7 @@ void CinderApp::keyDown( ci::app::KeyEvent _event )
             if ( !ci::fs::exists( m_vidPath ) )
             {
               ci::fs::create_directories( m_vidPath );
+              m_frameCapture->resetStats();
               break;
             }
             ++vidNumber;
@@ -301,9 +420,32 @@ void CinderApp::keyDown( ci::app::KeyEvent _event )
         else // ends capture
         {
           m_currentFrame = -1;
+          m_frameCapture->flush();
+
+          FrameCapture::Stats stats = m_frameCapture->stats();
+          ci::app::console() << "capture: " << stats.m_written << " frames written, " << stats.m_failed << " failed, "
+                             << stats.m_delayed << " delayed, " << stats.m_dropped << " dropped" << std::endl;
+
           setImage( m_files.front(), m_currentTime );
         }
       }
+      break;
+
+		case 'r': 
+      {
+        if ( !m_frameRing->isOpen() )
+        {
+          bool created = m_frameRing->create( FRAME_RING_NAME, m_frameBufferObject.getWidth(), m_frameBufferObject.getHeight() );
+          m_frameRing->resetStats();
+          ci::app::console() << ( created ? "sharing frames as " : "could not share frames as " ) << FRAME_RING_NAME << std::endl;
+        }
+        else
+        {
+          FrameRing::Stats stats = m_frameRing->stats();
+          ci::app::console() << "sharing: " << stats.m_written << " frames written, " << stats.m_dropped << " dropped" << std::endl;
+          m_frameRing->close();
+        }
+      }
       break;
 
 		case 's': 
@@ -340,6 +482,24 @@ void CinderApp::keyDown( ci::app::KeyEvent _event )
         openImageCallBack();
       }
       break;
+
+    case 'p':
+      {
+        // the phases are only timed while the overlay is up
+        m_showProfiler = !m_showProfiler;
+        m_profilerTime = -1.0;
+        Profiler::enable( m_showProfiler );
+        Profiler::enableCounters( m_showProfiler );
+      }
+      break;
+
+    case 't':
+      {
+        ci::fs::path tracePath = ci::getDocumentsDirectory() / "FlockDrawTrace.json";
+        bool         written   = Profiler::writeChromeTrace( tracePath );
+        ci::app::console() << ( written ? "trace written to " : "could not write " ) << tracePath.string() << std::endl;
+      }
+      break;
 	}
 
 	switch(_event.getCode()) 
@@ -417,14 +577,32 @@ void CinderApp::updateOutputArea( ci::Vec2i& _imageSize )
 
 void CinderApp::setImage( ci::fs::path& _path, double _currentTime )
 {
-  // load the image, resize and set the texture
-  ci::Surface imageLoaded = ci::loadImage( _path );
-  ci::Vec2i   aSize       = imageLoaded.getSize();
-  float       theFactor   = ci::math< float >::min( static_cast< float >( getWindowSize().x ) / aSize.x, static_cast< float >( getWindowSize().y ) / aSize.y );
+  closeStream();
+
+  // take the prefetched image (or load it now) and set the texture
+  PreparedImage prepared;
+
+  if ( !m_imageLoader->take( _path, getWindowSize(), prepared ) )
+  {
+    prefetchImages();
+    return;
+  }
 
-  m_surface = ci::Surface( static_cast< int >( aSize.x * theFactor ), static_cast< int >( aSize.y * theFactor ), false );
-  ci::ip::resize( imageLoaded, imageLoaded.getBounds(), &m_surface, m_surface.getBounds() );
+  ci::Vec2f previousSize = m_surface ? ci::Vec2f( m_surface.getSize() ) : ci::Vec2f( 0.0f, 0.0f );
+
+  m_surface = prepared.m_surface;
   m_texture = m_surface;
+
+  // the particles steer by the image's color field and take their color
+  // from its box averages. the next step picks the image up, the one it
+  // replaces goes away once no step or draw holds it.
+  PreparedImage* published = new PreparedImage();
+  published->m_path    = _path;
+  published->m_surface = prepared.m_surface;
+  published->m_loaded  = true;
+  published->m_steeringField.swap( prepared.m_steeringField );
+  published->m_summedAreaTable.swap( prepared.m_summedAreaTable );
+  m_particleEmitter.publishReference( published );
   
   // update  the image name
   m_currentImageLabel->setText( _path.filename().string() );
@@ -432,16 +610,104 @@ void CinderApp::setImage( ci::fs::path& _path, double _currentTime )
   // update the output area
   updateOutputArea( m_surface.getSize() );
 
-  // kill old particles and add new ones
-  m_particleEmitter.killAll();
-
-  for ( int i = 0; i < m_particleGroups; ++i )
+  // carry the flocks over to the new image, or start over with new ones
+  if ( m_keepParticles && previousSize.x > 0.0f )
+  {
+    m_particleEmitter.retarget( previousSize, m_surface.getSize() );
+  }
+  else
   {
-    m_particleEmitter.addParticles( m_particleCount, i );
+    m_particleEmitter.killAll();
   }
 
+  m_particleEmitter.populate( m_particleGroups, m_particleCount );
+
   // resets the cycle counter;
   m_cycleCounter = 0.0;
+
+  // and start on the following ones
+  prefetchImages();
+}
+
+bool CinderApp::openStream( const ci::fs::path& _path )
+{
+  closeStream();
+
+  // the frames play in a loop, the flocks start with the first one
+  if ( !m_frameSource->open( _path, getWindowSize(), true ) )
+  {
+    ci::app::console() << "could not open " << _path.string() << std::endl;
+    return false;
+  }
+
+  m_files.clear();
+  m_cycleCounter = -1.0;
+  m_currentImageLabel->setText( _path.filename().string() );
+
+  return true;
+}
+
+void CinderApp::startStream()
+{
+  PreparedImage* frame        = m_frameSource->current();
+  ci::Vec2i      frameSize    = frame->m_surface.getSize();
+  ci::Vec2f      previousSize = m_surface ? ci::Vec2f( m_surface.getSize() ) : ci::Vec2f( 0.0f, 0.0f );
+
+  m_particleEmitter.m_frameSource      = m_frameSource;
+  m_particleEmitter.m_referenceSurface = &frame->m_surface;
+  m_particleEmitter.m_steeringField    = &frame->m_steeringField;
+  m_particleEmitter.m_summedAreaTable  = &frame->m_summedAreaTable;
+
+  updateOutputArea( frameSize );
+
+  if ( m_keepParticles && previousSize.x > 0.0f )
+  {
+    m_particleEmitter.retarget( previousSize, frameSize );
+  }
+  else
+  {
+    m_particleEmitter.killAll();
+  }
+
+  m_particleEmitter.populate( m_particleGroups, m_particleCount );
+  m_streamStarted = true;
+}
+
+void CinderApp::closeStream()
+{
+  if ( !m_frameSource || !m_frameSource->isOpen() )
+  {
+    return;
+  }
+
+  // back to the published still image, the slots go away with the decoder
+  m_particleEmitter.m_frameSource      = 0;
+  m_particleEmitter.m_referenceSurface = 0;
+  m_particleEmitter.m_steeringField    = 0;
+  m_particleEmitter.m_summedAreaTable  = 0;
+
+  if ( m_streamStarted )
+  {
+    m_particleEmitter.killAll();
+  }
+
+  m_frameSource->close();
+  m_streamStarted = false;
+}
+
+void CinderApp::prefetchImages()
+{
+  std::vector< ci::fs::path > upcoming;
+
+  // the slideshow always shows the front of m_files next
+  if ( m_files.size() > 1 )
+  {
+    size_t depth = std::min< size_t >( m_prefetchDepth, m_files.size() );
+    upcoming.assign( m_files.begin(), m_files.begin() + depth );
+  }
+
+  m_imageLoader->prefetch( upcoming, getWindowSize() );
+  m_prefetchedDepth = m_prefetchDepth;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -460,16 +726,19 @@ void CinderApp::update()
     delta         = m_currentTime - m_lastTime;
   }
 
-  if ( m_FPSPanel->enabled )
-  {
-    m_upsCounter.update();
-  }
-
   if ( m_cycleCounter != -1.0 )
   {
     m_cycleCounter += delta;
 
-    if ( m_cycleCounter >= m_cycleImageEvery && m_files.size() > 1 )
+    if ( m_prefetchedDepth != m_prefetchDepth )
+    {
+      prefetchImages();
+    }
+
+    // hold the current image until the next one is decoded, if it is coming
+    bool nextReady = m_prefetchDepth == 0 || m_files.empty() || m_imageLoader->ready( m_files.front(), getWindowSize() );
+
+    if ( m_cycleCounter >= m_cycleImageEvery && m_files.size() > 1 && nextReady )
     {
       m_cycleCounter -= m_cycleImageEvery;
 
@@ -481,7 +750,24 @@ void CinderApp::update()
     }
   }
 
-  m_particleEmitter.update( m_currentTime, delta );
+  // the flocks wait for the stream's first frame, then step through one
+  // frame per simulation step
+  if ( m_frameSource->isOpen() && !m_streamStarted && m_frameSource->advance() )
+  {
+    startStream();
+  }
+
+  // the simulation steps at a fixed rate whatever the display does, draw
+  // interpolates between the last two steps
+  int steps = m_particleEmitter.advance( delta );
+
+  if ( m_FPSPanel->enabled )
+  {
+    for ( int i = 0; i < steps; ++i )
+    {
+      m_upsCounter.update();
+    }
+  }
 
   m_lastTime = m_currentTime;
 }
@@ -498,6 +784,12 @@ void CinderApp::draw()
       m_fpsCounter.m_updated = false;
       std::ostringstream oss;
       oss << "fps: " << ( m_fpsCounter.get() ) << " / ups: " << ( m_upsCounter.get() );
+
+      if ( m_currentFrame != -1 )
+      {
+        FrameCapture::Stats stats = m_frameCapture->stats();
+        oss << " / queued: " << stats.m_pending << " delayed: " << stats.m_delayed << " dropped: " << stats.m_dropped;
+      }
       m_fps->setText( oss.str() );
     }
   }
@@ -508,31 +800,57 @@ void CinderApp::draw()
   ci::gl::pushMatrices();
   ci::gl::translate( ci::Vec3f( 0.0f, 0.0f, 0.0f ) );
 
-  // writes backed up frame buffer to the screen
-  m_frameBufferObject.blitToScreen( getWindowBounds(), getWindowBounds() );
-  
-  // darkens the BG
-  ci::gl::enableAlphaBlending();
-  ci::gl::color( 0.0f, 0.0f, 0.0f, 0.01f ); 
-  ci::gl::drawSolidRect( getWindowBounds() );
+  // the trails stay in the frame buffer, drawn on top of what they were
+  m_frameBufferObject.bindFramebuffer();
+  ci::gl::setViewport( m_frameBufferObject.getBounds() );
+
+  if ( m_cpuSplats )
+  {
+    drawSplats();
+  }
+  else
+  {
+    // darkens the BG
+    ci::gl::enableAlphaBlending();
+    ci::gl::color( 0.0f, 0.0f, 0.0f, m_trailDecay ); 
+    ci::gl::drawSolidRect( getWindowBounds() );
+
+    // do the drawing =D
+    m_particleEmitter.draw();
+  }
 
-  // do the drawing =D
-  m_particleEmitter.draw();
+  m_frameBufferObject.unbindFramebuffer();
+  ci::gl::setViewport( getWindowBounds() );
 
-  // save what happened to the framebuffer
-  m_frameBufferObject.blitFromScreen( getWindowBounds(), getWindowBounds() );  
+  // one copy to the screen
+  {
+    ProfileScope profile( Profiler::PHASE_PRESENT );
+    ci::gl::disableAlphaBlending();
+    ci::gl::color( 1.0f, 1.0f, 1.0f, 1.0f );
+    ci::gl::draw( m_frameBufferObject.getTexture(), getWindowBounds() );
+    ci::gl::enableAlphaBlending();
+  }
 
   // captures the video
   if ( m_currentFrame != -1 ) 
   {
-     ci::writeImage( m_vidPath / ( ci::toString( m_currentFrame ) + ".jpg" ), m_frameBufferObject.getTexture() );        
-     m_currentFrame++;
+    captureFrame();
+  }
+
+  if ( m_frameRing->isOpen() )
+  {
+    exportFrame();
   }
 
   if ( ParticleEmitter::s_debugDraw )
   {
     m_particleEmitter.debugDraw();
   }
+
+  if ( m_showProfiler )
+  {
+    drawProfiler();
+  }
    
   // reset gl confs
   ci::gl::enableDepthRead();    
@@ -545,6 +863,149 @@ void CinderApp::draw()
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void CinderApp::drawSplats()
+{
+  // the canvas keeps the trails itself, only the result is uploaded
+  ci::Vec2i size = getWindowSize();
+
+  if ( !m_splatCanvas || m_splatCanvas->getSize() != size )
+  {
+    delete m_splatCanvas;
+    m_splatCanvas  = new SoftwareRasterizer( size.x, size.y );
+    m_splatTexture = ci::gl::Texture();
+  }
+
+  m_splatCanvas->decay( m_trailDecay, *m_particleEmitter.m_threadPool );
+  m_particleEmitter.rasterize( *m_splatCanvas );
+  m_splatCanvas->resolve( *m_particleEmitter.m_threadPool );
+
+  if ( m_splatTexture )
+  {
+    m_splatTexture.update( m_splatCanvas->getSurface() );
+  }
+  else
+  {
+    m_splatTexture = ci::gl::Texture( m_splatCanvas->getSurface() );
+  }
+
+  // the canvas already holds the trails, it replaces the buffer
+  ci::gl::disableAlphaBlending();
+  ci::gl::color( 1.0f, 1.0f, 1.0f, 1.0f );
+  ci::gl::draw( m_splatTexture, getWindowBounds() );
+  ci::gl::enableAlphaBlending();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void CinderApp::drawProfiler()
+{
+  // the rings are summarized a couple of times a second, not every frame
+  double now = ci::app::getElapsedSeconds();
+  if ( now - m_profilerTime > PROFILER_REFRESH )
+  {
+    m_profilerTime = now;
+    Profiler::summarize( PROFILER_WINDOW, m_profilerSummaries );
+  }
+
+  // one row per phase: mean / p95 / max and a log2 histogram, 1us to 32ms
+  float      rowHeight = 14.0f;
+  float      barWidth  = 6.0f;
+  ci::Vec2f  origin( 10.0f, getWindowHeight() - 10.0f - rowHeight * Profiler::PHASE_COUNT );
+  ci::Font   font( "Consolas", 12 );
+
+  ci::gl::enableAlphaBlending();
+  ci::gl::color( 0.0f, 0.0f, 0.0f, 0.6f );
+  ci::gl::drawSolidRect( ci::Rectf( origin.x - 5.0f, origin.y - 5.0f, origin.x + 480.0f, origin.y + rowHeight * Profiler::PHASE_COUNT + 5.0f ) );
+
+  for ( int phase = 0; phase < Profiler::PHASE_COUNT; ++phase )
+  {
+    const Profiler::Summary& summary = m_profilerSummaries[ phase ];
+    ci::Vec2f                row     = origin + ci::Vec2f( 0.0f, rowHeight * phase );
+    std::ostringstream       oss;
+
+    oss.precision( 2 );
+    oss << std::fixed << Profiler::phaseName( static_cast< Profiler::Phase >( phase ) ) << ": " << summary.m_count << " x " << summary.m_meanMs
+        << " p95 " << summary.m_p95Ms << " max " << summary.m_maxMs << " ms";
+
+    if ( summary.m_cycles )
+    {
+      oss << " " << ( summary.m_cycles / summary.m_count / 1000 ) << "k cyc " << ( summary.m_cacheMisses / summary.m_count ) << " llc";
+    }
+
+    ci::gl::drawString( oss.str(), row, ci::ColorA( 1.0f, 1.0f, 1.0f, 1.0f ), font );
+
+    uint32_t peak = 1;
+    for ( int b = 0; b < PROFILER_BUCKETS; ++b )
+    {
+      peak = std::max( peak, summary.m_histogram[ b ] );
+    }
+
+    ci::gl::color( 1.0f, 1.0f, 0.0f, 0.8f );
+    for ( int b = 0; b < PROFILER_BUCKETS; ++b )
+    {
+      float height = ( rowHeight - 2.0f ) * summary.m_histogram[ b ] / peak;
+      float x      = origin.x + 370.0f + b * barWidth;
+
+      ci::gl::drawSolidRect( ci::Rectf( x, row.y + rowHeight - 1.0f - height, x + barWidth - 1.0f, row.y + rowHeight - 1.0f ) );
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void CinderApp::captureFrame()
+{
+  ProfileScope profile( Profiler::PHASE_CAPTURE );
+
+  // read the frame buffer back into a pooled frame, the encoders do the rest
+  int          width  = m_frameBufferObject.getWidth();
+  int          height = m_frameBufferObject.getHeight();
+  ci::Surface* frame  = m_frameCapture->acquire( width, height );
+
+  if ( frame )
+  {
+    m_frameBufferObject.bindFramebuffer();
+    glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+    glPixelStorei( GL_PACK_ROW_LENGTH, frame->getRowBytes() / frame->getPixelInc() );
+    glReadPixels( 0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, frame->getData() );
+    glPixelStorei( GL_PACK_ROW_LENGTH, 0 );
+    m_frameBufferObject.unbindFramebuffer();
+
+    // GL rows go bottom up
+    m_frameCapture->submit( frame, m_vidPath / ( ci::toString( m_currentFrame ) + ".jpg" ), true );
+  }
+
+  // dropped frames keep their number, so the gap shows
+  m_currentFrame++;
+}
+
+void CinderApp::exportFrame()
+{
+  ProfileScope profile( Profiler::PHASE_CAPTURE );
+
+  // read back straight into the ring, the reader flips the rows if it has to
+  uint8_t* pixels = m_frameRing->beginWrite();
+
+  if ( pixels )
+  {
+    int width  = m_frameBufferObject.getWidth();
+    int height = m_frameBufferObject.getHeight();
+
+    // the ring is the frame buffer's size, its rows are padded as GL pads them
+    m_frameBufferObject.bindFramebuffer();
+    glPixelStorei( GL_PACK_ALIGNMENT, FRAME_RING_ROW_ALIGN );
+    glReadPixels( 0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels );
+    m_frameBufferObject.unbindFramebuffer();
+
+    m_frameRing->endWrite( m_ringFrame, width, height, FrameRing::FLAG_BOTTOM_UP );
+  }
+
+  // dropped frames keep their number, so the gap shows
+  ++m_ringFrame;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void CinderApp::prepareSettings( Settings *settings )
 {
 #if defined WINDOWED
@@ -0,0 +1,878 @@
+#include "cinder/ImageIo.h"
+#include "cinder/Surface.h"
+#include "cinder/Filesystem.h"
+#include "ParticleEmitter.h"
+#include "ImageLoader.h"
+#include "SoftwareRasterizer.h"
+#include "FrameRing.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <cstring>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+#define VIDEO_FRAMERATE      30.0f
+#define BENCHMARK_SEED       1234
+#define TRAIL_DECAY          0.01f
+#define BENCHMARK_RING       "FlockDrawBenchmark"
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// sweeps emitter configurations and reports machine readable timings, so
+// builds can be compared
+struct BenchmarkSettings
+{
+  BenchmarkSettings() :
+    m_width( 800 ),
+    m_height( 600 ),
+    m_frames( 300 ),
+    m_warmup( 30 ),
+    m_csv( false ),
+    m_record( false ),
+    m_validate( false ),
+    m_flockBudget( 0 ),
+    m_kernel( FlockKernel::MODE_AUTO )
+  {
+    m_particleCounts.push_back( 500 );
+    m_groupCounts.push_back( 5 );
+    m_zoneRadii.push_back( 75.0f );
+    m_threadCounts.push_back( 0 );
+    m_mergeGroups.push_back( 0 );
+    m_flockSlices.push_back( 0 );
+    m_openingAngles.push_back( 0.0f );
+  }
+
+  ci::fs::path                m_image;
+  ci::fs::path                m_outputPath;
+  int                         m_width;
+  int                         m_height;
+  int                         m_frames;
+  int                         m_warmup;
+  bool                        m_csv;
+  ci::fs::path                m_goldenPath;
+  bool                        m_record;
+  bool                        m_validate;
+  int                         m_flockBudget;
+  FlockKernel::Mode           m_kernel;
+  std::vector< int >          m_particleCounts;
+  std::vector< int >          m_groupCounts;
+  std::vector< float >        m_zoneRadii;
+  std::vector< int >          m_threadCounts;
+  std::vector< int >          m_mergeGroups;
+  std::vector< int >          m_flockSlices;
+  std::vector< float >        m_openingAngles;
+  // times the shared memory frame ring with these slot counts instead
+  std::vector< int >          m_ringSlots;
+};
+
+struct BenchmarkResult
+{
+  int                         m_particles;
+  int                         m_groups;
+  float                       m_zoneRadius;
+  int                         m_threads;
+  bool                        m_mergeGroups;
+  int                         m_flockSlices;
+  float                       m_openingAngle;
+  double                      m_updatesPerSecond;
+  double                      m_nsPerParticle;
+  double                      m_flockTickMs;
+  double                      m_integrateMs;
+  size_t                      m_flockTicks;
+  // update times, flat when the flock ticks are spread
+  double                      m_updateMsP95;
+  double                      m_updateMsMax;
+};
+
+struct RingResult
+{
+  int                         m_slots;
+  double                      m_framesPerSecond;
+  double                      m_megabytesPerSecond;
+  // frame published to frame read
+  double                      m_latencyMsMean;
+  double                      m_latencyMsP95;
+  double                      m_latencyMsMax;
+  // the writer found every slot taken
+  size_t                      m_writerWaits;
+  // one copy of the same frames in process memory, for scale
+  double                      m_copyMegabytesPerSecond;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void printUsage()
+{
+  printf( "usage: FlockDrawBenchmark [options]\n"
+          "  --image <file>         reference image, a synthetic one otherwise\n"
+          "  --size <w> <h>         reference size (800 600)\n"
+          "  --frames <n>           timed updates per configuration (300)\n"
+          "  --warmup <n>           untimed updates first (30)\n"
+          "  --particles <list>     particles per group (500)\n"
+          "  --groups <list>        particle groups (5)\n"
+          "  --radius <list>        zone radius (75)\n"
+          "  --threads <list>       threads, caller included, 0 for all (0)\n"
+          "  --merge <list>         0 flocks groups apart, 1 all together (0)\n"
+          "  --slices <list>        updates a flock tick is spread over, 0 for the emitter's default (0)\n"
+          "  --flock-budget <n>     most particles flocked per update, 0 for no limit (0)\n"
+          "  --opening-angle <list> Barnes-Hut cohesion with that opening angle, 0 for the grid alone (0)\n"
+          "  --kernel <name>        auto, scalar, sse4.1 or avx2 (auto)\n"
+          "  --csv                  csv instead of json\n"
+          "  --out <file>           write there instead of stdout\n"
+          "  --golden <file>        instead of timing, check the seeded regression runs against\n"
+          "                         the state and frame hashes in file (scalar kernel by default),\n"
+          "                         data/golden.txt holds the recorded ones\n"
+          "  --record               write the hashes of this kernel and toolchain to --golden instead\n"
+          "                         of checking them\n"
+          "  --validate             instead of timing, check every kernel the cpu supports against\n"
+          "                         the scalar one, --golden does it first too\n"
+          "  --ring <list>          instead of the emitter, time frames of --size through a shared\n"
+          "                         memory ring of that many slots, written and read by two threads\n"
+          "lists are comma separated, every combination is run\n" );
+}
+
+template< typename T >
+static bool parseList( const char* _text, std::vector< T >& _list )
+{
+  std::stringstream stream( _text );
+  std::string       item;
+
+  _list.clear();
+  while ( std::getline( stream, item, ',' ) )
+  {
+    _list.push_back( static_cast< T >( atof( item.c_str() ) ) );
+  }
+
+  return !_list.empty();
+}
+
+static bool parseKernel( const std::string& _name, FlockKernel::Mode& _mode )
+{
+  for ( int mode = FlockKernel::MODE_AUTO; mode <= FlockKernel::MODE_AVX2; ++mode )
+  {
+    if ( _name == FlockKernel::modeName( static_cast< FlockKernel::Mode >( mode ) ) )
+    {
+      _mode = static_cast< FlockKernel::Mode >( mode );
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool parseArguments( int _argc, char** _argv, BenchmarkSettings& _settings )
+{
+  for ( int i = 1; i < _argc; ++i )
+  {
+    std::string arg  = _argv[ i ];
+    bool        more = i + 1 < _argc;
+    bool        ok   = true;
+
+    if      ( arg == "--image"     && more ) { _settings.m_image      = _argv[ ++i ]; }
+    else if ( arg == "--out"       && more ) { _settings.m_outputPath = _argv[ ++i ]; }
+    else if ( arg == "--size"      && i + 2 < _argc )
+    {
+      _settings.m_width  = atoi( _argv[ ++i ] );
+      _settings.m_height = atoi( _argv[ ++i ] );
+    }
+    else if ( arg == "--frames"    && more ) { _settings.m_frames     = atoi( _argv[ ++i ] ); }
+    else if ( arg == "--warmup"    && more ) { _settings.m_warmup     = atoi( _argv[ ++i ] ); }
+    else if ( arg == "--particles" && more ) { ok = parseList( _argv[ ++i ], _settings.m_particleCounts ); }
+    else if ( arg == "--groups"    && more ) { ok = parseList( _argv[ ++i ], _settings.m_groupCounts ); }
+    else if ( arg == "--radius"    && more ) { ok = parseList( _argv[ ++i ], _settings.m_zoneRadii ); }
+    else if ( arg == "--threads"   && more ) { ok = parseList( _argv[ ++i ], _settings.m_threadCounts ); }
+    else if ( arg == "--merge"     && more ) { ok = parseList( _argv[ ++i ], _settings.m_mergeGroups ); }
+    else if ( arg == "--slices"    && more ) { ok = parseList( _argv[ ++i ], _settings.m_flockSlices ); }
+    else if ( arg == "--opening-angle" && more ) { ok = parseList( _argv[ ++i ], _settings.m_openingAngles ); }
+    else if ( arg == "--flock-budget" && more ) { _settings.m_flockBudget = atoi( _argv[ ++i ] ); }
+    else if ( arg == "--kernel"    && more ) { ok = parseKernel( _argv[ ++i ], _settings.m_kernel ); }
+    else if ( arg == "--csv" )               { _settings.m_csv        = true; }
+    else if ( arg == "--golden"    && more ) { _settings.m_goldenPath = _argv[ ++i ]; }
+    else if ( arg == "--record" )            { _settings.m_record     = true; }
+    else if ( arg == "--validate" )          { _settings.m_validate   = true; }
+    else if ( arg == "--ring"      && more ) { ok = parseList( _argv[ ++i ], _settings.m_ringSlots ); }
+    else                                     { ok = false; }
+
+    if ( !ok )
+    {
+      printf( "bad or incomplete option %s\n", arg.c_str() );
+      return false;
+    }
+  }
+
+  return _settings.m_frames > 0 && _settings.m_width > 0 && _settings.m_height > 0;
+}
+
+// color bands and rings, so the flock and the steering field have some work
+static ci::Surface syntheticImage( int _width, int _height )
+{
+  ci::Surface surface( _width, _height, false );
+
+  for ( int y = 0; y < _height; ++y )
+  {
+    for ( int x = 0; x < _width; ++x )
+    {
+      float dx   = x - _width  * 0.5f;
+      float dy   = y - _height * 0.5f;
+      float ring = 0.5f + 0.5f * sin( sqrt( dx * dx + dy * dy ) * 0.05f );
+
+      surface.setPixel( ci::Vec2i( x, y ), ci::ColorA8u( static_cast< uint8_t >( 255 * ring ), static_cast< uint8_t >( 255 * x / _width ), static_cast< uint8_t >( 255 * y / _height ) ) );
+    }
+  }
+
+  return surface;
+}
+
+static BenchmarkResult run( const BenchmarkSettings& _settings, const PreparedImage& _image, int _particles, int _groups, float _zoneRadius, int _threads, bool _mergeGroups, int _flockSlices, float _openingAngle )
+{
+  ThreadPool      pool( _threads > 0 ? _threads - 1 : THREAD_POOL_HARDWARE );
+  ParticleEmitter emitter;
+
+  emitter.m_threadPool       = &pool;
+  emitter.m_referenceSurface = const_cast< ci::Surface* >( &_image.m_surface );
+  emitter.m_steeringField    = &_image.m_steeringField;
+  emitter.m_summedAreaTable  = &_image.m_summedAreaTable;
+  emitter.m_zoneRadiusSqrd   = _zoneRadius * _zoneRadius;
+  emitter.m_mergeGroups      = _mergeGroups;
+  emitter.m_flockSlices      = _flockSlices;
+  emitter.m_flockBudget      = _settings.m_flockBudget;
+  emitter.m_barnesHut        = _openingAngle > 0.0f;
+  emitter.m_openingAngle     = _openingAngle;
+  emitter.m_repelStrength    = 2.0f;
+  emitter.m_alignStrength    = 2.0f;
+  emitter.m_attractStrength  = 1.0f;
+
+  // same particles for every configuration of the same size
+  emitter.seed( BENCHMARK_SEED );
+  for ( int i = 0; i < _groups; ++i )
+  {
+    emitter.addParticles( _particles, i );
+  }
+
+  double delta       = 1.0 / VIDEO_FRAMERATE;
+  double currentTime = 0.0;
+
+  for ( int frame = 0; frame < _settings.m_warmup; ++frame )
+  {
+    currentTime += delta;
+    emitter.update( currentTime, delta );
+  }
+
+  size_t ticksBefore    = emitter.m_flockTicks;
+  double flockSeconds   = 0.0;
+  double integrateTotal = 0.0;
+
+  std::vector< double > updateMs( _settings.m_frames > 0 ? _settings.m_frames : 1, 0.0 );
+
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+  for ( int frame = 0; frame < _settings.m_frames; ++frame )
+  {
+    size_t ticks = emitter.m_flockTicks;
+
+    currentTime += delta;
+    std::chrono::high_resolution_clock::time_point updateStart = std::chrono::high_resolution_clock::now();
+    emitter.update( currentTime, delta );
+    updateMs[ frame ] = std::chrono::duration< double, std::milli >( std::chrono::high_resolution_clock::now() - updateStart ).count();
+
+    flockSeconds   += emitter.m_flockTicks != ticks ? emitter.m_flockSeconds : 0.0;
+    integrateTotal += emitter.m_integrateSeconds;
+  }
+
+  double seconds = std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - start ).count();
+
+  BenchmarkResult result;
+  result.m_particles        = _particles;
+  result.m_groups           = _groups;
+  result.m_zoneRadius       = _zoneRadius;
+  result.m_threads          = static_cast< int >( pool.concurrency() );
+  result.m_mergeGroups      = _mergeGroups;
+  result.m_flockSlices      = _flockSlices;
+  result.m_openingAngle     = _openingAngle;
+  result.m_flockTicks       = emitter.m_flockTicks - ticksBefore;
+  result.m_updatesPerSecond = _settings.m_frames / seconds;
+  result.m_nsPerParticle    = seconds * 1e9 / ( static_cast< double >( _settings.m_frames ) * _particles * _groups );
+  result.m_flockTickMs      = result.m_flockTicks ? flockSeconds * 1e3 / result.m_flockTicks : 0.0;
+  result.m_integrateMs      = integrateTotal * 1e3 / _settings.m_frames;
+
+  std::sort( updateMs.begin(), updateMs.end() );
+  result.m_updateMsP95      = updateMs[ std::min( updateMs.size() - 1, updateMs.size() * 95 / 100 ) ];
+  result.m_updateMsMax      = updateMs.back();
+
+  emitter.killAll();
+  return result;
+}
+
+// regression runs: seeded, fixed step, drawn every frame. every thread
+// count has to give the same state and frame, and both have to match the
+// golden file recorded for the kernel in use.
+struct GoldenCase
+{
+  const char*                 m_name;
+  int                         m_particles;
+  int                         m_groups;
+  bool                        m_mergeGroups;
+  bool                        m_lifetimes;
+};
+
+static const GoldenCase s_goldenCases[] =
+{
+  { "separate",  300, 4, false, false },
+  { "merged",    300, 4, true,  false },
+  { "lifetimes", 200, 3, false, true  }
+};
+
+// the hashes depend on the compiler's math as much as on the kernel
+static std::string toolchainName()
+{
+#if defined _MSC_VER
+  std::string compiler = "msvc";
+#elif defined __clang__
+  std::string compiler = "clang";
+#elif defined __GNUC__
+  std::string compiler = "gcc";
+#else
+  std::string compiler = "other";
+#endif
+
+#if defined _M_X64 || defined __x86_64__
+  return compiler + "-x64";
+#elif defined _M_IX86 || defined __i386__
+  return compiler + "-x86";
+#elif defined _M_ARM64 || defined __aarch64__
+  return compiler + "-arm64";
+#else
+  return compiler;
+#endif
+}
+
+static void runGolden( const BenchmarkSettings& _settings, const PreparedImage& _image, const GoldenCase& _case, int _threads, uint64_t& _state, uint64_t& _frame )
+{
+  ThreadPool         pool( _threads > 0 ? _threads - 1 : THREAD_POOL_HARDWARE );
+  ParticleEmitter    emitter;
+  SoftwareRasterizer canvas( _image.m_surface.getWidth(), _image.m_surface.getHeight() );
+
+  emitter.m_threadPool       = &pool;
+  emitter.m_referenceSurface = const_cast< ci::Surface* >( &_image.m_surface );
+  emitter.m_steeringField    = &_image.m_steeringField;
+  emitter.m_summedAreaTable  = &_image.m_summedAreaTable;
+  emitter.m_mergeGroups      = _case.m_mergeGroups;
+  emitter.m_repelStrength    = 2.0f;
+  emitter.m_alignStrength    = 2.0f;
+  emitter.m_attractStrength  = 1.0f;
+
+  if ( _case.m_lifetimes )
+  {
+    emitter.m_minLifeTime        = 1.0;
+    emitter.m_maxLifeTime        = 3.0;
+    emitter.m_particlesPerSecond = 150.0f;
+  }
+
+  emitter.seed( BENCHMARK_SEED );
+  emitter.populate( _case.m_groups, _case.m_particles );
+
+  double delta       = 1.0 / VIDEO_FRAMERATE;
+  double currentTime = 0.0;
+
+  for ( int frame = 0; frame < _settings.m_frames; ++frame )
+  {
+    currentTime += delta;
+    emitter.update( currentTime, delta );
+
+    canvas.decay( TRAIL_DECAY, pool );
+    emitter.rasterize( canvas );
+  }
+
+  canvas.resolve( pool );
+
+  const ci::Surface& surface = canvas.getSurface();
+  uint64_t           hash    = 14695981039346656037ULL;
+
+  // in rgb order, whatever order the surface keeps its channels in
+  uint8_t offsets[ 3 ] = { surface.getRedOffset(), surface.getGreenOffset(), surface.getBlueOffset() };
+  size_t  inc          = surface.getPixelInc();
+
+  for ( int y = 0; y < surface.getHeight(); ++y )
+  {
+    const uint8_t* row = surface.getData( ci::Vec2i( 0, y ) );
+
+    for ( int x = 0; x < surface.getWidth(); ++x )
+    {
+      for ( int c = 0; c < 3; ++c )
+      {
+        hash = ( hash ^ row[ x * inc + offsets[ c ] ] ) * 1099511628211ULL;
+      }
+    }
+  }
+
+  _state = emitter.stateHash();
+  _frame = hash;
+}
+
+static int golden( const BenchmarkSettings& _settings, const PreparedImage& _image )
+{
+  const char*        kernel    = FlockKernel::modeName( FlockKernel::mode() );
+  std::string        toolchain = toolchainName();
+  std::vector< int > threads   = _settings.m_threadCounts;
+  bool               passed    = true;
+
+  // with a single thread count, compare the caller alone against all of them
+  if ( threads.size() == 1 )
+  {
+    threads.assign( 1, 1 );
+    threads.push_back( 0 );
+  }
+
+  // "case kernel toolchain state frame" per line, lines starting with # are comments
+  std::map< std::string, std::pair< std::string, std::string > > expected;
+
+  if ( !_settings.m_record )
+  {
+    FILE* file = fopen( _settings.m_goldenPath.string().c_str(), "r" );
+    char  line[ 256 ];
+    char  name[ 64 ], mode[ 64 ], built[ 64 ], state[ 64 ], frame[ 64 ];
+
+    if ( !file )
+    {
+      printf( "could not read %s, run with --record first\n", _settings.m_goldenPath.string().c_str() );
+      return 1;
+    }
+
+    while ( fgets( line, sizeof( line ), file ) )
+    {
+      if ( line[ 0 ] != '#' && sscanf( line, "%63s %63s %63s %63s %63s", name, mode, built, state, frame ) == 5 )
+      {
+        expected[ std::string( name ) + " " + mode + " " + built ] = std::make_pair( std::string( state ), std::string( frame ) );
+      }
+    }
+    fclose( file );
+  }
+
+  std::ostringstream recorded;
+
+  for ( size_t c = 0; c < sizeof( s_goldenCases ) / sizeof( s_goldenCases[ 0 ] ); ++c )
+  {
+    const GoldenCase& goldenCase = s_goldenCases[ c ];
+    uint64_t          state      = 0;
+    uint64_t          frame      = 0;
+    bool              agree      = true;
+
+    for ( size_t t = 0; t < threads.size(); ++t )
+    {
+      uint64_t threadState = 0;
+      uint64_t threadFrame = 0;
+
+      runGolden( _settings, _image, goldenCase, threads[ t ], threadState, threadFrame );
+
+      if ( t == 0 )
+      {
+        state = threadState;
+        frame = threadFrame;
+      }
+      agree = agree && threadState == state && threadFrame == frame;
+    }
+
+    char stateText[ 32 ], frameText[ 32 ];
+    sprintf( stateText, "%016llx", static_cast< unsigned long long >( state ) );
+    sprintf( frameText, "%016llx", static_cast< unsigned long long >( frame ) );
+
+    std::string key = std::string( goldenCase.m_name ) + " " + kernel + " " + toolchain;
+    auto        itr = expected.find( key );
+    bool        ok  = agree && ( _settings.m_record || ( itr != expected.end() && itr->second.first == stateText && itr->second.second == frameText ) );
+
+    recorded << key << " " << stateText << " " << frameText << "\n";
+    passed = passed && ok;
+
+    printf( "%-10s %-7s %-9s state %s frame %s %s\n", goldenCase.m_name, kernel, toolchain.c_str(), stateText, frameText,
+            !agree ? "FAILED, thread counts disagree" : ( _settings.m_record ? "recorded" : ( itr == expected.end() ? "FAILED, no golden for this kernel and toolchain" : ( ok ? "ok" : "FAILED" ) ) ) );
+  }
+
+  if ( _settings.m_record )
+  {
+    // keep the comments and the lines of the other kernels and toolchains
+    FILE* file = fopen( _settings.m_goldenPath.string().c_str(), "r" );
+    char  line[ 256 ];
+    std::ostringstream others;
+
+    if ( file )
+    {
+      while ( fgets( line, sizeof( line ), file ) )
+      {
+        char name[ 64 ], mode[ 64 ], built[ 64 ];
+        if ( line[ 0 ] == '#' || ( sscanf( line, "%63s %63s %63s", name, mode, built ) == 3 && ( std::string( mode ) != kernel || built != toolchain ) ) )
+        {
+          others << line;
+        }
+      }
+      fclose( file );
+    }
+
+    file = fopen( _settings.m_goldenPath.string().c_str(), "w" );
+    if ( !file )
+    {
+      printf( "could not write %s\n", _settings.m_goldenPath.string().c_str() );
+      return 1;
+    }
+    fprintf( file, "%s%s", others.str().c_str(), recorded.str().c_str() );
+    fclose( file );
+  }
+
+  return passed ? 0 : 1;
+}
+
+// checks every kernel the cpu supports against the scalar one
+static bool validateKernels()
+{
+  bool passed = true;
+
+  for ( int mode = FlockKernel::MODE_SCALAR; mode <= FlockKernel::MODE_AVX2; ++mode )
+  {
+    FlockKernel::Mode kernel = static_cast< FlockKernel::Mode >( mode );
+
+    if ( !FlockKernel::isSupported( kernel ) )
+    {
+      printf( "kernel %-7s not supported\n", FlockKernel::modeName( kernel ) );
+      continue;
+    }
+
+    bool ok = FlockKernel::validate( kernel );
+    printf( "kernel %-7s %s\n", FlockKernel::modeName( kernel ), ok ? "ok" : "FAILED, differs from scalar" );
+    passed = passed && ok;
+  }
+
+  return passed;
+}
+
+// keeps the reads of the ring benchmark from being optimized away
+static volatile uint64_t s_checksumSink;
+
+// reads every byte of a frame
+static uint64_t sumFrame( const uint8_t* _pixels, size_t _row, size_t _stride, size_t _height )
+{
+  uint64_t sum = 0;
+
+  for ( size_t y = 0; y < _height; ++y )
+  {
+    const uint8_t* pixel = _pixels + y * _stride;
+    for ( size_t x = 0; x < _row; ++x )
+    {
+      sum += pixel[ x ];
+    }
+  }
+
+  return sum;
+}
+
+// a writer thread puts the frames of the reference in the ring, as the
+// renderers resolve into it, and a reader on a mapping of its own reads
+// every byte of them, as a compositor uploading them would
+static RingResult runRing( const BenchmarkSettings& _settings, const ci::Surface& _image, int _slots )
+{
+  RingResult result;
+  FrameRing  writer;
+  FrameRing  reader;
+  int        frames = _settings.m_warmup + _settings.m_frames;
+
+  memset( &result, 0, sizeof( result ) );
+  result.m_slots = _slots;
+
+  if ( !writer.create( BENCHMARK_RING, _image.getWidth(), _image.getHeight(), static_cast< size_t >( std::max( _slots, 1 ) ) ) || !reader.open( BENCHMARK_RING ) )
+  {
+    printf( "could not map the ring %s\n", BENCHMARK_RING );
+    return result;
+  }
+
+  // the reference as packed rows, what the writer puts in every slot
+  size_t                 stride = writer.getStride();
+  size_t                 row    = static_cast< size_t >( _image.getWidth() ) * 3;
+  std::vector< uint8_t > frame( stride * _image.getHeight() );
+
+  for ( int y = 0; y < _image.getHeight(); ++y )
+  {
+    for ( int x = 0; x < _image.getWidth(); ++x )
+    {
+      ci::ColorA8u color = _image.getPixel( ci::Vec2i( x, y ) );
+      uint8_t*     pixel = &frame[ y * stride + x * 3 ];
+      pixel[ 0 ] = color.r;
+      pixel[ 1 ] = color.g;
+      pixel[ 2 ] = color.b;
+    }
+  }
+
+  std::vector< double > latencies;
+  uint64_t              checksum = 0;
+
+  latencies.reserve( _settings.m_frames );
+
+  std::thread readerThread( [ & ]()
+  {
+    for ( int read = 0; read < frames; )
+    {
+      const FrameRing::FrameHeader* header = reader.beginRead();
+      if ( !header )
+      {
+        std::this_thread::yield();
+        continue;
+      }
+
+      uint64_t latency = FrameRing::now() - header->m_timestamp;
+
+      checksum += sumFrame( reader.pixels( header ), row, header->m_stride, header->m_height );
+      reader.endRead();
+
+      if ( read++ >= _settings.m_warmup )
+      {
+        latencies.push_back( latency / 1e3 );
+      }
+    }
+  } );
+
+  std::chrono::high_resolution_clock::time_point start;
+
+  for ( int f = 0; f < frames; ++f )
+  {
+    if ( f == _settings.m_warmup )
+    {
+      start = std::chrono::high_resolution_clock::now();
+    }
+
+    // the reader is attached, so this waits for a slot instead of dropping
+    uint8_t* pixels = writer.beginWrite();
+    if ( pixels )
+    {
+      memcpy( pixels, &frame[ 0 ], frame.size() );
+      writer.endWrite( f, _image.getWidth(), _image.getHeight() );
+    }
+  }
+
+  readerThread.join();
+
+  double seconds = std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - start ).count();
+  double bytes   = static_cast< double >( row ) * _image.getHeight() * _settings.m_frames;
+
+  // the same frames copied and read on one thread, no ring involved
+  std::vector< uint8_t >                         copy( frame.size() );
+  uint64_t                                       copySum   = 0;
+  std::chrono::high_resolution_clock::time_point copyStart = std::chrono::high_resolution_clock::now();
+
+  for ( int f = 0; f < _settings.m_frames; ++f )
+  {
+    memcpy( &copy[ 0 ], &frame[ 0 ], frame.size() );
+    copySum += sumFrame( &copy[ 0 ], row, stride, _image.getHeight() );
+  }
+
+  double copySeconds = std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - copyStart ).count();
+
+  std::sort( latencies.begin(), latencies.end() );
+
+  result.m_framesPerSecond        = seconds > 0.0 ? _settings.m_frames / seconds : 0.0;
+  result.m_megabytesPerSecond     = seconds > 0.0 ? bytes / seconds / 1e6 : 0.0;
+  result.m_writerWaits            = writer.stats().m_delayed;
+  result.m_copyMegabytesPerSecond = copySeconds > 0.0 ? bytes / copySeconds / 1e6 : 0.0;
+  s_checksumSink                  = checksum + copySum;
+
+  if ( !latencies.empty() )
+  {
+    double sum = 0.0;
+    for ( size_t i = 0; i < latencies.size(); ++i )
+    {
+      sum += latencies[ i ];
+    }
+
+    result.m_latencyMsMean = sum / latencies.size();
+    result.m_latencyMsP95  = latencies[ std::min( latencies.size() - 1, latencies.size() * 95 / 100 ) ];
+    result.m_latencyMsMax  = latencies.back();
+  }
+
+  return result;
+}
+
+static void reportRing( FILE* _file, const BenchmarkSettings& _settings, const std::vector< RingResult >& _results )
+{
+  if ( _settings.m_csv )
+  {
+    fprintf( _file, "width,height,slots,frames_per_second,mb_per_second,latency_ms_mean,latency_ms_p95,latency_ms_max,writer_waits,copy_mb_per_second\n" );
+    for ( size_t i = 0; i < _results.size(); ++i )
+    {
+      const RingResult& r = _results[ i ];
+      fprintf( _file, "%d,%d,%d,%.3f,%.3f,%.4f,%.4f,%.4f,%d,%.3f\n", _settings.m_width, _settings.m_height, r.m_slots, r.m_framesPerSecond, r.m_megabytesPerSecond,
+               r.m_latencyMsMean, r.m_latencyMsP95, r.m_latencyMsMax, static_cast< int >( r.m_writerWaits ), r.m_copyMegabytesPerSecond );
+    }
+    return;
+  }
+
+  fprintf( _file, "{\n  \"width\": %d,\n  \"height\": %d,\n  \"frames\": %d,\n  \"ring\": [\n", _settings.m_width, _settings.m_height, _settings.m_frames );
+  for ( size_t i = 0; i < _results.size(); ++i )
+  {
+    const RingResult& r = _results[ i ];
+    fprintf( _file, "    { \"slots\": %d, \"frames_per_second\": %.3f, \"mb_per_second\": %.3f, \"latency_ms_mean\": %.4f, \"latency_ms_p95\": %.4f, \"latency_ms_max\": %.4f, "
+                    "\"writer_waits\": %d, \"copy_mb_per_second\": %.3f }%s\n",
+             r.m_slots, r.m_framesPerSecond, r.m_megabytesPerSecond, r.m_latencyMsMean, r.m_latencyMsP95, r.m_latencyMsMax, static_cast< int >( r.m_writerWaits ),
+             r.m_copyMegabytesPerSecond, i + 1 < _results.size() ? "," : "" );
+  }
+  fprintf( _file, "  ]\n}\n" );
+}
+
+static void report( FILE* _file, const BenchmarkSettings& _settings, const std::vector< BenchmarkResult >& _results )
+{
+  const char* kernel = FlockKernel::modeName( FlockKernel::mode() );
+
+  if ( _settings.m_csv )
+  {
+    fprintf( _file, "kernel,particles,groups,zone_radius,threads,merge_groups,flock_slices,opening_angle,updates_per_second,ns_per_particle,flock_tick_ms,integrate_ms,flock_ticks,update_ms_p95,update_ms_max\n" );
+    for ( size_t i = 0; i < _results.size(); ++i )
+    {
+      const BenchmarkResult& r = _results[ i ];
+      fprintf( _file, "%s,%d,%d,%g,%d,%d,%d,%g,%.3f,%.3f,%.4f,%.4f,%d,%.4f,%.4f\n", kernel, r.m_particles, r.m_groups, r.m_zoneRadius, r.m_threads, r.m_mergeGroups ? 1 : 0, r.m_flockSlices, r.m_openingAngle,
+               r.m_updatesPerSecond, r.m_nsPerParticle, r.m_flockTickMs, r.m_integrateMs, static_cast< int >( r.m_flockTicks ), r.m_updateMsP95, r.m_updateMsMax );
+    }
+    return;
+  }
+
+  fprintf( _file, "{\n  \"kernel\": \"%s\",\n  \"width\": %d,\n  \"height\": %d,\n  \"frames\": %d,\n  \"results\": [\n",
+           kernel, _settings.m_width, _settings.m_height, _settings.m_frames );
+  for ( size_t i = 0; i < _results.size(); ++i )
+  {
+    const BenchmarkResult& r = _results[ i ];
+    fprintf( _file, "    { \"particles\": %d, \"groups\": %d, \"zone_radius\": %g, \"threads\": %d, \"merge_groups\": %s, \"flock_slices\": %d, \"opening_angle\": %g, \"updates_per_second\": %.3f, "
+                    "\"ns_per_particle\": %.3f, \"flock_tick_ms\": %.4f, \"integrate_ms\": %.4f, \"flock_ticks\": %d, \"update_ms_p95\": %.4f, \"update_ms_max\": %.4f }%s\n",
+             r.m_particles, r.m_groups, r.m_zoneRadius, r.m_threads, r.m_mergeGroups ? "true" : "false", r.m_flockSlices, r.m_openingAngle, r.m_updatesPerSecond, r.m_nsPerParticle,
+             r.m_flockTickMs, r.m_integrateMs, static_cast< int >( r.m_flockTicks ), r.m_updateMsP95, r.m_updateMsMax, i + 1 < _results.size() ? "," : "" );
+  }
+  fprintf( _file, "  ]\n}\n" );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+int main( int argc, char** argv )
+{
+  BenchmarkSettings settings;
+
+  if ( !parseArguments( argc, argv, settings ) )
+  {
+    printUsage();
+    return 1;
+  }
+
+  if ( settings.m_kernel != FlockKernel::MODE_AUTO && !FlockKernel::isSupported( settings.m_kernel ) )
+  {
+    printf( "kernel %s is not supported here\n", FlockKernel::modeName( settings.m_kernel ) );
+    return 1;
+  }
+
+  // --golden checks the kernels first
+  if ( settings.m_validate || !settings.m_goldenPath.empty() )
+  {
+    if ( !validateKernels() )
+    {
+      return 1;
+    }
+    if ( settings.m_goldenPath.empty() )
+    {
+      return 0;
+    }
+  }
+
+  // regression hashes depend on the kernel's rounding, default to the reference one
+  if ( !settings.m_goldenPath.empty() && settings.m_kernel == FlockKernel::MODE_AUTO )
+  {
+    settings.m_kernel = FlockKernel::MODE_SCALAR;
+  }
+
+  FlockKernel::select( settings.m_kernel );
+
+  // the reference and its steering field are shared by every configuration
+  PreparedImage image;
+  ci::Vec2i     fitSize( settings.m_width, settings.m_height );
+
+  if ( settings.m_image.empty() )
+  {
+    image.m_surface = syntheticImage( settings.m_width, settings.m_height );
+    image.m_steeringField.build( image.m_surface, ThreadPool::shared() );
+    image.m_summedAreaTable.build( image.m_surface, ThreadPool::shared() );
+  }
+  else
+  {
+    ImageLoader loader( &ThreadPool::shared() );
+
+    if ( !loader.take( settings.m_image, fitSize, image ) )
+    {
+      printf( "could not load %s\n", settings.m_image.string().c_str() );
+      return 1;
+    }
+  }
+
+  if ( !settings.m_goldenPath.empty() )
+  {
+    return golden( settings, image );
+  }
+
+  FILE* output = settings.m_outputPath.empty() ? stdout : fopen( settings.m_outputPath.string().c_str(), "w" );
+
+  if ( !output )
+  {
+    printf( "could not write %s\n", settings.m_outputPath.string().c_str() );
+    return 1;
+  }
+
+  if ( !settings.m_ringSlots.empty() )
+  {
+    std::vector< RingResult > ringResults;
+
+    for ( size_t r = 0; r < settings.m_ringSlots.size(); ++r )
+    {
+      ringResults.push_back( runRing( settings, image.m_surface, settings.m_ringSlots[ r ] ) );
+    }
+
+    reportRing( output, settings, ringResults );
+  }
+  else
+  {
+    std::vector< BenchmarkResult > results;
+
+    for ( size_t p = 0; p < settings.m_particleCounts.size(); ++p )
+    {
+      for ( size_t g = 0; g < settings.m_groupCounts.size(); ++g )
+      {
+        for ( size_t r = 0; r < settings.m_zoneRadii.size(); ++r )
+        {
+          for ( size_t t = 0; t < settings.m_threadCounts.size(); ++t )
+          {
+            for ( size_t m = 0; m < settings.m_mergeGroups.size(); ++m )
+            {
+              for ( size_t s = 0; s < settings.m_flockSlices.size(); ++s )
+              {
+                for ( size_t a = 0; a < settings.m_openingAngles.size(); ++a )
+                {
+                  results.push_back( run( settings, image, settings.m_particleCounts[ p ], settings.m_groupCounts[ g ], settings.m_zoneRadii[ r ], settings.m_threadCounts[ t ],
+                                          settings.m_mergeGroups[ m ] != 0, settings.m_flockSlices[ s ], settings.m_openingAngles[ a ] ) );
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+
+    report( output, settings, results );
+  }
+
+  if ( output != stdout )
+  {
+    fclose( output );
+  }
+
+  return 0;
+}
@@ -0,0 +1,1190 @@
+#include "cinder/ImageIo.h"
+#include "cinder/Surface.h"
+#include "cinder/Filesystem.h"
+#include "cinder/Utilities.h"
+#include "cinder/ip/Resize.h"
+#include "ParticleEmitter.h"
+#include "ImageLoader.h"
+#include "FrameSource.h"
+#include "FrameCapture.h"
+#include "FrameRing.h"
+#include "SoftwareRasterizer.h"
+#include "TiledImage.h"
+#include "PosterRenderer.h"
+#include "Profiler.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+#define VIDEO_FRAMERATE      30.0f
+// width of a contact sheet cell, by default
+#define SWEEP_THUMB_WIDTH    256
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// offline renderer: runs the emitter as fast as it can and rasterizes the
+// particles on the CPU, no window or GL context involved
+struct HeadlessSettings
+{
+  HeadlessSettings() :
+    m_outputPath( "." ),
+    m_rawSize( 0, 0 ),
+    m_width( 800 ),
+    m_height( 600 ),
+    m_frames( 450 ),
+    m_writeEvery( 0 ),
+    m_prefetchDepth( 1 ),
+    m_encoders( 2 ),
+    m_framerate( VIDEO_FRAMERATE ),
+    m_particleCount( 500 ),
+    m_particleGroups( 5 ),
+    m_repelStrength( 2.0f ),
+    m_alignStrength( 2.0f ),
+    m_attractStrength( 1.0f ),
+    m_zoneRadiusSqrd( 5625.0f ),
+    m_lowThresh( 0.125f ),
+    m_highThresh( 0.65f ),
+    m_mergeGroups( false ),
+    m_flockSlices( 0 ),
+    m_flockBudget( 0 ),
+    m_openingAngle( 0.0f ),
+    m_keepParticles( false ),
+    m_particleSizeRatio( 1.0f ),
+    m_particleSpeedRatio( 1.0f ),
+    m_dampness( 0.9f ),
+    m_colorRedirection( 90.0f ),
+    m_sampleRadius( 5.0f ),
+    m_trailDecay( 0.01f ),
+    m_seed( -1 ),
+    m_counters( false ),
+    m_tileCache( TILED_IMAGE_CACHE ),
+    m_ringSlots( FRAME_RING_SLOTS ),
+    m_jobs( 0 ),
+    m_thumbWidth( SWEEP_THUMB_WIDTH )
+  {
+  }
+
+  std::vector< ci::fs::path > m_files;
+  ci::fs::path                m_outputPath;
+  // moving reference, rendered before the images
+  ci::fs::path                m_streamPath;
+  ci::Vec2i                   m_rawSize;
+  int                         m_width;
+  int                         m_height;
+  int                         m_frames;
+  int                         m_writeEvery;
+  int                         m_prefetchDepth;
+  int                         m_encoders;
+  float                       m_framerate;
+  int                         m_particleCount;
+  int                         m_particleGroups;
+  float                       m_repelStrength;
+  float                       m_alignStrength;
+  float                       m_attractStrength;
+  float                       m_zoneRadiusSqrd;
+  float                       m_lowThresh;
+  float                       m_highThresh;
+  bool                        m_mergeGroups;
+  int                         m_flockSlices;
+  int                         m_flockBudget;
+  // 0 flocks on the grid alone
+  float                       m_openingAngle;
+  bool                        m_keepParticles;
+  float                       m_particleSizeRatio;
+  float                       m_particleSpeedRatio;
+  float                       m_dampness;
+  float                       m_colorRedirection;
+  float                       m_sampleRadius;
+  float                       m_trailDecay;
+  // -1 leaves the emitter unseeded
+  int                         m_seed;
+  ci::fs::path                m_tracePath;
+  bool                        m_counters;
+  // converts m_makeTiles[ 0 ] into the .ftl m_makeTiles[ 1 ] and quits
+  std::vector< ci::fs::path > m_makeTiles;
+  int                         m_tileCache;
+  // every frame goes to the shared memory ring of that name too
+  std::string                 m_ringName;
+  int                         m_ringSlots;
+  // runs every configuration of the spec on every image instead, m_jobs
+  // at once, 0 for one per core
+  ci::fs::path                m_sweepPath;
+  int                         m_jobs;
+  int                         m_thumbWidth;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void printUsage()
+{
+  printf( "usage: FlockDrawHeadless [options] [image ...]\n"
+          "       FlockDrawHeadless --make-tiles <source> <out.ftl> [--raw <w> <h>]\n"
+          "  an .ftl image is simulated at its full size and rendered into a .ppm poster\n"
+          "  --out <dir>            output directory (.)\n"
+          "  --size <w> <h>         fit the images into w x h, 0 0 keeps their size (800 600)\n"
+          "  --frames <n>           simulation steps per image, at most that many for a stream, 0 for all of it (450)\n"
+          "  --stream <source>      one frame per step from a directory of images, a .y4m file or - for y4m on stdin\n"
+          "  --raw <w> <h>          the stream, or the --make-tiles source, is packed 8 bit rgb of w x h\n"
+          "  --every <n>            write every n-th frame, 0 writes only the final still (0)\n"
+          "  --prefetch <n>         images decoded ahead in the background (1)\n"
+          "  --encoders <n>         threads writing frames (2)\n"
+          "  --fps <f>              simulated frames per second (30)\n"
+          "  --particles <n>        particles per group (500)\n"
+          "  --groups <n>           particle groups (5)\n"
+          "  --repel <f>            repel strength (2)\n"
+          "  --align <f>            align strength (2)\n"
+          "  --attract <f>          attract strength (1)\n"
+          "  --area <f>             squared zone radius (5625)\n"
+          "  --repel-area <f>       repel area (0.125)\n"
+          "  --align-area <f>       align area (0.65)\n"
+          "  --merge-groups         flock all groups together\n"
+          "  --flock-slices <n>     frames one flock tick is spread over, 1 flocks all at once (0, auto)\n"
+          "  --flock-budget <n>     most particles flocked per frame, 0 for no limit (0)\n"
+          "  --barnes-hut <angle>   approximate far cohesion with a quadtree, 0.5 is a good angle (off)\n"
+          "  --keep-particles       carry the particles over from one image to the next\n"
+          "  --particle-size <f>    particle size ratio (1)\n"
+          "  --particle-speed <f>   particle speed ratio (1)\n"
+          "  --dampness <f>         dampness (0.9)\n"
+          "  --color-guidance <f>   color guidance in degrees (90)\n"
+          "  --sample-radius <f>    half size of the box colors are averaged over, 0 for one pixel (5)\n"
+          "  --trail-decay <f>      fraction of the trails faded out every frame (0.01)\n"
+          "  --seed <n>             seed the particles and print a hash of their state after each image\n"
+          "  --trace <file>         profile every phase and write a chrome://tracing json\n"
+          "  --counters             add cpu cycles and cache misses to the trace, where supported\n"
+          "  --make-tiles <s> <d>   write the image s, or - for raw rgb on stdin, as the tiled image d\n"
+          "  --tile-cache <n>       tiles of an .ftl mapped at once, 192KB each (256)\n"
+          "  --ring <name>          every frame into the shared memory ring name as well, pacing\n"
+          "                         the run to its reader while one is attached\n"
+          "  --ring-slots <n>       frames the ring holds (4)\n"
+          "  --sweep <spec>         run every configuration of spec on every image and write a\n"
+          "                         contact sheet and the timings of each, see the readme\n"
+          "  --jobs <n>             simulations of a sweep run at once, 0 for one per core (0)\n"
+          "  --thumb <w>            width of a contact sheet cell (256)\n" );
+}
+
+static bool parseArguments( int _argc, char** _argv, HeadlessSettings& _settings )
+{
+  for ( int i = 1; i < _argc; ++i )
+  {
+    std::string arg  = _argv[ i ];
+    bool        more = i + 1 < _argc;
+
+    if      ( arg == "--out"            && more ) { _settings.m_outputPath         = _argv[ ++i ]; }
+    else if ( arg == "--size"           && i + 2 < _argc )
+    {
+      _settings.m_width  = atoi( _argv[ ++i ] );
+      _settings.m_height = atoi( _argv[ ++i ] );
+    }
+    else if ( arg == "--frames"         && more ) { _settings.m_frames             = atoi( _argv[ ++i ] ); }
+    else if ( arg == "--stream"         && more ) { _settings.m_streamPath         = _argv[ ++i ]; }
+    else if ( arg == "--raw"            && i + 2 < _argc )
+    {
+      _settings.m_rawSize.x = atoi( _argv[ ++i ] );
+      _settings.m_rawSize.y = atoi( _argv[ ++i ] );
+    }
+    else if ( arg == "--every"          && more ) { _settings.m_writeEvery         = atoi( _argv[ ++i ] ); }
+    else if ( arg == "--prefetch"       && more ) { _settings.m_prefetchDepth      = atoi( _argv[ ++i ] ); }
+    else if ( arg == "--encoders"       && more ) { _settings.m_encoders           = atoi( _argv[ ++i ] ); }
+    else if ( arg == "--fps"            && more ) { _settings.m_framerate          = static_cast< float >( atof( _argv[ ++i ] ) ); }
+    else if ( arg == "--particles"      && more ) { _settings.m_particleCount      = atoi( _argv[ ++i ] ); }
+    else if ( arg == "--groups"         && more ) { _settings.m_particleGroups     = atoi( _argv[ ++i ] ); }
+    else if ( arg == "--repel"          && more ) { _settings.m_repelStrength      = static_cast< float >( atof( _argv[ ++i ] ) ); }
+    else if ( arg == "--align"          && more ) { _settings.m_alignStrength      = static_cast< float >( atof( _argv[ ++i ] ) ); }
+    else if ( arg == "--attract"        && more ) { _settings.m_attractStrength    = static_cast< float >( atof( _argv[ ++i ] ) ); }
+    else if ( arg == "--area"           && more ) { _settings.m_zoneRadiusSqrd     = static_cast< float >( atof( _argv[ ++i ] ) ); }
+    else if ( arg == "--repel-area"     && more ) { _settings.m_lowThresh          = static_cast< float >( atof( _argv[ ++i ] ) ); }
+    else if ( arg == "--align-area"     && more ) { _settings.m_highThresh         = static_cast< float >( atof( _argv[ ++i ] ) ); }
+    else if ( arg == "--merge-groups" )           { _settings.m_mergeGroups        = true; }
+    else if ( arg == "--flock-slices"   && more ) { _settings.m_flockSlices        = atoi( _argv[ ++i ] ); }
+    else if ( arg == "--flock-budget"   && more ) { _settings.m_flockBudget        = atoi( _argv[ ++i ] ); }
+    else if ( arg == "--barnes-hut"     && more ) { _settings.m_openingAngle       = static_cast< float >( atof( _argv[ ++i ] ) ); }
+    else if ( arg == "--keep-particles" )         { _settings.m_keepParticles      = true; }
+    else if ( arg == "--particle-size"  && more ) { _settings.m_particleSizeRatio  = static_cast< float >( atof( _argv[ ++i ] ) ); }
+    else if ( arg == "--particle-speed" && more ) { _settings.m_particleSpeedRatio = static_cast< float >( atof( _argv[ ++i ] ) ); }
+    else if ( arg == "--dampness"       && more ) { _settings.m_dampness           = static_cast< float >( atof( _argv[ ++i ] ) ); }
+    else if ( arg == "--color-guidance" && more ) { _settings.m_colorRedirection   = static_cast< float >( atof( _argv[ ++i ] ) ); }
+    else if ( arg == "--sample-radius"  && more ) { _settings.m_sampleRadius       = static_cast< float >( atof( _argv[ ++i ] ) ); }
+    else if ( arg == "--trail-decay"    && more ) { _settings.m_trailDecay         = static_cast< float >( atof( _argv[ ++i ] ) ); }
+    else if ( arg == "--seed"           && more ) { _settings.m_seed               = abs( atoi( _argv[ ++i ] ) ); }
+    else if ( arg == "--trace"          && more ) { _settings.m_tracePath          = _argv[ ++i ]; }
+    else if ( arg == "--counters" )               { _settings.m_counters           = true; }
+    else if ( arg == "--tile-cache"     && more ) { _settings.m_tileCache          = atoi( _argv[ ++i ] ); }
+    else if ( arg == "--ring"           && more ) { _settings.m_ringName           = _argv[ ++i ]; }
+    else if ( arg == "--ring-slots"     && more ) { _settings.m_ringSlots          = atoi( _argv[ ++i ] ); }
+    else if ( arg == "--sweep"          && more ) { _settings.m_sweepPath          = _argv[ ++i ]; }
+    else if ( arg == "--jobs"           && more ) { _settings.m_jobs               = atoi( _argv[ ++i ] ); }
+    else if ( arg == "--thumb"          && more ) { _settings.m_thumbWidth         = atoi( _argv[ ++i ] ); }
+    else if ( arg == "--make-tiles"     && i + 2 < _argc )
+    {
+      _settings.m_makeTiles.push_back( _argv[ ++i ] );
+      _settings.m_makeTiles.push_back( _argv[ ++i ] );
+    }
+    else if ( arg.compare( 0, 2, "--" ) == 0 )
+    {
+      printf( "unknown or incomplete option %s\n", arg.c_str() );
+      return false;
+    }
+    else
+    {
+      _settings.m_files.push_back( ci::fs::path( arg ) );
+    }
+  }
+
+  return ( !_settings.m_files.empty() || !_settings.m_streamPath.empty() || !_settings.m_makeTiles.empty() ) && _settings.m_framerate > 0.0f;
+}
+
+// hands a copy of the canvas to the encoders
+static void writeFrame( FrameCapture& _capture, SoftwareRasterizer& _canvas, ThreadPool& _pool, const ci::fs::path& _path )
+{
+  _canvas.resolve( _pool );
+
+  const ci::Surface& surface = _canvas.getSurface();
+  ci::Surface*       frame   = _capture.acquire( surface.getWidth(), surface.getHeight() );
+
+  frame->copyFrom( surface, surface.getBounds() );
+  _capture.submit( frame, _path );
+}
+
+// resolves the canvas straight into the ring's next slot, a ring of the
+// canvas' size is made on the first frame or when a larger one comes
+static void exportFrame( const HeadlessSettings& _settings, FrameRing& _ring, SoftwareRasterizer& _canvas, ThreadPool& _pool, uint64_t _frameId )
+{
+  ProfileScope profile( Profiler::PHASE_CAPTURE );
+
+  ci::Vec2i size = _canvas.getSize();
+
+  if ( !_ring.isOpen() || size.x > _ring.getWidth() || size.y > _ring.getHeight() )
+  {
+    if ( !_ring.create( _settings.m_ringName, std::max( size.x, _ring.getWidth() ), std::max( size.y, _ring.getHeight() ), static_cast< size_t >( std::max( _settings.m_ringSlots, 1 ) ) ) )
+    {
+      return;
+    }
+  }
+
+  uint8_t* pixels = _ring.beginWrite();
+  if ( pixels )
+  {
+    _canvas.resolve( _pool, pixels, _ring.getStride() );
+    _ring.endWrite( _frameId, size.x, size.y );
+  }
+}
+
+// a tiled reference: the particles live at its full size, the tables are
+// built on its overview and the last steps are drawn into a poster of the
+// same size. nothing of the image is held but the tiles in use.
+static void renderTiled( const HeadlessSettings& _settings, ParticleEmitter& _emitter, const ci::fs::path& _file, double& _currentTime, ci::Vec2f& _previousSize )
+{
+  std::string     stem  = _file.stem().string();
+  double          delta = 1.0 / _settings.m_framerate;
+  TiledImage      tiled;
+  SteeringField   steeringField;
+  SummedAreaTable summedAreaTable;
+
+  if ( !tiled.open( _file, static_cast< size_t >( std::max( _settings.m_tileCache, 1 ) ) ) )
+  {
+    printf( "could not open %s\n", _file.string().c_str() );
+    return;
+  }
+
+  steeringField.build( tiled.overview(), *_emitter.m_threadPool );
+  summedAreaTable.build( tiled.overview(), *_emitter.m_threadPool );
+
+  ci::Vec2i      size = tiled.getSize();
+  PosterRenderer poster( size.x, size.y, _settings.m_trailDecay );
+
+  _emitter.m_referenceSurface = 0;
+  _emitter.m_tiledImage       = &tiled;
+  _emitter.m_steeringField    = &steeringField;
+  _emitter.m_summedAreaTable  = &summedAreaTable;
+  _emitter.m_position         = ci::Vec2f( 0.0f, 0.0f );
+
+  if ( _settings.m_keepParticles )
+  {
+    _emitter.retarget( _previousSize, size );
+  }
+  _emitter.populate( _settings.m_particleGroups, _settings.m_particleCount );
+
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+  for ( int frame = 0; frame < _settings.m_frames; ++frame )
+  {
+    _currentTime += delta;
+    _emitter.update( _currentTime, delta );
+    _emitter.rasterize( poster.recorder() );
+    poster.endStep();
+  }
+
+  double seconds = std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - start ).count();
+
+  printf( "%s: %d frames in %.3fs (%.1f fps) at %d x %d, %d tiles mapped at most, %d mapped in all\n", stem.c_str(), _settings.m_frames, seconds, seconds > 0.0 ? _settings.m_frames / seconds : 0.0,
+          size.x, size.y, static_cast< int >( tiled.peakResident() ), static_cast< int >( tiled.misses() ) );
+
+  if ( !poster.write( _settings.m_outputPath / ( stem + ".ppm" ), *_emitter.m_threadPool ) )
+  {
+    printf( "could not write %s\n", ( _settings.m_outputPath / ( stem + ".ppm" ) ).string().c_str() );
+  }
+
+  if ( _settings.m_seed >= 0 )
+  {
+    printf( "%s: state %016llx\n", stem.c_str(), static_cast< unsigned long long >( _emitter.stateHash() ) );
+  }
+
+  if ( !_settings.m_keepParticles )
+  {
+    _emitter.killAll();
+  }
+  _previousSize              = size;
+  _emitter.m_tiledImage      = 0;
+  _emitter.m_steeringField   = 0;
+  _emitter.m_summedAreaTable = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+typedef std::pair< std::string, std::string > SweepOption;
+
+// one combination of a sweep: the options it adds to the command line and
+// the settings they make
+struct SweepConfig
+{
+  // stem of the SimpleGUI config it started from, if any
+  std::string                 m_name;
+  std::string                 m_options;
+  HeadlessSettings            m_settings;
+};
+
+// one cell of the contact sheet, a configuration on an image
+struct SweepResult
+{
+  SweepResult() :
+    m_frames( 0 ),
+    m_seconds( 0.0 ),
+    m_hash( 0 )
+  {
+  }
+
+  int                         m_frames;
+  double                      m_seconds;
+  uint64_t                    m_hash;
+};
+
+// the options a sweep may vary, anything else is the same for every run
+static const char* s_sweepOptions[] =
+{
+  "particles", "groups", "repel", "align", "attract", "area", "repel-area", "align-area", "merge-groups", "flock-slices", "flock-budget",
+  "barnes-hut", "particle-size", "particle-speed", "dampness", "color-guidance", "sample-radius", "trail-decay", "frames", "seed", 0
+};
+
+// the app's SimpleGUI labels and the option each one is
+static const char* s_guiLabels[][ 2 ] =
+{
+  { "Particle Size",  "particle-size"  },
+  { "Particle Speed", "particle-speed" },
+  { "Dampness",       "dampness"       },
+  { "Color Guidance", "color-guidance" },
+  { "Sample Radius",  "sample-radius"  },
+  { "Trail Decay",    "trail-decay"    },
+  { "#Particles",     "particles"      },
+  { "#Groups",        "groups"         },
+  { "Repel Str.",     "repel"          },
+  { "Align Str.",     "align"          },
+  { "Att. Str.",      "attract"        },
+  { "Area Size",      "area"           },
+  { "Repel Area",     "repel-area"     },
+  { "Align Area",     "align-area"     },
+  { "Merge Groups",   "merge-groups"   },
+  { "Flock Slices",   "flock-slices"   },
+  { "Flock Budget",   "flock-budget"   },
+  { 0,                0                }
+};
+
+static std::string trim( const std::string& _text )
+{
+  size_t begin = _text.find_first_not_of( " \t\r\n" );
+  size_t end   = _text.find_last_not_of( " \t\r\n" );
+
+  return begin == std::string::npos ? std::string() : _text.substr( begin, end - begin + 1 );
+}
+
+static bool isTrue( const std::string& _value )
+{
+  return _value == "true" || atof( _value.c_str() ) != 0.0;
+}
+
+static bool isSweepOption( const std::string& _name )
+{
+  for ( size_t i = 0; s_sweepOptions[ i ]; ++i )
+  {
+    if ( _name == s_sweepOptions[ i ] )
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// sets an option of _settings as the command line would
+static bool applyOption( HeadlessSettings& _settings, const SweepOption& _option )
+{
+  if ( !isSweepOption( _option.first ) )
+  {
+    return false;
+  }
+
+  // a flag can be turned off as well
+  if ( _option.first == "merge-groups" )
+  {
+    _settings.m_mergeGroups = isTrue( _option.second );
+    return true;
+  }
+
+  char        program[] = "FlockDrawHeadless";
+  std::string name      = "--" + _option.first;
+  std::string value     = _option.second;
+  char*       argv[]    = { program, &name[ 0 ], &value[ 0 ] };
+  size_t      files     = _settings.m_files.size();
+
+  return parseArguments( 3, argv, _settings ) && _settings.m_files.size() == files;
+}
+
+// how the option reads on the command line
+static std::string optionText( const SweepOption& _option )
+{
+  if ( _option.first == "merge-groups" )
+  {
+    return isTrue( _option.second ) ? "--merge-groups" : "";
+  }
+
+  return "--" + _option.first + " " + _option.second;
+}
+
+// the options a config saved by the app's SimpleGUI stands for. lines are
+// taken as "label value", "label = value" or "label : value", labels with
+// no headless option are skipped.
+static bool readGuiConfig( const ci::fs::path& _path, std::vector< SweepOption >& _options )
+{
+  std::ifstream file( _path.string().c_str() );
+  std::string   line;
+  bool          barnesHut    = false;
+  bool          hasBarnesHut = false;
+  std::string   openingAngle = "0.5";
+
+  if ( !file )
+  {
+    return false;
+  }
+
+  while ( std::getline( file, line ) )
+  {
+    line = trim( line );
+
+    size_t split = line.find_first_of( "=:" );
+    if ( split == std::string::npos )
+    {
+      split = line.find_last_of( " \t" );
+    }
+    if ( split == std::string::npos )
+    {
+      continue;
+    }
+
+    std::string label = trim( line.substr( 0, split ) );
+    std::string value = trim( line.substr( split + 1 ) );
+
+    // the app keeps the angle while the tree is off
+    if ( label == "Barnes-Hut" )
+    {
+      barnesHut    = isTrue( value );
+      hasBarnesHut = true;
+      continue;
+    }
+    if ( label == "Opening Angle" )
+    {
+      openingAngle = value;
+      continue;
+    }
+
+    for ( size_t i = 0; s_guiLabels[ i ][ 0 ]; ++i )
+    {
+      if ( label == s_guiLabels[ i ][ 0 ] )
+      {
+        _options.push_back( SweepOption( s_guiLabels[ i ][ 1 ], value ) );
+        break;
+      }
+    }
+  }
+
+  if ( hasBarnesHut )
+  {
+    _options.push_back( SweepOption( "barnes-hut", barnesHut ? openingAngle : std::string( "0" ) ) );
+  }
+
+  return true;
+}
+
+// a sweep spec has an option per line, "name value[,value ...]", and the
+// configurations are every combination of the values. "cfg file[,file ...]"
+// lines name SimpleGUI configs, every one is combined with the options.
+static bool readSweep( const HeadlessSettings& _base, std::vector< SweepConfig >& _configs )
+{
+  std::ifstream file( _base.m_sweepPath.string().c_str() );
+  std::string   line;
+  int           lineNumber = 0;
+
+  std::vector< std::pair< std::string, std::vector< SweepOption > > > bases;
+  std::vector< std::vector< SweepOption > >                           axes;
+
+  if ( !file )
+  {
+    printf( "could not read %s\n", _base.m_sweepPath.string().c_str() );
+    return false;
+  }
+
+  while ( std::getline( file, line ) )
+  {
+    ++lineNumber;
+    line = trim( line );
+
+    if ( line.empty() || line[ 0 ] == '#' )
+    {
+      continue;
+    }
+
+    size_t                     split = line.find_first_of( " \t" );
+    std::string                name  = line.substr( 0, split );
+    std::string                rest  = split == std::string::npos ? std::string() : line.substr( split + 1 );
+    std::vector< std::string > values;
+
+    if ( name.compare( 0, 2, "--" ) == 0 )
+    {
+      name = name.substr( 2 );
+    }
+
+    for ( size_t begin = 0; begin <= rest.size(); )
+    {
+      size_t      end   = std::min( rest.find( ',', begin ), rest.size() );
+      std::string value = trim( rest.substr( begin, end - begin ) );
+
+      if ( !value.empty() )
+      {
+        values.push_back( value );
+      }
+      begin = end + 1;
+    }
+
+    if ( values.empty() )
+    {
+      printf( "%s:%d: no values for %s\n", _base.m_sweepPath.string().c_str(), lineNumber, name.c_str() );
+      return false;
+    }
+
+    if ( name == "cfg" )
+    {
+      for ( size_t v = 0; v < values.size(); ++v )
+      {
+        ci::fs::path path( values[ v ] );
+        if ( path.is_relative() )
+        {
+          path = _base.m_sweepPath.parent_path() / path;
+        }
+
+        bases.push_back( std::make_pair( path.stem().string(), std::vector< SweepOption >() ) );
+        if ( !readGuiConfig( path, bases.back().second ) )
+        {
+          printf( "could not read %s\n", path.string().c_str() );
+          return false;
+        }
+      }
+    }
+    else if ( isSweepOption( name ) )
+    {
+      axes.push_back( std::vector< SweepOption >() );
+      for ( size_t v = 0; v < values.size(); ++v )
+      {
+        axes.back().push_back( SweepOption( name, values[ v ] ) );
+      }
+    }
+    else
+    {
+      printf( "%s:%d: %s can not be swept\n", _base.m_sweepPath.string().c_str(), lineNumber, name.c_str() );
+      return false;
+    }
+  }
+
+  if ( bases.empty() )
+  {
+    bases.push_back( std::make_pair( std::string(), std::vector< SweepOption >() ) );
+  }
+
+  for ( size_t b = 0; b < bases.size(); ++b )
+  {
+    // the last axis changes fastest
+    std::vector< size_t > pick( axes.size(), 0 );
+
+    for ( ;; )
+    {
+      std::vector< SweepOption > options = bases[ b ].second;
+      SweepConfig                config;
+
+      // an option swept overrides the config's
+      for ( size_t a = 0; a < axes.size(); ++a )
+      {
+        for ( size_t o = 0; o < options.size(); )
+        {
+          if ( options[ o ].first == axes[ a ][ pick[ a ] ].first )
+          {
+            options.erase( options.begin() + o );
+          }
+          else
+          {
+            ++o;
+          }
+        }
+        options.push_back( axes[ a ][ pick[ a ] ] );
+      }
+
+      config.m_name     = bases[ b ].first;
+      config.m_settings = _base;
+
+      for ( size_t o = 0; o < options.size(); ++o )
+      {
+        if ( !applyOption( config.m_settings, options[ o ] ) )
+        {
+          printf( "bad value %s for %s\n", options[ o ].second.c_str(), options[ o ].first.c_str() );
+          return false;
+        }
+
+        std::string text = optionText( options[ o ] );
+        if ( !text.empty() )
+        {
+          config.m_options += ( config.m_options.empty() ? "" : " " ) + text;
+        }
+      }
+
+      _configs.push_back( config );
+
+      size_t a = axes.size();
+      for ( ; a > 0; --a )
+      {
+        if ( ++pick[ a - 1 ] < axes[ a - 1 ].size() )
+        {
+          break;
+        }
+        pick[ a - 1 ] = 0;
+      }
+
+      if ( a == 0 )
+      {
+        break;
+      }
+    }
+  }
+
+  return true;
+}
+
+// runs a configuration on an image with an emitter and a canvas of its own,
+// on the calling thread alone, and scales the last frame into _cell of
+// _sheet. the image is only read, every run shares it.
+static SweepResult runCell( const HeadlessSettings& _settings, PreparedImage& _image, ci::Surface& _sheet, const ci::Area& _cell )
+{
+  ThreadPool         pool( 0 );
+  ParticleEmitter    emitter;
+  FlockParams        params;
+  SoftwareRasterizer canvas( _image.m_surface.getWidth(), _image.m_surface.getHeight() );
+  SweepResult        result;
+  double             delta       = 1.0 / _settings.m_framerate;
+  double             currentTime = 0.0;
+
+  // the particle ratios go with the params, the statics are shared by
+  // every run
+  params.m_zoneRadiusSqrd     = _settings.m_zoneRadiusSqrd;
+  params.m_repelStrength      = _settings.m_repelStrength;
+  params.m_alignStrength      = _settings.m_alignStrength;
+  params.m_attractStrength    = _settings.m_attractStrength;
+  params.m_lowThresh          = _settings.m_lowThresh;
+  params.m_highThresh         = _settings.m_highThresh;
+  params.m_mergeGroups        = _settings.m_mergeGroups;
+  params.m_flockSlices        = _settings.m_flockSlices;
+  params.m_flockBudget        = _settings.m_flockBudget;
+  params.m_barnesHut          = _settings.m_openingAngle > 0.0f;
+  params.m_openingAngle       = _settings.m_openingAngle;
+  params.m_particleSizeRatio  = _settings.m_particleSizeRatio;
+  params.m_particleSpeedRatio = _settings.m_particleSpeedRatio;
+  params.m_dampness           = _settings.m_dampness;
+  params.m_colorRedirection   = _settings.m_colorRedirection;
+  params.m_sampleRadius       = _settings.m_sampleRadius;
+
+  emitter.m_threadPool = &pool;
+  emitter.applyParams( params );
+
+  if ( _settings.m_seed >= 0 )
+  {
+    emitter.seed( static_cast< uint32_t >( _settings.m_seed ) );
+  }
+
+  emitter.m_referenceSurface = &_image.m_surface;
+  emitter.m_steeringField    = &_image.m_steeringField;
+  emitter.m_summedAreaTable  = &_image.m_summedAreaTable;
+  emitter.m_position         = ci::Vec2f( 0.0f, 0.0f );
+  emitter.populate( _settings.m_particleGroups, _settings.m_particleCount );
+
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+  for ( int frame = 0; frame < _settings.m_frames; ++frame )
+  {
+    currentTime += delta;
+    emitter.update( currentTime, delta );
+
+    canvas.decay( _settings.m_trailDecay, pool );
+    emitter.rasterize( canvas );
+  }
+
+  result.m_frames  = std::max( _settings.m_frames, 0 );
+  result.m_seconds = std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - start ).count();
+  result.m_hash    = emitter.stateHash();
+
+  canvas.resolve( pool );
+  ci::ip::resize( canvas.getSurface(), canvas.getSurface().getBounds(), &_sheet, _cell );
+
+  emitter.killAll();
+  return result;
+}
+
+// every configuration of the sweep spec on every image, many at once. the
+// images are decoded once and shared. writes a contact sheet, a cell per
+// run, configurations in reading order and images side by side, and a csv
+// with the options and the timings of every cell.
+static int runSweep( const HeadlessSettings& _settings )
+{
+  std::vector< SweepConfig > configs;
+
+  if ( !readSweep( _settings, configs ) )
+  {
+    return 1;
+  }
+
+  std::vector< ci::fs::path > files;
+  for ( size_t f = 0; f < _settings.m_files.size(); ++f )
+  {
+    if ( _settings.m_files[ f ].extension() == ".ftl" )
+    {
+      printf( "%s: tiled images are not swept\n", _settings.m_files[ f ].string().c_str() );
+      continue;
+    }
+    files.push_back( _settings.m_files[ f ] );
+  }
+
+  ci::Vec2i                     fitSize( _settings.m_width, _settings.m_height );
+  ImageLoader                   loader( &ThreadPool::shared() );
+  std::vector< PreparedImage* > images;
+  std::vector< std::string >    stems;
+
+  loader.prefetch( files, fitSize );
+  for ( size_t f = 0; f < files.size(); ++f )
+  {
+    PreparedImage* image = new PreparedImage();
+
+    if ( !loader.take( files[ f ], fitSize, *image ) )
+    {
+      printf( "could not load %s\n", files[ f ].string().c_str() );
+      delete image;
+      continue;
+    }
+    images.push_back( image );
+    stems.push_back( files[ f ].stem().string() );
+  }
+
+  if ( images.empty() )
+  {
+    return 1;
+  }
+
+  // a row holds whole configurations, so every image keeps its columns
+  size_t cells       = configs.size() * images.size();
+  size_t columns     = static_cast< size_t >( ceil( sqrt( static_cast< double >( cells ) ) ) );
+  columns            = ( columns + images.size() - 1 ) / images.size() * images.size();
+  size_t rows        = ( cells + columns - 1 ) / columns;
+  int    thumbWidth  = std::max( _settings.m_thumbWidth, 16 );
+  int    thumbHeight = 1;
+
+  for ( size_t i = 0; i < images.size(); ++i )
+  {
+    ci::Vec2i size = images[ i ]->m_surface.getSize();
+    thumbHeight = std::max( thumbHeight, static_cast< int >( static_cast< float >( thumbWidth ) * size.y / std::max( size.x, 1 ) + 0.5f ) );
+  }
+
+  if ( !ci::fs::exists( _settings.m_outputPath ) )
+  {
+    ci::fs::create_directories( _settings.m_outputPath );
+  }
+
+  FrameCapture capture( 1 );
+  ci::Surface* sheet = capture.acquire( static_cast< int >( columns ) * thumbWidth, static_cast< int >( rows ) * thumbHeight );
+  memset( sheet->getData(), 0, static_cast< size_t >( sheet->getRowBytes() ) * sheet->getHeight() );
+
+  size_t jobs = _settings.m_jobs > 0 ? static_cast< size_t >( _settings.m_jobs ) : std::max< size_t >( std::thread::hardware_concurrency(), 1 );
+  jobs        = std::min( jobs, cells );
+
+  printf( "sweep: %d configurations on %d images, %d at once\n", static_cast< int >( configs.size() ), static_cast< int >( images.size() ), static_cast< int >( jobs ) );
+
+  // the first emitter picks the flock kernel, it is picked before they
+  // are made side by side
+  if ( FlockKernel::mode() == FlockKernel::MODE_AUTO )
+  {
+    FlockKernel::select();
+  }
+
+  std::vector< SweepResult >  results( cells );
+  std::atomic< size_t >       nextCell( 0 );
+  std::vector< std::thread >  workers;
+
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+  for ( size_t j = 0; j < jobs; ++j )
+  {
+    workers.push_back( std::thread( [ & ]()
+    {
+      for ( size_t cell = nextCell++; cell < cells; cell = nextCell++ )
+      {
+        size_t    image = cell % images.size();
+        ci::Vec2i size  = images[ image ]->m_surface.getSize();
+        ci::Vec2i corner( static_cast< int >( cell % columns ) * thumbWidth, static_cast< int >( cell / columns ) * thumbHeight );
+        ci::Vec2i thumb( thumbWidth, std::max( static_cast< int >( static_cast< float >( thumbWidth ) * size.y / std::max( size.x, 1 ) + 0.5f ), 1 ) );
+
+        results[ cell ] = runCell( configs[ cell / images.size() ].m_settings, *images[ image ], *sheet, ci::Area( corner, corner + thumb ) );
+      }
+    } ) );
+  }
+
+  for ( size_t j = 0; j < jobs; ++j )
+  {
+    workers[ j ].join();
+  }
+
+  double seconds = std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - start ).count();
+
+  std::string  stem      = _settings.m_sweepPath.stem().string();
+  ci::fs::path sheetPath = _settings.m_outputPath / ( stem + ".png" );
+  ci::fs::path csvPath   = _settings.m_outputPath / ( stem + ".csv" );
+  FILE*        csv       = fopen( csvPath.string().c_str(), "w" );
+  int          frames    = 0;
+
+  capture.submit( sheet, sheetPath );
+
+  if ( csv )
+  {
+    fprintf( csv, "cell,row,column,config,cfg,image,options,frames,seconds,fps,ms_per_frame,state\n" );
+  }
+
+  for ( size_t c = 0; c < configs.size(); ++c )
+  {
+    SweepResult total;
+
+    for ( size_t i = 0; i < images.size(); ++i )
+    {
+      size_t             cell   = c * images.size() + i;
+      const SweepResult& result = results[ cell ];
+
+      total.m_frames  += result.m_frames;
+      total.m_seconds += result.m_seconds;
+
+      if ( csv )
+      {
+        fprintf( csv, "%d,%d,%d,%d,%s,%s,\"%s\",%d,%.6f,%.2f,%.4f,", static_cast< int >( cell ), static_cast< int >( cell / columns ), static_cast< int >( cell % columns ), static_cast< int >( c ),
+                 configs[ c ].m_name.c_str(), stems[ i ].c_str(), configs[ c ].m_options.c_str(), result.m_frames, result.m_seconds,
+                 result.m_seconds > 0.0 ? result.m_frames / result.m_seconds : 0.0, result.m_frames > 0 ? result.m_seconds * 1e3 / result.m_frames : 0.0 );
+        if ( configs[ c ].m_settings.m_seed >= 0 )
+        {
+          fprintf( csv, "%016llx", static_cast< unsigned long long >( result.m_hash ) );
+        }
+        fprintf( csv, "\n" );
+      }
+    }
+
+    frames += total.m_frames;
+    printf( "config %d%s%s: %d frames in %.3fs (%.1f fps)%s%s\n", static_cast< int >( c ), configs[ c ].m_name.empty() ? "" : " ", configs[ c ].m_name.c_str(), total.m_frames, total.m_seconds,
+            total.m_seconds > 0.0 ? total.m_frames / total.m_seconds : 0.0, configs[ c ].m_options.empty() ? "" : ", ", configs[ c ].m_options.c_str() );
+  }
+
+  printf( "sweep: %d runs, %d frames in %.3fs (%.1f fps in all)\n", static_cast< int >( cells ), frames, seconds, seconds > 0.0 ? frames / seconds : 0.0 );
+
+  bool written = !csv || fclose( csv ) == 0;
+  if ( !csv || !written )
+  {
+    printf( "could not write %s\n", csvPath.string().c_str() );
+  }
+
+  capture.flush();
+
+  if ( capture.stats().m_failed )
+  {
+    printf( "could not write %s\n", sheetPath.string().c_str() );
+  }
+
+  for ( size_t i = 0; i < images.size(); ++i )
+  {
+    delete images[ i ];
+  }
+
+  return csv && written && !capture.stats().m_failed ? 0 : 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+int main( int argc, char** argv )
+{
+  HeadlessSettings settings;
+
+  if ( !parseArguments( argc, argv, settings ) )
+  {
+    printUsage();
+    return 1;
+  }
+
+  if ( !settings.m_makeTiles.empty() )
+  {
+    if ( !TiledImage::create( settings.m_makeTiles[ 0 ], settings.m_makeTiles[ 1 ], settings.m_rawSize ) )
+    {
+      printf( "could not write %s from %s\n", settings.m_makeTiles[ 1 ].string().c_str(), settings.m_makeTiles[ 0 ].string().c_str() );
+      return 1;
+    }
+    return 0;
+  }
+
+  if ( !settings.m_sweepPath.empty() )
+  {
+    return runSweep( settings );
+  }
+
+  Profiler::setThreadName( "main" );
+  if ( !settings.m_tracePath.empty() )
+  {
+    Profiler::enable( true );
+    if ( settings.m_counters && !Profiler::enableCounters( true ) )
+    {
+      printf( "cpu counters are not available, tracing without them\n" );
+    }
+  }
+
+  Particle::s_particleSizeRatio  = settings.m_particleSizeRatio;
+  Particle::s_particleSpeedRatio = settings.m_particleSpeedRatio;
+  Particle::s_dampness           = settings.m_dampness;
+  Particle::s_colorRedirection   = settings.m_colorRedirection;
+  Particle::s_sampleRadius       = settings.m_sampleRadius;
+
+  ParticleEmitter emitter;
+  emitter.m_repelStrength   = settings.m_repelStrength;
+  emitter.m_alignStrength   = settings.m_alignStrength;
+  emitter.m_attractStrength = settings.m_attractStrength;
+  emitter.m_zoneRadiusSqrd  = settings.m_zoneRadiusSqrd;
+  emitter.m_lowThresh       = settings.m_lowThresh;
+  emitter.m_highThresh      = settings.m_highThresh;
+  emitter.m_mergeGroups     = settings.m_mergeGroups;
+  emitter.m_flockSlices     = settings.m_flockSlices;
+  emitter.m_flockBudget     = settings.m_flockBudget;
+  emitter.m_barnesHut       = settings.m_openingAngle > 0.0f;
+  emitter.m_openingAngle    = settings.m_openingAngle;
+
+  if ( settings.m_seed >= 0 )
+  {
+    emitter.seed( static_cast< uint32_t >( settings.m_seed ) );
+  }
+
+  if ( !ci::fs::exists( settings.m_outputPath ) )
+  {
+    ci::fs::create_directories( settings.m_outputPath );
+  }
+
+  // simulated time keeps running across images, like in the app
+  double delta       = 1.0 / settings.m_framerate;
+  double currentTime = 0.0;
+
+  ImageLoader  loader( emitter.m_threadPool );
+  FrameCapture capture( std::max( settings.m_encoders, 1 ) );
+  ci::Vec2i   fitSize( settings.m_width, settings.m_height );
+  ci::Vec2f   previousSize( 0.0f, 0.0f );
+  FrameRing   ring;
+  uint64_t    ringFrame = 0;
+
+  if ( !settings.m_streamPath.empty() )
+  {
+    // offline, every step waits for its frame instead of holding the last
+    FrameSource source( emitter.m_threadPool );
+    bool        opened = settings.m_rawSize.x > 0 ? source.openRaw( settings.m_streamPath, settings.m_rawSize, fitSize ) : source.open( settings.m_streamPath, fitSize, false );
+    std::string stem   = settings.m_streamPath == "-" ? std::string( "stream" ) : settings.m_streamPath.stem().string();
+
+    source.m_blocking = true;
+
+    if ( !opened || !source.advance() )
+    {
+      printf( "could not read a frame from %s\n", settings.m_streamPath.string().c_str() );
+    }
+    else
+    {
+      PreparedImage*     first = source.current();
+      SoftwareRasterizer canvas( first->m_surface.getWidth(), first->m_surface.getHeight() );
+
+      emitter.m_frameSource      = &source;
+      emitter.m_referenceSurface = &first->m_surface;
+      emitter.m_steeringField    = &first->m_steeringField;
+      emitter.m_summedAreaTable  = &first->m_summedAreaTable;
+      emitter.m_position         = ci::Vec2f( 0.0f, 0.0f );
+      emitter.populate( settings.m_particleGroups, settings.m_particleCount );
+
+      std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+      int                                            frame = 0;
+
+      for ( ; ( settings.m_frames <= 0 || frame < settings.m_frames ) && !source.finished(); ++frame )
+      {
+        currentTime += delta;
+        emitter.update( currentTime, delta );
+
+        canvas.decay( settings.m_trailDecay, *emitter.m_threadPool );
+        emitter.rasterize( canvas );
+
+        if ( !settings.m_ringName.empty() )
+        {
+          exportFrame( settings, ring, canvas, *emitter.m_threadPool, ringFrame++ );
+        }
+
+        if ( settings.m_writeEvery > 0 && frame % settings.m_writeEvery == 0 )
+        {
+          writeFrame( capture, canvas, *emitter.m_threadPool, settings.m_outputPath / ( stem + "_" + ci::toString( frame ) + ".png" ) );
+        }
+      }
+
+      double seconds = std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - start ).count();
+
+      writeFrame( capture, canvas, *emitter.m_threadPool, settings.m_outputPath / ( stem + ".png" ) );
+      printf( "%s: %d frames of %d in %.3fs (%.1f fps)\n", stem.c_str(), frame, static_cast< int >( source.position() ), seconds, seconds > 0.0 ? frame / seconds : 0.0 );
+
+      if ( !settings.m_keepParticles )
+      {
+        emitter.killAll();
+      }
+      previousSize = source.current()->m_surface.getSize();
+    }
+
+    emitter.m_frameSource      = 0;
+    emitter.m_referenceSurface = 0;
+    emitter.m_steeringField    = 0;
+    emitter.m_summedAreaTable  = 0;
+  }
+
+  for ( size_t f = 0; f < settings.m_files.size(); ++f )
+  {
+    const ci::fs::path& file = settings.m_files[ f ];
+    std::string         stem = file.stem().string();
+    PreparedImage       image;
+
+    if ( file.extension() == ".ftl" )
+    {
+      renderTiled( settings, emitter, file, currentTime, previousSize );
+      continue;
+    }
+
+    // decode the next ones while this one renders
+    size_t prefetchEnd = std::min< size_t >( f + 1 + std::max( settings.m_prefetchDepth, 0 ), settings.m_files.size() );
+    loader.prefetch( std::vector< ci::fs::path >( settings.m_files.begin() + f, settings.m_files.begin() + prefetchEnd ), fitSize );
+
+    if ( !loader.take( file, fitSize, image ) )
+    {
+      printf( "could not load %s\n", file.string().c_str() );
+      continue;
+    }
+
+    ci::Surface&       surface = image.m_surface;
+    SoftwareRasterizer canvas( surface.getWidth(), surface.getHeight() );
+
+    emitter.m_referenceSurface = &surface;
+    emitter.m_steeringField    = &image.m_steeringField;
+    emitter.m_summedAreaTable  = &image.m_summedAreaTable;
+    emitter.m_position         = ci::Vec2f( 0.0f, 0.0f );
+
+    if ( settings.m_keepParticles )
+    {
+      emitter.retarget( previousSize, surface.getSize() );
+    }
+    emitter.populate( settings.m_particleGroups, settings.m_particleCount );
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    for ( int frame = 0; frame < settings.m_frames; ++frame )
+    {
+      currentTime += delta;
+      emitter.update( currentTime, delta );
+
+      canvas.decay( settings.m_trailDecay, *emitter.m_threadPool );
+      emitter.rasterize( canvas );
+
+      if ( !settings.m_ringName.empty() )
+      {
+        exportFrame( settings, ring, canvas, *emitter.m_threadPool, ringFrame++ );
+      }
+
+      if ( settings.m_writeEvery > 0 && frame % settings.m_writeEvery == 0 )
+      {
+        writeFrame( capture, canvas, *emitter.m_threadPool, settings.m_outputPath / ( stem + "_" + ci::toString( frame ) + ".png" ) );
+      }
+    }
+
+    double seconds = std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - start ).count();
+
+    writeFrame( capture, canvas, *emitter.m_threadPool, settings.m_outputPath / ( stem + ".png" ) );
+    printf( "%s: %d frames in %.3fs (%.1f fps)\n", stem.c_str(), settings.m_frames, seconds, seconds > 0.0 ? settings.m_frames / seconds : 0.0 );
+
+    if ( settings.m_seed >= 0 )
+    {
+      printf( "%s: state %016llx\n", stem.c_str(), static_cast< unsigned long long >( emitter.stateHash() ) );
+    }
+
+    if ( !settings.m_keepParticles )
+    {
+      emitter.killAll();
+    }
+    previousSize               = surface.getSize();
+    emitter.m_referenceSurface = 0;
+    emitter.m_steeringField    = 0;
+    emitter.m_summedAreaTable  = 0;
+  }
+
+  capture.flush();
+
+  if ( !settings.m_tracePath.empty() && !Profiler::writeChromeTrace( settings.m_tracePath ) )
+  {
+    printf( "could not write %s\n", settings.m_tracePath.string().c_str() );
+  }
+
+  if ( ring.isOpen() )
+  {
+    FrameRing::Stats ringStats = ring.stats();
+    printf( "ring %s: %d frames written, %d waited for the reader, %d dropped\n", settings.m_ringName.c_str(), static_cast< int >( ringStats.m_written ),
+            static_cast< int >( ringStats.m_delayed ), static_cast< int >( ringStats.m_dropped ) );
+    ring.close();
+  }
+
+  FrameCapture::Stats stats = capture.stats();
+  if ( stats.m_failed || stats.m_delayed )
+  {
+    printf( "frames: %d written, %d failed, %d waited for the encoders\n", static_cast< int >( stats.m_written ), static_cast< int >( stats.m_failed ), static_cast< int >( stats.m_delayed ) );
+  }
+
+  return stats.m_failed ? 1 : 0;
+}
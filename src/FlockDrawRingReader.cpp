@@ -0,0 +1,294 @@
+#include "FrameRing.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// seconds between two reports
+#define REPORT_EVERY         1.0
+// polls of an empty ring before sleeping between them
+#define READER_SPINS         64
+// seconds a closed ring gets to come back, a writer makes a new one when
+// its frames grow
+#define READER_FOLLOW        1.0
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// reads the frames FlockDraw or FlockDrawHeadless put in a shared memory
+// ring, the way a compositor would, and reports what arrives. the frames
+// are checksummed where they lie, nothing is copied.
+struct ReaderSettings
+{
+  ReaderSettings() :
+    m_frames( 0 ),
+    m_latest( false ),
+    m_wait( 10.0 )
+  {
+  }
+
+  std::string                 m_name;
+  std::string                 m_dumpPath;
+  int                         m_frames;
+  bool                        m_latest;
+  double                      m_wait;
+};
+
+struct ReaderStats
+{
+  ReaderStats() :
+    m_frames( 0 ),
+    m_bytes( 0 ),
+    m_skipped( 0 ),
+    m_latencySum( 0 ),
+    m_latencyMax( 0 ),
+    m_checksum( 0 )
+  {
+  }
+
+  uint64_t                    m_frames;
+  uint64_t                    m_bytes;
+  // frame ids that never arrived
+  uint64_t                    m_skipped;
+  uint64_t                    m_latencySum;
+  uint64_t                    m_latencyMax;
+  uint64_t                    m_checksum;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// set on ctrl-c or a kill, the ring is left through close() so the writer
+// does not wait for a reader that is gone
+static volatile sig_atomic_t s_stop = 0;
+
+static void onSignal( int )
+{
+  s_stop = 1;
+}
+
+static void printUsage()
+{
+  printf( "usage: FlockDrawRingReader [options] <name>\n"
+          "  --frames <n>           stop after n frames, 0 reads until the writer closes the ring (0)\n"
+          "  --latest               read only the newest frame instead of every one, never pacing the writer\n"
+          "  --dump <file.ppm>      write the first frame read\n"
+          "  --wait <s>             seconds to wait for the ring to show up (10)\n" );
+}
+
+static bool parseArguments( int _argc, char** _argv, ReaderSettings& _settings )
+{
+  for ( int i = 1; i < _argc; ++i )
+  {
+    std::string arg  = _argv[ i ];
+    bool        more = i + 1 < _argc;
+
+    if      ( arg == "--frames" && more ) { _settings.m_frames   = atoi( _argv[ ++i ] ); }
+    else if ( arg == "--latest" )         { _settings.m_latest   = true; }
+    else if ( arg == "--dump"   && more ) { _settings.m_dumpPath = _argv[ ++i ]; }
+    else if ( arg == "--wait"   && more ) { _settings.m_wait     = atof( _argv[ ++i ] ); }
+    else if ( arg.compare( 0, 2, "--" ) == 0 )
+    {
+      printf( "unknown or incomplete option %s\n", arg.c_str() );
+      return false;
+    }
+    else
+    {
+      _settings.m_name = arg;
+    }
+  }
+
+  return !_settings.m_name.empty();
+}
+
+static bool openRing( FrameRing& _ring, const std::string& _name, double _wait )
+{
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::microseconds( static_cast< int64_t >( _wait * 1e6 ) );
+
+  while ( !_ring.open( _name ) )
+  {
+    if ( s_stop || std::chrono::steady_clock::now() > deadline )
+    {
+      return false;
+    }
+    std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+  }
+
+  return true;
+}
+
+// reads every byte of the frame, as an upload or a blend would
+static uint64_t checksum( const FrameRing& _ring, const FrameRing::FrameHeader* _frame )
+{
+  const uint8_t* pixels = _ring.pixels( _frame );
+  size_t         row    = static_cast< size_t >( _frame->m_width ) * 3;
+  uint64_t       sum    = 0;
+
+  for ( uint32_t y = 0; y < _frame->m_height; ++y )
+  {
+    const uint8_t* pixel = pixels + static_cast< size_t >( y ) * _frame->m_stride;
+
+    for ( size_t x = 0; x < row; ++x )
+    {
+      sum += pixel[ x ];
+    }
+  }
+
+  return sum;
+}
+
+static bool writePPM( const std::string& _path, const FrameRing& _ring, const FrameRing::FrameHeader* _frame )
+{
+  FILE* file = fopen( _path.c_str(), "wb" );
+  if ( !file )
+  {
+    return false;
+  }
+
+  fprintf( file, "P6\n%u %u\n255\n", _frame->m_width, _frame->m_height );
+
+  const uint8_t* pixels  = _ring.pixels( _frame );
+  bool           bottom  = ( _frame->m_flags & FrameRing::FLAG_BOTTOM_UP ) != 0;
+  bool           written = true;
+
+  for ( uint32_t y = 0; y < _frame->m_height && written; ++y )
+  {
+    const uint8_t* row = pixels + static_cast< size_t >( bottom ? _frame->m_height - 1 - y : y ) * _frame->m_stride;
+    written = fwrite( row, 3, _frame->m_width, file ) == _frame->m_width;
+  }
+
+  return fclose( file ) == 0 && written;
+}
+
+static void report( const char* _label, const ReaderStats& _stats, double _seconds )
+{
+  printf( "%s%llu frames in %.2fs (%.1f fps, %.1f MB/s), %llu skipped, latency %.3f ms mean %.3f ms max, checksum %016llx\n", _label,
+          static_cast< unsigned long long >( _stats.m_frames ), _seconds, _seconds > 0.0 ? _stats.m_frames / _seconds : 0.0, _seconds > 0.0 ? _stats.m_bytes / _seconds / 1e6 : 0.0,
+          static_cast< unsigned long long >( _stats.m_skipped ), _stats.m_frames ? _stats.m_latencySum / 1e3 / _stats.m_frames : 0.0, _stats.m_latencyMax / 1e3,
+          static_cast< unsigned long long >( _stats.m_checksum ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+int main( int argc, char** argv )
+{
+  ReaderSettings settings;
+
+  if ( !parseArguments( argc, argv, settings ) )
+  {
+    printUsage();
+    return 1;
+  }
+
+  signal( SIGINT,  onSignal );
+  signal( SIGTERM, onSignal );
+
+  FrameRing ring;
+
+  if ( !openRing( ring, settings.m_name, settings.m_wait ) )
+  {
+    printf( "no ring %s\n", settings.m_name.c_str() );
+    return 1;
+  }
+
+  printf( "ring %s: %d x %d, %d slots\n", settings.m_name.c_str(), ring.getWidth(), ring.getHeight(), static_cast< int >( ring.getSlots() ) );
+
+  // whatever was written before anyone read is stale
+  ring.skipToLatest();
+
+  std::chrono::steady_clock::time_point start      = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point lastReport = start;
+  ReaderStats                           total;
+  ReaderStats                           interval;
+  int64_t                               lastId     = -1;
+  int                                   spins      = 0;
+  bool                                  dumped     = false;
+
+  while ( !s_stop && ( settings.m_frames <= 0 || total.m_frames < static_cast< uint64_t >( settings.m_frames ) ) )
+  {
+    if ( settings.m_latest )
+    {
+      ring.skipToLatest();
+    }
+
+    const FrameRing::FrameHeader* frame = ring.beginRead();
+
+    if ( !frame )
+    {
+      // the writer is gone, or made a new ring: follow it if it comes back
+      if ( ring.closed() )
+      {
+        ring.close();
+        if ( !openRing( ring, settings.m_name, READER_FOLLOW ) )
+        {
+          break;
+        }
+        lastId = -1;
+        continue;
+      }
+
+      if ( ++spins < READER_SPINS )
+      {
+        std::this_thread::yield();
+      }
+      else
+      {
+        std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+      }
+      continue;
+    }
+
+    spins = 0;
+
+    uint64_t latency = FrameRing::now() - frame->m_timestamp;
+    uint64_t sum     = checksum( ring, frame );
+    uint64_t skipped = lastId >= 0 && frame->m_frameId > static_cast< uint64_t >( lastId ) + 1 ? frame->m_frameId - lastId - 1 : 0;
+    lastId = static_cast< int64_t >( frame->m_frameId );
+
+    ReaderStats* stats[ 2 ] = { &total, &interval };
+    for ( int s = 0; s < 2; ++s )
+    {
+      stats[ s ]->m_frames     += 1;
+      stats[ s ]->m_bytes      += static_cast< uint64_t >( frame->m_width ) * frame->m_height * 3;
+      stats[ s ]->m_skipped    += skipped;
+      stats[ s ]->m_latencySum += latency;
+      stats[ s ]->m_latencyMax  = std::max( stats[ s ]->m_latencyMax, latency );
+      stats[ s ]->m_checksum   += sum;
+    }
+
+    if ( !settings.m_dumpPath.empty() && total.m_frames == 1 )
+    {
+      dumped = writePPM( settings.m_dumpPath, ring, frame );
+    }
+
+    ring.endRead();
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double                                elapsed = std::chrono::duration< double >( now - lastReport ).count();
+
+    if ( elapsed >= REPORT_EVERY )
+    {
+      report( "", interval, elapsed );
+      interval   = ReaderStats();
+      lastReport = now;
+    }
+  }
+
+  ring.close();
+  report( "total: ", total, std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count() );
+
+  if ( !settings.m_dumpPath.empty() && !dumped )
+  {
+    printf( "could not write %s\n", settings.m_dumpPath.c_str() );
+  }
+
+  return total.m_frames ? 0 : 1;
+}
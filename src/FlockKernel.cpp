@@ -0,0 +1,616 @@
+#include "FlockKernel.h"
+
+#include <cmath>
+#include <cassert>
+#include <vector>
+#include <algorithm>
+
+#if defined _M_IX86 || defined _M_X64 || defined __i386__ || defined __x86_64__
+#define FLOCK_KERNEL_X86
+#include <immintrin.h>
+#if defined _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined __GNUC__
+#define FLOCK_TARGET( x ) __attribute__(( target( x ) ))
+#else
+#define FLOCK_TARGET( x )
+#endif
+
+#define PI            3.14159265359f
+#define PI2           6.28318530718f
+#define MIN_STRENGTH  0.0001f
+
+FlockKernel::Function FlockKernel::s_function = &FlockKernel::scalar;
+FlockKernel::Mode     FlockKernel::s_mode     = FlockKernel::MODE_AUTO;
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+  // per call constants shared by the SIMD paths. the strengths are zeroed
+  // when below the threshold the scalar path uses to skip a zone.
+  struct Constants
+  {
+    Constants( const FlockKernel::Params& _params )
+    {
+      float repel     = _params.m_repelStrength   < MIN_STRENGTH ? 0.0f : _params.m_repelStrength;
+      float align     = _params.m_alignStrength   < MIN_STRENGTH ? 0.0f : _params.m_alignStrength;
+      float attract   = _params.m_attractStrength < MIN_STRENGTH ? 0.0f : _params.m_attractStrength;
+
+      m_separation    = _params.m_lowThresh * repel * _params.m_updateRatio;
+      m_alignment     = align   * _params.m_updateRatio;
+      m_cohesion      = attract * _params.m_updateRatio;
+      m_invAlignDelta = 1.0f / ( _params.m_highThresh - _params.m_lowThresh );
+      m_invCohDelta   = 1.0f / ( 1.0f - _params.m_highThresh );
+    }
+
+    float m_separation;
+    float m_alignment;
+    float m_cohesion;
+    float m_invAlignDelta;
+    float m_invCohDelta;
+  };
+
+#if defined FLOCK_KERNEL_X86
+  bool cpuHasSse41()
+  {
+#if defined _MSC_VER
+    int info[ 4 ];
+    __cpuid( info, 1 );
+    return ( info[ 2 ] & ( 1 << 19 ) ) != 0;
+#else
+    return __builtin_cpu_supports( "sse4.1" ) != 0;
+#endif
+  }
+
+  bool cpuHasAvx2()
+  {
+#if defined _MSC_VER
+    int info[ 4 ];
+    __cpuid( info, 1 );
+
+    // the OS has to save the ymm registers too
+    bool osxsave = ( info[ 2 ] & ( 1 << 27 ) ) != 0;
+    bool avx     = ( info[ 2 ] & ( 1 << 28 ) ) != 0;
+    if ( !osxsave || !avx || ( _xgetbv( 0 ) & 6 ) != 6 )
+    {
+      return false;
+    }
+
+    __cpuidex( info, 7, 0 );
+    return ( info[ 1 ] & ( 1 << 5 ) ) != 0;
+#else
+    return __builtin_cpu_supports( "avx2" ) != 0;
+#endif
+  }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void FlockKernel::select( Mode _mode )
+{
+  if ( _mode == MODE_AUTO )
+  {
+    _mode = isSupported( MODE_AVX2 ) ? MODE_AVX2 : ( isSupported( MODE_SSE41 ) ? MODE_SSE41 : MODE_SCALAR );
+  }
+  else if ( !isSupported( _mode ) )
+  {
+    _mode = MODE_SCALAR;
+  }
+
+  switch ( _mode )
+  {
+  case MODE_AVX2:  s_function = &FlockKernel::avx2;   break;
+  case MODE_SSE41: s_function = &FlockKernel::sse41;  break;
+  default:         s_function = &FlockKernel::scalar; break;
+  }
+
+  s_mode = _mode;
+
+#if defined _DEBUG
+  assert( validate() );
+#endif
+}
+
+const char* FlockKernel::modeName( Mode _mode )
+{
+  switch ( _mode )
+  {
+  case MODE_AUTO:   return "auto";
+  case MODE_SCALAR: return "scalar";
+  case MODE_SSE41:  return "sse4.1";
+  case MODE_AVX2:   return "avx2";
+  }
+  return "unknown";
+}
+
+bool FlockKernel::isSupported( Mode _mode )
+{
+  switch ( _mode )
+  {
+  case MODE_AUTO:
+  case MODE_SCALAR:
+    return true;
+#if defined FLOCK_KERNEL_X86
+  case MODE_SSE41:
+    return cpuHasSse41();
+  case MODE_AVX2:
+    return cpuHasAvx2();
+#endif
+  default:
+    return false;
+  }
+}
+
+bool FlockKernel::validate( float _tolerance )
+{
+  Mode modes[] = { MODE_SSE41, MODE_AVX2 };
+
+  for ( int m = 0; m < 2; ++m )
+  {
+    if ( isSupported( modes[ m ] ) && !validate( modes[ m ], _tolerance ) )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool FlockKernel::validate( Mode _mode, float _tolerance )
+{
+  Function path;
+
+  switch ( _mode )
+  {
+  case MODE_AUTO:
+  case MODE_SCALAR: return true;
+  case MODE_SSE41:  path = &FlockKernel::sse41; break;
+  case MODE_AVX2:   path = &FlockKernel::avx2;  break;
+  default:          return false;
+  }
+
+  if ( !isSupported( _mode ) )
+  {
+    return false;
+  }
+
+  // deterministic pseudo random neighborhood around a particle, with
+  // neighbors across the wrap and in every zone
+  const size_t        count = 67;
+  std::vector< float > x( count ), y( count ), dirX( count ), dirY( count );
+  unsigned int        seed  = 12345;
+
+  Params params;
+  params.m_bounds          = ci::Vec2f( 200.0f, 150.0f );
+  params.m_zoneRadiusSqrd  = 75.0f * 75.0f;
+  params.m_lowThresh       = 0.125f;
+  params.m_highThresh      = 0.65f;
+  params.m_repelStrength   = 2.0f;
+  params.m_alignStrength   = 2.0f;
+  params.m_attractStrength = 1.0f;
+  params.m_updateRatio     = 1.0f;
+
+  for ( size_t i = 0; i < count; ++i )
+  {
+    seed      = seed * 1103515245 + 12345;
+    x[ i ]    = ( ( seed >> 8 ) & 0xffff ) / 65535.0f * params.m_bounds.x;
+    seed      = seed * 1103515245 + 12345;
+    y[ i ]    = ( ( seed >> 8 ) & 0xffff ) / 65535.0f * params.m_bounds.y;
+    seed      = seed * 1103515245 + 12345;
+    float a   = ( ( seed >> 8 ) & 0xffff ) / 65535.0f * PI2;
+    dirX[ i ] = cos( a );
+    dirY[ i ] = sin( a );
+  }
+
+  Neighbors neighbors = { &x[ 0 ], &y[ 0 ], &dirX[ 0 ], &dirY[ 0 ] };
+
+  // odd spans exercise the remainder handling too
+  for ( size_t i = 0; i < count; ++i )
+  {
+    float refX = 0.0f, refY = 0.0f, simdX = 0.0f, simdY = 0.0f;
+    size_t end = count - i % 7;
+
+    scalar( params, neighbors, i % 5, end, x[ i ], y[ i ], refX, refY );
+    path(   params, neighbors, i % 5, end, x[ i ], y[ i ], simdX, simdY );
+
+    if ( fabs( refX - simdX ) > _tolerance * ( 1.0f + fabs( refX ) ) ||
+         fabs( refY - simdY ) > _tolerance * ( 1.0f + fabs( refY ) ) )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void FlockKernel::cohesion( const Params& _params, const ci::Vec2f& _offset, float _mass, ci::Vec2f& _acceleration )
+{
+  float distSqrd = _offset.lengthSquared();
+
+  if ( _params.m_attractStrength < MIN_STRENGTH || distSqrd >= _params.m_zoneRadiusSqrd || distSqrd <= 0.0f )
+  {
+    return;
+  }
+
+  float percent = distSqrd / _params.m_zoneRadiusSqrd;
+
+  // the scalar path's cohesion band, past both the repel and the align zone
+  if ( percent < std::max( _params.m_lowThresh, _params.m_highThresh ) )
+  {
+    return;
+  }
+
+  // same falloff as the scalar path, once for the whole mass
+  float threshDelta     = 1.0f - _params.m_highThresh;
+  float adjustedPercent = ( percent - _params.m_highThresh ) / threshDelta;
+  float F               = ( 1.0f - ( cos( adjustedPercent * PI2 ) * -0.5f + 0.5f ) ) * _params.m_attractStrength * _params.m_updateRatio;
+
+  _acceleration -= _offset.normalized() * ( F * _mass );
+}
+
+void FlockKernel::scalar( const Params& _params, const Neighbors& _neighbors, size_t _begin, size_t _end, float _x, float _y, float& _accelerationX, float& _accelerationY )
+{
+  ci::Vec2f halfBounds = _params.m_bounds * 0.5f;
+  ci::Vec2f acceleration( _accelerationX, _accelerationY );
+
+  for ( size_t i = _begin; i < _end; ++i )
+  {
+    ci::Vec2f dir( _x - _neighbors.m_x[ i ], _y - _neighbors.m_y[ i ] );
+
+    // shortest way around the wrap
+    if ( dir.x > halfBounds.x )
+    {
+      dir.x -= _params.m_bounds.x;
+    }
+    else if ( dir.x < -halfBounds.x )
+    {
+      dir.x += _params.m_bounds.x;
+    }
+
+    if ( dir.y > halfBounds.y )
+    {
+      dir.y -= _params.m_bounds.y;
+    }
+    else if ( dir.y < -halfBounds.y )
+    {
+      dir.y += _params.m_bounds.y;
+    }
+
+    float distSqrd = dir.lengthSquared();
+
+    if ( distSqrd < _params.m_zoneRadiusSqrd && distSqrd > 0.0f ) // Neighbor is in the zone
+    {
+      float percent = distSqrd / _params.m_zoneRadiusSqrd;
+
+      if( percent < _params.m_lowThresh )       // Separation
+      {
+        if ( _params.m_repelStrength < MIN_STRENGTH )
+        {
+          continue;
+        }
+
+        float F = _params.m_lowThresh * _params.m_repelStrength * _params.m_updateRatio;
+        dir = dir.normalized() * F;
+
+        acceleration += dir;
+      }
+      else if( percent < _params.m_highThresh ) // Alignment
+      {
+        if ( _params.m_alignStrength < MIN_STRENGTH )
+        {
+          continue;
+        }
+
+        float threshDelta     = _params.m_highThresh - _params.m_lowThresh;
+        float adjustedPercent = ( percent - _params.m_lowThresh ) / threshDelta;
+        float F               = ( 1.0f - ( cos( adjustedPercent * PI2 ) * -0.5f + 0.5f ) ) * _params.m_alignStrength * _params.m_updateRatio;
+
+        acceleration += ci::Vec2f( _neighbors.m_dirX[ i ], _neighbors.m_dirY[ i ] ) * F;
+      }
+      else                                      // Cohesion
+      {
+        if ( _params.m_attractStrength < MIN_STRENGTH )
+        {
+          continue;
+        }
+
+        float threshDelta     = 1.0f - _params.m_highThresh;
+        float adjustedPercent = ( percent - _params.m_highThresh ) / threshDelta;
+        float F               = ( 1.0f - ( cos( adjustedPercent * PI2 ) * -0.5f + 0.5f ) ) * _params.m_attractStrength * _params.m_updateRatio;
+
+        dir.normalize();
+        dir *= F;
+
+        acceleration -= dir;
+      }
+    }
+  }
+
+  _accelerationX = acceleration.x;
+  _accelerationY = acceleration.y;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// both SIMD paths evaluate every zone for every lane and blend by mask. the
+// zone falloff 0.5 + 0.5 * cos( 2 PI a ) is computed as sin^2( PI ( a - 0.5 ) )
+// with a polynomial, since a lies in [ 0, 1 ) in every lane that is kept.
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined FLOCK_KERNEL_X86
+
+#define SIN_C3  -1.6666666666666666e-1f
+#define SIN_C5   8.3333333333333333e-3f
+#define SIN_C7  -1.9841269841269841e-4f
+#define SIN_C9   2.7557319223985888e-6f
+#define SIN_C11 -2.5052108385441720e-8f
+
+FLOCK_TARGET( "sse4.1" )
+static inline __m128 falloff4( __m128 _adjusted )
+{
+  __m128 u  = _mm_mul_ps( _mm_sub_ps( _adjusted, _mm_set1_ps( 0.5f ) ), _mm_set1_ps( PI ) );
+  __m128 u2 = _mm_mul_ps( u, u );
+  __m128 p  = _mm_set1_ps( SIN_C11 );
+
+  p = _mm_add_ps( _mm_mul_ps( p, u2 ), _mm_set1_ps( SIN_C9 ) );
+  p = _mm_add_ps( _mm_mul_ps( p, u2 ), _mm_set1_ps( SIN_C7 ) );
+  p = _mm_add_ps( _mm_mul_ps( p, u2 ), _mm_set1_ps( SIN_C5 ) );
+  p = _mm_add_ps( _mm_mul_ps( p, u2 ), _mm_set1_ps( SIN_C3 ) );
+  p = _mm_add_ps( _mm_mul_ps( p, u2 ), _mm_set1_ps( 1.0f ) );
+
+  __m128 s  = _mm_mul_ps( p, u );
+  return _mm_mul_ps( s, s );
+}
+
+FLOCK_TARGET( "sse4.1" )
+void FlockKernel::sse41( const Params& _params, const Neighbors& _neighbors, size_t _begin, size_t _end, float _x, float _y, float& _accelerationX, float& _accelerationY )
+{
+  Constants    constants( _params );
+  const __m128 px            = _mm_set1_ps( _x );
+  const __m128 py            = _mm_set1_ps( _y );
+  const __m128 boundsX       = _mm_set1_ps( _params.m_bounds.x );
+  const __m128 boundsY       = _mm_set1_ps( _params.m_bounds.y );
+  const __m128 halfX         = _mm_set1_ps( _params.m_bounds.x *  0.5f );
+  const __m128 halfY         = _mm_set1_ps( _params.m_bounds.y *  0.5f );
+  const __m128 negHalfX      = _mm_set1_ps( _params.m_bounds.x * -0.5f );
+  const __m128 negHalfY      = _mm_set1_ps( _params.m_bounds.y * -0.5f );
+  const __m128 zone          = _mm_set1_ps( _params.m_zoneRadiusSqrd );
+  const __m128 low           = _mm_set1_ps( _params.m_lowThresh );
+  const __m128 high          = _mm_set1_ps( _params.m_highThresh );
+  const __m128 invAlignDelta = _mm_set1_ps( constants.m_invAlignDelta );
+  const __m128 invCohDelta   = _mm_set1_ps( constants.m_invCohDelta );
+  const __m128 separation    = _mm_set1_ps( constants.m_separation );
+  const __m128 alignment     = _mm_set1_ps( constants.m_alignment );
+  const __m128 cohesion      = _mm_set1_ps( constants.m_cohesion );
+  const __m128 zero          = _mm_setzero_ps();
+
+  __m128 accX = zero;
+  __m128 accY = zero;
+
+  // the tail is padded with the particle's own position, which is skipped
+  float  tailX[ 4 ], tailY[ 4 ], tailDirX[ 4 ], tailDirY[ 4 ];
+
+  for ( size_t i = _begin; i < _end; i += 4 )
+  {
+    __m128 x, y, dirX, dirY;
+
+    if ( i + 4 <= _end )
+    {
+      x    = _mm_loadu_ps( _neighbors.m_x    + i );
+      y    = _mm_loadu_ps( _neighbors.m_y    + i );
+      dirX = _mm_loadu_ps( _neighbors.m_dirX + i );
+      dirY = _mm_loadu_ps( _neighbors.m_dirY + i );
+    }
+    else
+    {
+      for ( size_t j = 0; j < 4; ++j )
+      {
+        bool valid    = i + j < _end;
+        tailX[ j ]    = valid ? _neighbors.m_x[ i + j ]    : _x;
+        tailY[ j ]    = valid ? _neighbors.m_y[ i + j ]    : _y;
+        tailDirX[ j ] = valid ? _neighbors.m_dirX[ i + j ] : 0.0f;
+        tailDirY[ j ] = valid ? _neighbors.m_dirY[ i + j ] : 0.0f;
+      }
+
+      x    = _mm_loadu_ps( tailX );
+      y    = _mm_loadu_ps( tailY );
+      dirX = _mm_loadu_ps( tailDirX );
+      dirY = _mm_loadu_ps( tailDirY );
+    }
+
+    // wrapped delta
+    __m128 dx = _mm_sub_ps( px, x );
+    __m128 dy = _mm_sub_ps( py, y );
+    dx = _mm_sub_ps( dx, _mm_and_ps( _mm_cmpgt_ps( dx, halfX    ), boundsX ) );
+    dx = _mm_add_ps( dx, _mm_and_ps( _mm_cmplt_ps( dx, negHalfX ), boundsX ) );
+    dy = _mm_sub_ps( dy, _mm_and_ps( _mm_cmpgt_ps( dy, halfY    ), boundsY ) );
+    dy = _mm_add_ps( dy, _mm_and_ps( _mm_cmplt_ps( dy, negHalfY ), boundsY ) );
+
+    __m128 distSqrd   = _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) );
+    __m128 inZone     = _mm_and_ps( _mm_cmplt_ps( distSqrd, zone ), _mm_cmpgt_ps( distSqrd, zero ) );
+
+    if ( _mm_movemask_ps( inZone ) == 0 )
+    {
+      continue;
+    }
+
+    __m128 percent    = _mm_div_ps( distSqrd, zone );
+    __m128 isSep      = _mm_cmplt_ps( percent, low );
+    __m128 belowHigh  = _mm_cmplt_ps( percent, high );
+    __m128 isAlign    = _mm_andnot_ps( isSep, belowHigh );
+    __m128 isCoh      = _mm_andnot_ps( _mm_or_ps( isSep, belowHigh ), inZone );
+
+    // one falloff evaluation serves both the alignment and cohesion lanes
+    __m128 adjusted   = _mm_blendv_ps( _mm_mul_ps( _mm_sub_ps( percent, high ), invCohDelta   ),
+                                       _mm_mul_ps( _mm_sub_ps( percent, low  ), invAlignDelta ),
+                                       isAlign );
+    __m128 falloff    = falloff4( adjusted );
+
+    __m128 alignF     = _mm_and_ps( isAlign, _mm_mul_ps( falloff, alignment ) );
+    __m128 radialF    = _mm_sub_ps( _mm_and_ps( isSep, separation ),
+                                    _mm_and_ps( isCoh, _mm_mul_ps( falloff, cohesion ) ) );
+    __m128 length     = _mm_sqrt_ps( distSqrd );
+
+    __m128 forceX     = _mm_add_ps( _mm_mul_ps( _mm_div_ps( dx, length ), radialF ), _mm_mul_ps( dirX, alignF ) );
+    __m128 forceY     = _mm_add_ps( _mm_mul_ps( _mm_div_ps( dy, length ), radialF ), _mm_mul_ps( dirY, alignF ) );
+
+    accX = _mm_add_ps( accX, _mm_and_ps( inZone, forceX ) );
+    accY = _mm_add_ps( accY, _mm_and_ps( inZone, forceY ) );
+  }
+
+  // horizontal sums
+  __m128 sum = _mm_hadd_ps( accX, accY );
+  sum        = _mm_hadd_ps( sum, sum );
+
+  float result[ 4 ];
+  _mm_storeu_ps( result, sum );
+
+  _accelerationX += result[ 0 ];
+  _accelerationY += result[ 1 ];
+}
+
+FLOCK_TARGET( "avx2" )
+static inline __m256 falloff8( __m256 _adjusted )
+{
+  __m256 u  = _mm256_mul_ps( _mm256_sub_ps( _adjusted, _mm256_set1_ps( 0.5f ) ), _mm256_set1_ps( PI ) );
+  __m256 u2 = _mm256_mul_ps( u, u );
+  __m256 p  = _mm256_set1_ps( SIN_C11 );
+
+  p = _mm256_add_ps( _mm256_mul_ps( p, u2 ), _mm256_set1_ps( SIN_C9 ) );
+  p = _mm256_add_ps( _mm256_mul_ps( p, u2 ), _mm256_set1_ps( SIN_C7 ) );
+  p = _mm256_add_ps( _mm256_mul_ps( p, u2 ), _mm256_set1_ps( SIN_C5 ) );
+  p = _mm256_add_ps( _mm256_mul_ps( p, u2 ), _mm256_set1_ps( SIN_C3 ) );
+  p = _mm256_add_ps( _mm256_mul_ps( p, u2 ), _mm256_set1_ps( 1.0f ) );
+
+  __m256 s  = _mm256_mul_ps( p, u );
+  return _mm256_mul_ps( s, s );
+}
+
+FLOCK_TARGET( "avx2" )
+void FlockKernel::avx2( const Params& _params, const Neighbors& _neighbors, size_t _begin, size_t _end, float _x, float _y, float& _accelerationX, float& _accelerationY )
+{
+  Constants    constants( _params );
+  const __m256 px            = _mm256_set1_ps( _x );
+  const __m256 py            = _mm256_set1_ps( _y );
+  const __m256 boundsX       = _mm256_set1_ps( _params.m_bounds.x );
+  const __m256 boundsY       = _mm256_set1_ps( _params.m_bounds.y );
+  const __m256 halfX         = _mm256_set1_ps( _params.m_bounds.x *  0.5f );
+  const __m256 halfY         = _mm256_set1_ps( _params.m_bounds.y *  0.5f );
+  const __m256 negHalfX      = _mm256_set1_ps( _params.m_bounds.x * -0.5f );
+  const __m256 negHalfY      = _mm256_set1_ps( _params.m_bounds.y * -0.5f );
+  const __m256 zone          = _mm256_set1_ps( _params.m_zoneRadiusSqrd );
+  const __m256 low           = _mm256_set1_ps( _params.m_lowThresh );
+  const __m256 high          = _mm256_set1_ps( _params.m_highThresh );
+  const __m256 invAlignDelta = _mm256_set1_ps( constants.m_invAlignDelta );
+  const __m256 invCohDelta   = _mm256_set1_ps( constants.m_invCohDelta );
+  const __m256 separation    = _mm256_set1_ps( constants.m_separation );
+  const __m256 alignment     = _mm256_set1_ps( constants.m_alignment );
+  const __m256 cohesion      = _mm256_set1_ps( constants.m_cohesion );
+  const __m256 zero          = _mm256_setzero_ps();
+
+  __m256 accX = zero;
+  __m256 accY = zero;
+
+  // the tail is padded with the particle's own position, which is skipped
+  float  tailX[ 8 ], tailY[ 8 ], tailDirX[ 8 ], tailDirY[ 8 ];
+
+  for ( size_t i = _begin; i < _end; i += 8 )
+  {
+    __m256 x, y, dirX, dirY;
+
+    if ( i + 8 <= _end )
+    {
+      x    = _mm256_loadu_ps( _neighbors.m_x    + i );
+      y    = _mm256_loadu_ps( _neighbors.m_y    + i );
+      dirX = _mm256_loadu_ps( _neighbors.m_dirX + i );
+      dirY = _mm256_loadu_ps( _neighbors.m_dirY + i );
+    }
+    else
+    {
+      for ( size_t j = 0; j < 8; ++j )
+      {
+        bool valid    = i + j < _end;
+        tailX[ j ]    = valid ? _neighbors.m_x[ i + j ]    : _x;
+        tailY[ j ]    = valid ? _neighbors.m_y[ i + j ]    : _y;
+        tailDirX[ j ] = valid ? _neighbors.m_dirX[ i + j ] : 0.0f;
+        tailDirY[ j ] = valid ? _neighbors.m_dirY[ i + j ] : 0.0f;
+      }
+
+      x    = _mm256_loadu_ps( tailX );
+      y    = _mm256_loadu_ps( tailY );
+      dirX = _mm256_loadu_ps( tailDirX );
+      dirY = _mm256_loadu_ps( tailDirY );
+    }
+
+    // wrapped delta
+    __m256 dx = _mm256_sub_ps( px, x );
+    __m256 dy = _mm256_sub_ps( py, y );
+    dx = _mm256_sub_ps( dx, _mm256_and_ps( _mm256_cmp_ps( dx, halfX,    _CMP_GT_OQ ), boundsX ) );
+    dx = _mm256_add_ps( dx, _mm256_and_ps( _mm256_cmp_ps( dx, negHalfX, _CMP_LT_OQ ), boundsX ) );
+    dy = _mm256_sub_ps( dy, _mm256_and_ps( _mm256_cmp_ps( dy, halfY,    _CMP_GT_OQ ), boundsY ) );
+    dy = _mm256_add_ps( dy, _mm256_and_ps( _mm256_cmp_ps( dy, negHalfY, _CMP_LT_OQ ), boundsY ) );
+
+    __m256 distSqrd   = _mm256_add_ps( _mm256_mul_ps( dx, dx ), _mm256_mul_ps( dy, dy ) );
+    __m256 inZone     = _mm256_and_ps( _mm256_cmp_ps( distSqrd, zone, _CMP_LT_OQ ), _mm256_cmp_ps( distSqrd, zero, _CMP_GT_OQ ) );
+
+    if ( _mm256_movemask_ps( inZone ) == 0 )
+    {
+      continue;
+    }
+
+    __m256 percent    = _mm256_div_ps( distSqrd, zone );
+    __m256 isSep      = _mm256_cmp_ps( percent, low,  _CMP_LT_OQ );
+    __m256 belowHigh  = _mm256_cmp_ps( percent, high, _CMP_LT_OQ );
+    __m256 isAlign    = _mm256_andnot_ps( isSep, belowHigh );
+    __m256 isCoh      = _mm256_andnot_ps( _mm256_or_ps( isSep, belowHigh ), inZone );
+
+    // one falloff evaluation serves both the alignment and cohesion lanes
+    __m256 adjusted   = _mm256_blendv_ps( _mm256_mul_ps( _mm256_sub_ps( percent, high ), invCohDelta   ),
+                                          _mm256_mul_ps( _mm256_sub_ps( percent, low  ), invAlignDelta ),
+                                          isAlign );
+    __m256 falloff    = falloff8( adjusted );
+
+    __m256 alignF     = _mm256_and_ps( isAlign, _mm256_mul_ps( falloff, alignment ) );
+    __m256 radialF    = _mm256_sub_ps( _mm256_and_ps( isSep, separation ),
+                                       _mm256_and_ps( isCoh, _mm256_mul_ps( falloff, cohesion ) ) );
+    __m256 length     = _mm256_sqrt_ps( distSqrd );
+
+    __m256 forceX     = _mm256_add_ps( _mm256_mul_ps( _mm256_div_ps( dx, length ), radialF ), _mm256_mul_ps( dirX, alignF ) );
+    __m256 forceY     = _mm256_add_ps( _mm256_mul_ps( _mm256_div_ps( dy, length ), radialF ), _mm256_mul_ps( dirY, alignF ) );
+
+    accX = _mm256_add_ps( accX, _mm256_and_ps( inZone, forceX ) );
+    accY = _mm256_add_ps( accY, _mm256_and_ps( inZone, forceY ) );
+  }
+
+  // horizontal sums
+  __m128 sumX = _mm_add_ps( _mm256_castps256_ps128( accX ), _mm256_extractf128_ps( accX, 1 ) );
+  __m128 sumY = _mm_add_ps( _mm256_castps256_ps128( accY ), _mm256_extractf128_ps( accY, 1 ) );
+  __m128 sum  = _mm_hadd_ps( sumX, sumY );
+  sum         = _mm_hadd_ps( sum, sum );
+
+  float result[ 4 ];
+  _mm_storeu_ps( result, sum );
+
+  _accelerationX += result[ 0 ];
+  _accelerationY += result[ 1 ];
+}
+
+#else // FLOCK_KERNEL_X86
+
+void FlockKernel::sse41( const Params& _params, const Neighbors& _neighbors, size_t _begin, size_t _end, float _x, float _y, float& _accelerationX, float& _accelerationY )
+{
+  scalar( _params, _neighbors, _begin, _end, _x, _y, _accelerationX, _accelerationY );
+}
+
+void FlockKernel::avx2( const Params& _params, const Neighbors& _neighbors, size_t _begin, size_t _end, float _x, float _y, float& _accelerationX, float& _accelerationY )
+{
+  scalar( _params, _neighbors, _begin, _end, _x, _y, _accelerationX, _accelerationY );
+}
+
+#endif // FLOCK_KERNEL_X86
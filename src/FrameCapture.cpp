@@ -0,0 +1,172 @@
+#include "FrameCapture.h"
+#include "Profiler.h"
+#include "cinder/ImageIo.h"
+#include "cinder/ip/Flip.h"
+
+FrameCapture::FrameCapture( size_t _encoders, size_t _frames ) :
+  m_dropWhenFull( false ),
+  m_maxFrames( _frames ? _frames : 1 ),
+  m_encoding( 0 ),
+  m_stop( false )
+{
+  resetStats();
+
+  for ( size_t i = 0; i < ( _encoders ? _encoders : 1 ); ++i )
+  {
+    m_encoders.push_back( std::thread( &FrameCapture::encoderLoop, this ) );
+  }
+}
+
+FrameCapture::~FrameCapture( void )
+{
+  flush();
+
+  {
+    std::lock_guard< std::mutex > l( m_lock );
+    m_stop = true;
+  }
+  m_jobReady.notify_all();
+
+  for ( auto& encoder : m_encoders )
+  {
+    encoder.join();
+  }
+
+  for ( auto frame : m_frames )
+  {
+    delete frame;
+  }
+}
+
+ci::Surface* FrameCapture::acquire( int _width, int _height )
+{
+  std::unique_lock< std::mutex > l( m_lock );
+
+  if ( m_free.empty() && m_frames.size() >= m_maxFrames )
+  {
+    if ( m_dropWhenFull )
+    {
+      ++m_stats.m_dropped;
+      return 0;
+    }
+
+    ++m_stats.m_delayed;
+    m_frameFree.wait( l, [ this ](){ return !m_free.empty(); } );
+  }
+
+  ci::Surface* frame;
+
+  if ( m_free.empty() )
+  {
+    frame = new ci::Surface();
+    m_frames.push_back( frame );
+  }
+  else
+  {
+    frame = m_free.back();
+    m_free.pop_back();
+  }
+
+  // buffers are only reallocated when the capture size changes
+  if ( frame->getWidth() != _width || frame->getHeight() != _height )
+  {
+    *frame = ci::Surface( _width, _height, false, ci::SurfaceChannelOrder::RGB );
+  }
+
+  return frame;
+}
+
+void FrameCapture::submit( ci::Surface* _frame, const ci::fs::path& _path, bool _flip )
+{
+  Job job;
+  job.m_frame = _frame;
+  job.m_path  = _path;
+  job.m_flip  = _flip;
+
+  {
+    std::lock_guard< std::mutex > l( m_lock );
+    m_jobs.push_back( job );
+    ++m_stats.m_submitted;
+  }
+  m_jobReady.notify_one();
+}
+
+void FrameCapture::release( ci::Surface* _frame )
+{
+  {
+    std::lock_guard< std::mutex > l( m_lock );
+    m_free.push_back( _frame );
+  }
+  m_frameFree.notify_all();
+}
+
+void FrameCapture::flush()
+{
+  std::unique_lock< std::mutex > l( m_lock );
+  m_frameFree.wait( l, [ this ](){ return m_jobs.empty() && m_encoding == 0; } );
+}
+
+FrameCapture::Stats FrameCapture::stats()
+{
+  std::lock_guard< std::mutex > l( m_lock );
+  Stats stats     = m_stats;
+  stats.m_pending = m_jobs.size() + m_encoding;
+  return stats;
+}
+
+void FrameCapture::resetStats()
+{
+  std::lock_guard< std::mutex > l( m_lock );
+  m_stats.m_submitted = 0;
+  m_stats.m_written   = 0;
+  m_stats.m_failed    = 0;
+  m_stats.m_delayed   = 0;
+  m_stats.m_dropped   = 0;
+  m_stats.m_pending   = 0;
+}
+
+void FrameCapture::encoderLoop()
+{
+  Profiler::setThreadName( "encoder" );
+
+  std::unique_lock< std::mutex > l( m_lock );
+
+  while ( true )
+  {
+    m_jobReady.wait( l, [ this ](){ return m_stop || !m_jobs.empty(); } );
+
+    if ( m_jobs.empty() )
+    {
+      return;
+    }
+
+    // frames leave the queue in order, they are encoded side by side
+    Job job = m_jobs.front();
+    m_jobs.pop_front();
+    ++m_encoding;
+    l.unlock();
+
+    bool written = true;
+    {
+      ProfileScope profile( Profiler::PHASE_ENCODE );
+      try
+      {
+        if ( job.m_flip )
+        {
+          ci::ip::flipVertical( job.m_frame );
+        }
+        ci::writeImage( job.m_path, *job.m_frame );
+      }
+      catch ( ... )
+      {
+        written = false;
+      }
+    }
+
+    l.lock();
+    --m_encoding;
+    ++( written ? m_stats.m_written : m_stats.m_failed );
+    m_free.push_back( job.m_frame );
+    m_frameFree.notify_all();
+  }
+}
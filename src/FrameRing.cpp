@@ -0,0 +1,463 @@
+#include "FrameRing.h"
+
+#include <cstring>
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#if defined _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define FRAME_RING_MAGIC     "FDRING01"
+// the slots start past the header, every slot on its own pages
+#define FRAME_RING_HEADER    4096
+#define FRAME_RING_PAGE      4096
+// tries before the writer waiting for a slot sleeps instead of yielding
+#define FRAME_RING_SPINS     64
+
+// first bytes of the segment. the writer fills it in and sets m_ready last.
+// head and tail sit on cache lines of their own, each one is only stored by
+// one side. the atomics have to be lock free to work across processes,
+// 32 and 64 bit ones are on every platform this builds for.
+struct FrameRing::Header
+{
+  char                    m_magic[ 8 ];
+  uint64_t                m_size;
+  uint64_t                m_slotBytes;
+  uint32_t                m_width;
+  uint32_t                m_height;
+  uint32_t                m_stride;
+  uint32_t                m_slots;
+  std::atomic< uint32_t > m_ready;
+  std::atomic< uint32_t > m_closed;
+  std::atomic< uint32_t > m_readers;
+  uint8_t                 m_pad0[ 12 ];
+
+  // frames written, by the writer
+  std::atomic< uint64_t > m_head;
+  uint8_t                 m_pad1[ 56 ];
+
+  // frames read, by the reader
+  std::atomic< uint64_t > m_tail;
+  uint8_t                 m_pad2[ 56 ];
+};
+
+static_assert( sizeof( FrameRing::FrameHeader ) <= FRAME_RING_PIXELS, "the frame header runs into the pixels" );
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+static std::string sharedName( const std::string& _name )
+{
+#if defined _WIN32
+  return "Local\\" + _name;
+#else
+  return "/" + _name;
+#endif
+}
+
+FrameRing::FrameRing( void ) :
+  m_dropWhenFull( false ),
+  m_header( 0 ),
+  m_size( 0 ),
+  m_writer( false ),
+  m_writing( false ),
+  m_reading( false ),
+  m_stalled( false ),
+  m_stalledTail( 0 )
+#if defined _WIN32
+  , m_mapping( 0 )
+#endif
+{
+  memset( &m_stats, 0, sizeof( m_stats ) );
+}
+
+FrameRing::~FrameRing( void )
+{
+  close();
+}
+
+bool FrameRing::create( const std::string& _name, int _width, int _height, size_t _slots )
+{
+  close();
+
+  if ( _width <= 0 || _height <= 0 || _slots == 0 )
+  {
+    return false;
+  }
+
+  size_t stride    = ( static_cast< size_t >( _width ) * 3 + FRAME_RING_ROW_ALIGN - 1 ) / FRAME_RING_ROW_ALIGN * FRAME_RING_ROW_ALIGN;
+  size_t slotBytes = ( FRAME_RING_PIXELS + stride * _height + FRAME_RING_PAGE - 1 ) / FRAME_RING_PAGE * FRAME_RING_PAGE;
+
+  m_name = _name;
+  if ( !map( FRAME_RING_HEADER + slotBytes * _slots, true ) )
+  {
+    return false;
+  }
+
+  m_header = new ( m_header ) Header();
+  m_header->m_size      = m_size;
+  m_header->m_slotBytes = slotBytes;
+  m_header->m_width     = static_cast< uint32_t >( _width );
+  m_header->m_height    = static_cast< uint32_t >( _height );
+  m_header->m_stride    = static_cast< uint32_t >( stride );
+  m_header->m_slots     = static_cast< uint32_t >( _slots );
+  memcpy( m_header->m_magic, FRAME_RING_MAGIC, 8 );
+  m_header->m_ready.store( 1, std::memory_order_release );
+
+  m_writer = true;
+
+  return true;
+}
+
+bool FrameRing::open( const std::string& _name )
+{
+  close();
+
+  m_name = _name;
+  if ( !map( 0, false ) )
+  {
+    return false;
+  }
+
+  // a writer still setting up or gone, or something else under the name
+  if ( m_size < sizeof( Header ) || m_header->m_ready.load( std::memory_order_acquire ) != 1 || m_header->m_closed.load( std::memory_order_acquire ) != 0 ||
+       memcmp( m_header->m_magic, FRAME_RING_MAGIC, 8 ) != 0 ||
+       m_header->m_size != m_size || m_header->m_slots == 0 || FRAME_RING_HEADER + m_header->m_slotBytes * m_header->m_slots > m_size )
+  {
+    close();
+    return false;
+  }
+
+  m_header->m_readers.fetch_add( 1 );
+  return true;
+}
+
+void FrameRing::close()
+{
+  if ( m_header )
+  {
+    if ( m_writer )
+    {
+      m_header->m_closed.store( 1, std::memory_order_release );
+    }
+    else if ( m_size >= sizeof( Header ) && m_header->m_ready.load( std::memory_order_acquire ) == 1 )
+    {
+      m_header->m_readers.fetch_sub( 1 );
+    }
+
+#if defined _WIN32
+    UnmapViewOfFile( m_header );
+#else
+    munmap( m_header, m_size );
+    if ( m_writer )
+    {
+      shm_unlink( sharedName( m_name ).c_str() );
+    }
+#endif
+  }
+
+#if defined _WIN32
+  if ( m_mapping )
+  {
+    CloseHandle( m_mapping );
+  }
+  m_mapping = 0;
+#endif
+
+  m_header  = 0;
+  m_size    = 0;
+  m_writer  = false;
+  m_writing = false;
+  m_reading = false;
+  m_stalled = false;
+}
+
+bool FrameRing::map( size_t _size, bool _create )
+{
+  std::string name = sharedName( m_name );
+
+#if defined _WIN32
+  if ( _create )
+  {
+    // a reader still holding the last ring keeps its name alive: tell it
+    // the ring is closed and give it a moment to let go
+    for ( int attempt = 0; attempt < FRAME_RING_WAIT_MS / 10; ++attempt )
+    {
+      m_mapping = CreateFileMappingA( INVALID_HANDLE_VALUE, 0, PAGE_READWRITE, static_cast< DWORD >( static_cast< uint64_t >( _size ) >> 32 ), static_cast< DWORD >( _size ), name.c_str() );
+      if ( !m_mapping || GetLastError() != ERROR_ALREADY_EXISTS )
+      {
+        break;
+      }
+
+      Header* stale = static_cast< Header* >( MapViewOfFile( m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof( Header ) ) );
+      if ( stale )
+      {
+        stale->m_closed.store( 1, std::memory_order_release );
+        UnmapViewOfFile( stale );
+      }
+
+      CloseHandle( m_mapping );
+      m_mapping = 0;
+      Sleep( 10 );
+    }
+  }
+  else
+  {
+    m_mapping = OpenFileMappingA( FILE_MAP_ALL_ACCESS, FALSE, name.c_str() );
+  }
+
+  if ( !m_mapping )
+  {
+    return false;
+  }
+
+  m_header = static_cast< Header* >( MapViewOfFile( m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, _size ) );
+  if ( !m_header )
+  {
+    close();
+    return false;
+  }
+
+  MEMORY_BASIC_INFORMATION info;
+  VirtualQuery( m_header, &info, sizeof( info ) );
+  m_size = _create ? _size : static_cast< size_t >( info.RegionSize );
+#else
+  int file = -1;
+
+  if ( _create )
+  {
+    // a crashed writer leaves its segment behind, readers holding it keep
+    // their mapping
+    shm_unlink( name.c_str() );
+    file = shm_open( name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600 );
+
+    if ( file >= 0 && ftruncate( file, static_cast< off_t >( _size ) ) != 0 )
+    {
+      ::close( file );
+      shm_unlink( name.c_str() );
+      return false;
+    }
+  }
+  else
+  {
+    file = shm_open( name.c_str(), O_RDWR, 0 );
+
+    struct stat status;
+    if ( file >= 0 && fstat( file, &status ) == 0 )
+    {
+      _size = static_cast< size_t >( status.st_size );
+    }
+  }
+
+  if ( file < 0 || _size == 0 )
+  {
+    if ( file >= 0 )
+    {
+      ::close( file );
+    }
+    return false;
+  }
+
+  void* view = mmap( 0, _size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0 );
+  ::close( file );
+
+  if ( view == MAP_FAILED )
+  {
+    if ( _create )
+    {
+      shm_unlink( name.c_str() );
+    }
+    return false;
+  }
+
+  m_header = static_cast< Header* >( view );
+  m_size   = _size;
+#endif
+
+  return true;
+}
+
+uint8_t* FrameRing::slot( uint64_t _index ) const
+{
+  return reinterpret_cast< uint8_t* >( m_header ) + FRAME_RING_HEADER + static_cast< size_t >( _index % m_header->m_slots ) * static_cast< size_t >( m_header->m_slotBytes );
+}
+
+bool FrameRing::closed() const
+{
+  return !m_header || m_header->m_closed.load( std::memory_order_acquire ) != 0;
+}
+
+int FrameRing::getWidth() const
+{
+  return m_header ? static_cast< int >( m_header->m_width ) : 0;
+}
+
+int FrameRing::getHeight() const
+{
+  return m_header ? static_cast< int >( m_header->m_height ) : 0;
+}
+
+size_t FrameRing::getStride() const
+{
+  return m_header ? m_header->m_stride : 0;
+}
+
+size_t FrameRing::getSlots() const
+{
+  return m_header ? m_header->m_slots : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint8_t* FrameRing::beginWrite()
+{
+  if ( !m_header || !m_writer )
+  {
+    return 0;
+  }
+
+  uint64_t head  = m_header->m_head.load( std::memory_order_relaxed );
+  uint64_t tail  = m_header->m_tail.load( std::memory_order_acquire );
+  uint64_t slots = m_header->m_slots;
+
+  // a reader killed while attached is never counted out, it is taken for
+  // gone until it reads again
+  if ( m_stalled && tail != m_stalledTail )
+  {
+    m_stalled = false;
+  }
+
+  if ( head - tail >= slots )
+  {
+    // nobody to wait for, or not to be waited for
+    if ( m_dropWhenFull || m_stalled || m_header->m_readers.load( std::memory_order_relaxed ) == 0 )
+    {
+      ++m_stats.m_dropped;
+      return 0;
+    }
+
+    ++m_stats.m_delayed;
+
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds( FRAME_RING_WAIT_MS );
+
+    for ( int spin = 0; head - m_header->m_tail.load( std::memory_order_acquire ) >= slots; ++spin )
+    {
+      if ( m_header->m_readers.load( std::memory_order_relaxed ) == 0 )
+      {
+        ++m_stats.m_dropped;
+        return 0;
+      }
+
+      if ( std::chrono::steady_clock::now() > deadline )
+      {
+        m_stalled     = true;
+        m_stalledTail = tail;
+        ++m_stats.m_dropped;
+        return 0;
+      }
+
+      if ( spin < FRAME_RING_SPINS )
+      {
+        std::this_thread::yield();
+      }
+      else
+      {
+        std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+      }
+    }
+  }
+
+  m_writing = true;
+  return slot( head ) + FRAME_RING_PIXELS;
+}
+
+void FrameRing::endWrite( uint64_t _frameId, int _width, int _height, uint32_t _flags, uint64_t _timestamp )
+{
+  if ( !m_writing )
+  {
+    return;
+  }
+
+  uint64_t     head   = m_header->m_head.load( std::memory_order_relaxed );
+  FrameHeader* header = reinterpret_cast< FrameHeader* >( slot( head ) );
+
+  header->m_frameId   = _frameId;
+  header->m_timestamp = _timestamp;
+  header->m_width     = static_cast< uint32_t >( _width  < static_cast< int >( m_header->m_width  ) ? _width  : m_header->m_width );
+  header->m_height    = static_cast< uint32_t >( _height < static_cast< int >( m_header->m_height ) ? _height : m_header->m_height );
+  header->m_stride    = m_header->m_stride;
+  header->m_flags     = _flags;
+
+  // the pixels and the header are the reader's from here
+  m_header->m_head.store( head + 1, std::memory_order_release );
+  m_writing = false;
+  ++m_stats.m_written;
+}
+
+const FrameRing::FrameHeader* FrameRing::beginRead()
+{
+  if ( !m_header || m_writer )
+  {
+    return 0;
+  }
+
+  uint64_t tail = m_header->m_tail.load( std::memory_order_relaxed );
+  if ( tail == m_header->m_head.load( std::memory_order_acquire ) )
+  {
+    return 0;
+  }
+
+  m_reading = true;
+  return reinterpret_cast< const FrameHeader* >( slot( tail ) );
+}
+
+void FrameRing::endRead()
+{
+  if ( !m_reading )
+  {
+    return;
+  }
+
+  // the slot is the writer's again
+  m_header->m_tail.fetch_add( 1, std::memory_order_release );
+  m_reading = false;
+}
+
+void FrameRing::skipToLatest()
+{
+  if ( !m_header || m_writer || m_reading )
+  {
+    return;
+  }
+
+  // the newest frame is published and the writer cannot reach its slot
+  // before the tail passes it
+  uint64_t head = m_header->m_head.load( std::memory_order_acquire );
+  if ( head > m_header->m_tail.load( std::memory_order_relaxed ) + 1 )
+  {
+    m_header->m_tail.store( head - 1, std::memory_order_release );
+  }
+}
+
+size_t FrameRing::pending() const
+{
+  if ( !m_header )
+  {
+    return 0;
+  }
+
+  return static_cast< size_t >( m_header->m_head.load( std::memory_order_acquire ) - m_header->m_tail.load( std::memory_order_acquire ) );
+}
+
+uint64_t FrameRing::now()
+{
+  return static_cast< uint64_t >( std::chrono::duration_cast< std::chrono::microseconds >( std::chrono::steady_clock::now().time_since_epoch() ).count() );
+}
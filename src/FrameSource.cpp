@@ -0,0 +1,501 @@
+#include "FrameSource.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include "cinder/ImageIo.h"
+#include "cinder/ip/Resize.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <sstream>
+#include <algorithm>
+
+#if defined _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+// rows converted per job
+#define ROW_GRAIN   16
+#define Y4M_MAGIC   "YUV4MPEG2"
+#define Y4M_LINE    1024
+
+namespace
+{
+  inline uint8_t clampByte( int _value )
+  {
+    return static_cast< uint8_t >( _value < 0 ? 0 : ( _value > 255 ? 255 : _value ) );
+  }
+
+  // reads up to the end of the line, false at the end of the file
+  bool readLine( FILE* _file, std::string& _line )
+  {
+    int c;
+
+    _line.clear();
+    while ( ( c = fgetc( _file ) ) != EOF && c != '\n' )
+    {
+      if ( _line.size() < Y4M_LINE )
+      {
+        _line.push_back( static_cast< char >( c ) );
+      }
+    }
+
+    return c != EOF || !_line.empty();
+  }
+
+  bool isImage( const ci::fs::path& _path )
+  {
+    std::string extension = _path.extension().string();
+    std::transform( extension.begin(), extension.end(), extension.begin(), ::tolower );
+
+    return extension == ".jpg" || extension == ".jpeg" || extension == ".png" || extension == ".bmp" ||
+           extension == ".tif" || extension == ".tiff" || extension == ".gif";
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+FrameSource::FrameSource( ThreadPool* _pool ) :
+  m_blocking( false ),
+  m_threadPool( _pool ),
+  m_source( SOURCE_NONE ),
+  m_fitSize( 0, 0 ),
+  m_nextFile( 0 ),
+  m_loop( false ),
+  m_file( 0 ),
+  m_frameSize( 0, 0 ),
+  m_chromaShiftX( 1 ),
+  m_chromaShiftY( 1 ),
+  m_mono( false ),
+  m_current( FRAME_SOURCE_RING - 1 ),
+  m_filled( 0 ),
+  m_started( false ),
+  m_ended( false ),
+  m_stop( false ),
+  m_position( 0 ),
+  m_starved( 0 )
+{
+}
+
+FrameSource::~FrameSource( void )
+{
+  close();
+}
+
+bool FrameSource::isStream( const ci::fs::path& _path )
+{
+  std::string extension = _path.extension().string();
+  std::transform( extension.begin(), extension.end(), extension.begin(), ::tolower );
+
+  return _path == "-" || extension == ".y4m" || ci::fs::is_directory( _path );
+}
+
+bool FrameSource::open( const ci::fs::path& _path, const ci::Vec2i& _fitSize, bool _loop )
+{
+  if ( _path != "-" && ci::fs::is_directory( _path ) )
+  {
+    return openDirectory( _path, _fitSize, _loop );
+  }
+
+  return openY4m( _path, _fitSize );
+}
+
+bool FrameSource::openDirectory( const ci::fs::path& _directory, const ci::Vec2i& _fitSize, bool _loop )
+{
+  close();
+
+  if ( !ci::fs::is_directory( _directory ) )
+  {
+    return false;
+  }
+
+  for ( ci::fs::directory_iterator itr( _directory ), end; itr != end; ++itr )
+  {
+    if ( ci::fs::is_regular_file( itr->path() ) && isImage( itr->path() ) )
+    {
+      m_files.push_back( itr->path() );
+    }
+  }
+  std::sort( m_files.begin(), m_files.end() );
+
+  m_nextFile = 0;
+  m_loop     = _loop;
+
+  return !m_files.empty() && start( SOURCE_DIRECTORY, _fitSize );
+}
+
+bool FrameSource::openY4m( const ci::fs::path& _path, const ci::Vec2i& _fitSize )
+{
+  close();
+
+  if ( !openFile( _path ) )
+  {
+    return false;
+  }
+
+  // YUV4MPEG2 W<width> H<height> [F, I, A, X...] [C<colorspace>]
+  std::string header;
+  if ( !readLine( m_file, header ) || header.compare( 0, strlen( Y4M_MAGIC ), Y4M_MAGIC ) != 0 )
+  {
+    close();
+    return false;
+  }
+
+  std::istringstream tokens( header.substr( strlen( Y4M_MAGIC ) ) );
+  std::string        token;
+  std::string        colorSpace = "420";
+
+  m_frameSize = ci::Vec2i( 0, 0 );
+  while ( tokens >> token )
+  {
+    switch ( token[ 0 ] )
+    {
+    case 'W': m_frameSize.x = atoi( token.c_str() + 1 ); break;
+    case 'H': m_frameSize.y = atoi( token.c_str() + 1 ); break;
+    case 'C': colorSpace    = token.substr( 1 );         break;
+    }
+  }
+
+  m_mono = colorSpace == "mono";
+  if ( colorSpace == "420" || colorSpace == "420jpeg" || colorSpace == "420paldv" || colorSpace == "420mpeg2" )
+  {
+    m_chromaShiftX = 1;
+    m_chromaShiftY = 1;
+  }
+  else if ( colorSpace == "422" )
+  {
+    m_chromaShiftX = 1;
+    m_chromaShiftY = 0;
+  }
+  else if ( colorSpace == "444" || m_mono )
+  {
+    m_chromaShiftX = 0;
+    m_chromaShiftY = 0;
+  }
+  else
+  {
+    // high bit depth and alpha variants
+    close();
+    return false;
+  }
+
+  if ( m_frameSize.x <= 0 || m_frameSize.y <= 0 )
+  {
+    close();
+    return false;
+  }
+
+  return start( SOURCE_Y4M, _fitSize );
+}
+
+bool FrameSource::openRaw( const ci::fs::path& _path, const ci::Vec2i& _frameSize, const ci::Vec2i& _fitSize )
+{
+  close();
+
+  if ( _frameSize.x <= 0 || _frameSize.y <= 0 || !openFile( _path ) )
+  {
+    return false;
+  }
+
+  m_frameSize = _frameSize;
+  return start( SOURCE_RAW, _fitSize );
+}
+
+void FrameSource::close()
+{
+  {
+    std::lock_guard< std::mutex > l( m_lock );
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  m_ready.notify_all();
+
+  if ( m_thread.joinable() )
+  {
+    m_thread.join();
+  }
+
+  if ( m_file && m_file != stdin )
+  {
+    fclose( m_file );
+  }
+
+  m_file   = 0;
+  m_source = SOURCE_NONE;
+  m_files.clear();
+}
+
+bool FrameSource::openFile( const ci::fs::path& _path )
+{
+  if ( _path == "-" )
+  {
+#if defined _WIN32
+    _setmode( _fileno( stdin ), _O_BINARY );
+#endif
+    m_file = stdin;
+  }
+  else
+  {
+    m_file = fopen( _path.string().c_str(), "rb" );
+  }
+
+  return m_file != 0;
+}
+
+bool FrameSource::start( Source _source, const ci::Vec2i& _fitSize )
+{
+  m_source   = _source;
+  m_fitSize  = _fitSize;
+  m_current  = FRAME_SOURCE_RING - 1;
+  m_filled   = 0;
+  m_started  = false;
+  m_ended    = false;
+  m_stop     = false;
+  m_position = 0;
+  m_starved  = 0;
+
+  m_thread   = std::thread( &FrameSource::decoderLoop, this );
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool FrameSource::advance()
+{
+  std::unique_lock< std::mutex > l( m_lock );
+
+  if ( m_blocking )
+  {
+    m_ready.wait( l, [ & ](){ return m_filled > 0 || m_ended || m_stop; } );
+  }
+
+  if ( m_filled == 0 )
+  {
+    m_starved += m_started && !m_ended ? 1 : 0;
+    return false;
+  }
+
+  // the slot left behind is the decoder's again
+  m_current = ( m_current + 1 ) % FRAME_SOURCE_RING;
+  m_started = true;
+  --m_filled;
+  ++m_position;
+
+  m_wake.notify_one();
+  return true;
+}
+
+PreparedImage* FrameSource::current()
+{
+  // only advance() moves it, from the same thread
+  return m_started ? &m_slots[ m_current ] : 0;
+}
+
+bool FrameSource::finished()
+{
+  std::lock_guard< std::mutex > l( m_lock );
+  return m_source == SOURCE_NONE || ( m_ended && m_filled == 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void FrameSource::decoderLoop()
+{
+  Profiler::setThreadName( "decoder" );
+
+  std::unique_lock< std::mutex > l( m_lock );
+
+  while ( true )
+  {
+    // the slot in use is never written, nor the ones waiting to be used
+    m_wake.wait( l, [ & ](){ return m_stop || m_filled + 1 < FRAME_SOURCE_RING; } );
+
+    if ( m_stop )
+    {
+      return;
+    }
+
+    size_t slot = ( m_current + 1 + m_filled ) % FRAME_SOURCE_RING;
+
+    l.unlock();
+    bool decoded = decode( m_slots[ slot ] );
+    l.lock();
+
+    if ( !decoded )
+    {
+      m_ended = true;
+      m_ready.notify_all();
+      return;
+    }
+
+    ++m_filled;
+    m_ready.notify_all();
+  }
+}
+
+bool FrameSource::decode( PreparedImage& _slot )
+{
+  ProfileScope profile( Profiler::PHASE_DECODE );
+
+  _slot.m_loaded = false;
+
+  if ( m_source == SOURCE_DIRECTORY )
+  {
+    // unreadable files are skipped, a whole pass of them ends the stream
+    bool loaded = false;
+
+    for ( size_t tries = 0; tries < m_files.size() && !loaded; ++tries )
+    {
+      if ( m_nextFile >= m_files.size() )
+      {
+        if ( !m_loop )
+        {
+          return false;
+        }
+        m_nextFile = 0;
+      }
+
+      _slot.m_path = m_files[ m_nextFile++ ];
+
+      try
+      {
+        fitInto( ci::loadImage( _slot.m_path ), _slot.m_surface );
+        loaded = true;
+      }
+      catch ( ... )
+      {
+      }
+    }
+
+    if ( !loaded )
+    {
+      return false;
+    }
+  }
+  else
+  {
+    if ( !readFrame() )
+    {
+      return false;
+    }
+
+    _slot.m_path.clear();
+    fitInto( m_decoded, _slot.m_surface );
+  }
+
+  _slot.m_steeringField.build( _slot.m_surface, *m_threadPool );
+  _slot.m_summedAreaTable.build( _slot.m_surface, *m_threadPool );
+  _slot.m_loaded = true;
+
+  return true;
+}
+
+bool FrameSource::readFrame()
+{
+  int    width      = m_frameSize.x;
+  int    height     = m_frameSize.y;
+  int    chromaW    = ( width  + ( 1 << m_chromaShiftX ) - 1 ) >> m_chromaShiftX;
+  int    chromaH    = ( height + ( 1 << m_chromaShiftY ) - 1 ) >> m_chromaShiftY;
+  size_t lumaSize   = static_cast< size_t >( width ) * height;
+  size_t chromaSize = m_mono ? 0 : static_cast< size_t >( chromaW ) * chromaH;
+  size_t frameSize  = m_source == SOURCE_RAW ? lumaSize * 3 : lumaSize + 2 * chromaSize;
+
+  if ( m_source == SOURCE_Y4M )
+  {
+    std::string line;
+    if ( !readLine( m_file, line ) || line.compare( 0, 5, "FRAME" ) != 0 )
+    {
+      return false;
+    }
+  }
+
+  m_planes.resize( frameSize );
+  if ( fread( &m_planes[ 0 ], 1, frameSize, m_file ) != frameSize )
+  {
+    return false;
+  }
+
+  if ( !m_decoded || m_decoded.getSize() != m_frameSize )
+  {
+    m_decoded = ci::Surface( width, height, false );
+  }
+
+  const uint8_t* planeY  = &m_planes[ 0 ];
+  const uint8_t* planeU  = planeY + lumaSize;
+  const uint8_t* planeV  = planeU + chromaSize;
+  ci::Surface&   decoded = m_decoded;
+  bool           raw     = m_source == SOURCE_RAW;
+  bool           mono    = m_mono;
+  int            shiftX  = m_chromaShiftX;
+  int            shiftY  = m_chromaShiftY;
+
+  // bt.601 studio range to rgb, in 8.8 fixed point
+  m_threadPool->parallelFor( 0, height, ROW_GRAIN, [ & ]( size_t _begin, size_t _end )
+  {
+    uint8_t red   = decoded.getRedOffset();
+    uint8_t green = decoded.getGreenOffset();
+    uint8_t blue  = decoded.getBlueOffset();
+    uint8_t inc   = decoded.getPixelInc();
+
+    for ( size_t y = _begin; y < _end; ++y )
+    {
+      uint8_t* pixel = decoded.getData( ci::Vec2i( 0, static_cast< int >( y ) ) );
+
+      if ( raw )
+      {
+        const uint8_t* rgb = planeY + y * width * 3;
+        for ( int x = 0; x < width; ++x, pixel += inc, rgb += 3 )
+        {
+          pixel[ red ]   = rgb[ 0 ];
+          pixel[ green ] = rgb[ 1 ];
+          pixel[ blue ]  = rgb[ 2 ];
+        }
+        continue;
+      }
+
+      const uint8_t* rowY = planeY + y * width;
+      const uint8_t* rowU = planeU + ( y >> shiftY ) * chromaW;
+      const uint8_t* rowV = planeV + ( y >> shiftY ) * chromaW;
+
+      for ( int x = 0; x < width; ++x, pixel += inc )
+      {
+        int c = 298 * ( rowY[ x ] - 16 ) + 128;
+        int d = mono ? 0 : rowU[ x >> shiftX ] - 128;
+        int e = mono ? 0 : rowV[ x >> shiftX ] - 128;
+
+        pixel[ red ]   = clampByte( ( c + 409 * e ) >> 8 );
+        pixel[ green ] = clampByte( ( c - 100 * d - 208 * e ) >> 8 );
+        pixel[ blue ]  = clampByte( ( c + 516 * d ) >> 8 );
+      }
+    }
+  } );
+
+  return true;
+}
+
+void FrameSource::fitInto( const ci::Surface& _frame, ci::Surface& _fitted )
+{
+  ci::Vec2i size = _frame.getSize();
+
+  if ( m_fitSize.x > 0 && m_fitSize.y > 0 )
+  {
+    float factor = std::min( static_cast< float >( m_fitSize.x ) / size.x, static_cast< float >( m_fitSize.y ) / size.y );
+    size         = ci::Vec2i( static_cast< int >( size.x * factor ), static_cast< int >( size.y * factor ) );
+  }
+
+  // the slot keeps its surface from one frame to the next
+  if ( !_fitted || _fitted.getSize() != size )
+  {
+    _fitted = ci::Surface( size.x, size.y, false );
+  }
+
+  if ( size == _frame.getSize() )
+  {
+    _fitted.copyFrom( _frame, _frame.getBounds() );
+  }
+  else
+  {
+    ci::ip::resize( _frame, _frame.getBounds(), &_fitted, _fitted.getBounds() );
+  }
+}
@@ -0,0 +1,184 @@
+#include "ImageLoader.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include "cinder/ImageIo.h"
+#include "cinder/ip/Resize.h"
+
+#include <algorithm>
+
+ImageLoader::ImageLoader( ThreadPool* _pool ) :
+  m_threadPool( _pool ),
+  m_stop( false )
+{
+  m_thread = std::thread( &ImageLoader::loaderLoop, this );
+}
+
+ImageLoader::~ImageLoader( void )
+{
+  {
+    std::lock_guard< std::mutex > l( m_lock );
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  m_thread.join();
+}
+
+void ImageLoader::prefetch( const std::vector< ci::fs::path >& _paths, const ci::Vec2i& _fitSize )
+{
+  std::lock_guard< std::mutex > l( m_lock );
+
+  // forget what is not wanted anymore, the one being loaded goes on its own
+  for ( auto itr = m_entries.begin(); itr != m_entries.end(); )
+  {
+    bool wanted = itr->m_fitSize == _fitSize && std::find( _paths.begin(), _paths.end(), itr->m_image.m_path ) != _paths.end();
+
+    if ( wanted || itr->m_state == STATE_LOADING )
+    {
+      ++itr;
+    }
+    else
+    {
+      itr = m_entries.erase( itr );
+    }
+  }
+
+  for ( size_t i = 0; i < _paths.size(); ++i )
+  {
+    if ( find( _paths[ i ], _fitSize ) == m_entries.end() )
+    {
+      m_entries.push_back( Entry() );
+      m_entries.back().m_image.m_path = _paths[ i ];
+      m_entries.back().m_fitSize      = _fitSize;
+      m_entries.back().m_state        = STATE_QUEUED;
+    }
+  }
+
+  m_wake.notify_one();
+}
+
+bool ImageLoader::ready( const ci::fs::path& _path, const ci::Vec2i& _fitSize )
+{
+  std::lock_guard< std::mutex > l( m_lock );
+  auto itr = find( _path, _fitSize );
+
+  return itr != m_entries.end() && itr->m_state == STATE_READY;
+}
+
+bool ImageLoader::take( const ci::fs::path& _path, const ci::Vec2i& _fitSize, PreparedImage& _image )
+{
+  std::unique_lock< std::mutex > l( m_lock );
+  auto itr = find( _path, _fitSize );
+
+  if ( itr == m_entries.end() )
+  {
+    l.unlock();
+    prepare( _path, _fitSize, _image );
+    return _image.m_loaded;
+  }
+
+  // jump the queue, if it has not started yet
+  if ( itr->m_state == STATE_QUEUED )
+  {
+    m_entries.splice( m_entries.begin(), m_entries, itr );
+  }
+
+  m_prepared.wait( l, [ & ](){ return itr->m_state == STATE_READY; } );
+
+  _image.m_path    = itr->m_image.m_path;
+  _image.m_surface = itr->m_image.m_surface;
+  _image.m_loaded  = itr->m_image.m_loaded;
+  _image.m_steeringField.swap( itr->m_image.m_steeringField );
+  _image.m_summedAreaTable.swap( itr->m_image.m_summedAreaTable );
+
+  m_entries.erase( itr );
+  return _image.m_loaded;
+}
+
+ci::Surface ImageLoader::fitImage( const ci::Surface& _image, const ci::Vec2i& _fitSize )
+{
+  if ( _fitSize.x <= 0 || _fitSize.y <= 0 )
+  {
+    return _image;
+  }
+
+  ci::Vec2i   aSize     = _image.getSize();
+  float       theFactor = ci::math< float >::min( static_cast< float >( _fitSize.x ) / aSize.x, static_cast< float >( _fitSize.y ) / aSize.y );
+  ci::Surface fitted( static_cast< int >( aSize.x * theFactor ), static_cast< int >( aSize.y * theFactor ), false );
+
+  ci::ip::resize( _image, _image.getBounds(), &fitted, fitted.getBounds() );
+  return fitted;
+}
+
+void ImageLoader::loaderLoop()
+{
+  Profiler::setThreadName( "loader" );
+
+  std::unique_lock< std::mutex > l( m_lock );
+
+  while ( true )
+  {
+    auto itr = m_entries.end();
+    m_wake.wait( l, [ & ]()
+    {
+      for ( itr = m_entries.begin(); itr != m_entries.end() && itr->m_state != STATE_QUEUED; ++itr );
+      return m_stop || itr != m_entries.end();
+    } );
+
+    if ( m_stop )
+    {
+      return;
+    }
+
+    // entries being loaded are never erased, the iterator stays valid
+    itr->m_state = STATE_LOADING;
+    ci::fs::path path    = itr->m_image.m_path;
+    ci::Vec2i    fitSize = itr->m_fitSize;
+
+    l.unlock();
+    PreparedImage image;
+    prepare( path, fitSize, image );
+    l.lock();
+
+    itr->m_image.m_surface = image.m_surface;
+    itr->m_image.m_loaded  = image.m_loaded;
+    itr->m_image.m_steeringField.swap( image.m_steeringField );
+    itr->m_image.m_summedAreaTable.swap( image.m_summedAreaTable );
+    itr->m_state           = STATE_READY;
+
+    m_prepared.notify_all();
+  }
+}
+
+void ImageLoader::prepare( const ci::fs::path& _path, const ci::Vec2i& _fitSize, PreparedImage& _image )
+{
+  _image.m_path   = _path;
+  _image.m_loaded = false;
+
+  try
+  {
+    _image.m_surface = fitImage( ci::loadImage( _path ), _fitSize );
+  }
+  catch ( ... )
+  {
+    return;
+  }
+
+  _image.m_steeringField.build( _image.m_surface, *m_threadPool );
+  _image.m_summedAreaTable.build( _image.m_surface, *m_threadPool );
+  _image.m_loaded = true;
+}
+
+std::list< ImageLoader::Entry >::iterator ImageLoader::find( const ci::fs::path& _path, const ci::Vec2i& _fitSize )
+{
+  auto itr = m_entries.begin();
+
+  for ( ; itr != m_entries.end(); ++itr )
+  {
+    if ( itr->m_image.m_path == _path && itr->m_fitSize == _fitSize )
+    {
+      break;
+    }
+  }
+
+  return itr;
+}
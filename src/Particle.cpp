@@ -1,159 +1,246 @@
 #include "Particle.h"
-#include "cinder/gl/gl.h"
-#include "cinder/app/App.h"
 #include "ParticleEmitter.h"
+#include "SoftwareRasterizer.h"
+#include "SteeringField.h"
+#include "SummedAreaTable.h"
 
+#if !defined FLOCKDRAW_HEADLESS
+#include "cinder/gl/gl.h"
 #include <SimpleGUI.h>
+#endif
 
 #define DEG_TO_RAD( x ) ( ( x ) * 0.017453292519943295769236907684886f )
 #define LUMINANCE( r, g, b ) ( 0.299f * ( r ) + 0.587f * ( g ) + 0.114f * ( b ) )
+#define SIN_22_5             0.38268343236f
 
 float  Particle::s_maxRadius          = 5.0f;
 float  Particle::s_particleSizeRatio  = 1.0f;
 float  Particle::s_particleSpeedRatio = 1.0f;
 float  Particle::s_dampness           = 0.9f;
 float  Particle::s_colorRedirection   = 1.0f;
-size_t Particle::s_idGenerator        = 0;
-
-Particle::Particle( ParticleEmitter* _owner, ci::Vec2f& _position, ci::Vec2f& _direction ) :
-  m_position( _position ),
-  m_stablePosition( _position ),
-  m_direction( _direction ),
-  m_color( 1.0f, 1.0f, 1.0f ),
-  m_velocity( 0.0f, 0.0f ),
-  m_maxSpeedSquared( 0.0f ),
-  m_minSpeedSquared( 0.0f ),
-  m_spawnTime( ci::app::getElapsedSeconds() ),
-  m_timeOfDeath( -1.0 ),
-  m_owner( _owner ),
-  m_group( -1 ),
-  m_id( s_idGenerator++ )
-{
-}
+float  Particle::s_sampleRadius       = 5.0f;
 
-Particle::~Particle( void )
+void Particle::update( ParticleStore& _store, const ParticleRange& _range, const ReferenceImage& _reference, const FlockParams& _params, double _delta )
 {
-}
-
-void Particle::update( double _currentTime, double _delta )
-{
-  // update the speed
-  m_velocity += m_acceleration;
-  m_acceleration.set( 0.0f, 0.0f );
-  m_direction = m_velocity.normalized();
-  limitSpeed();
-
-  // update the position
-  m_position += m_velocity * static_cast< float >( _delta ) * Particle::s_particleSpeedRatio;
-  m_velocity *= Particle::s_dampness;
-
-  // wrap the particle 
-  ci::Vec2f wrapSize = m_referenceSurface->getSize();
-  if ( m_position.x < 0.0f )
-  {
-    m_position.x += wrapSize.x;
-  }
-  else if ( m_position.x >= wrapSize.x )
+  ci::Vec2f            wrapSize    = _reference.getSize();
+  float                step        = static_cast< float >( _delta ) * _params.m_particleSpeedRatio;
+  ci::Vec2f            tempDir;
+  float                angle;
+  ci::Vec2f            nextPos[ 3 ];
+  float                l[ 3 ];
+  ci::ColorA           currentColor;
+  ci::ColorA           c;
+  const SteeringField* field       = _reference.m_steeringField;
+  float                fieldScale  = _reference.m_tableScale;
+  bool                 useField    = field && !field->empty();
+  float                redirection = DEG_TO_RAD( _params.m_colorRedirection );
+
+  for ( size_t i = _range.m_begin; i < _range.m_end; ++i )
   {
-    m_position.x -= wrapSize.x;
-  }
+    ci::Vec2f& position     = _store.m_position[ i ];
+    ci::Vec2f& velocity     = _store.m_velocity[ i ];
+    ci::Vec2f& acceleration = _store.m_acceleration[ i ];
+    ci::Vec2f& direction    = _store.m_direction[ i ];
 
-  if ( m_position.y < 0.0f )
-  {
-    m_position.y += wrapSize.y;
-  }
-  else if ( m_position.y >= wrapSize.y )
-  {
-    m_position.y -= wrapSize.y;
-  }
+    _store.m_stablePosition[ i ] = position;
 
-  if ( m_referenceSurface )
-  {
-    t_tempDir = m_direction * 2.0f;
-    t_angle   = DEG_TO_RAD( 45 );
-    t_currentColor = m_referenceSurface->getPixel( m_position );
-
-    t_nextPos[ 0 ] = m_position + t_tempDir;
-    t_tempDir.rotate( t_angle );
-    t_nextPos[ 1 ] = m_position + t_tempDir;
-    t_tempDir.rotate( t_angle * -2.0f );
-    t_nextPos[ 2 ] = m_position + t_tempDir;
-    
+    // update the speed
+    velocity += acceleration;
+    acceleration.set( 0.0f, 0.0f );
+    direction = velocity.normalized();
+    limitSpeed( _store, i );
+
+    // update the position
+    position += velocity * step;
+    velocity *= _params.m_dampness;
+
+    // wrap the particle 
+    if ( position.x < 0.0f )
+    {
+      position.x += wrapSize.x;
+    }
+    else if ( position.x >= wrapSize.x )
+    {
+      position.x -= wrapSize.x;
+    }
+
+    if ( position.y < 0.0f )
+    {
+      position.y += wrapSize.y;
+    }
+    else if ( position.y >= wrapSize.y )
+    {
+      position.y -= wrapSize.y;
+    }
+
+    if ( useField )
+    {
+      // the old probes looked ahead and 45 degrees to each side: turn when
+      // the isophote is closer to a side probe than to straight ahead
+      ci::Vec2f tangent = field->direction( position * fieldScale );
+      float     side    = direction.x * tangent.y - direction.y * tangent.x;
+
+      if ( direction.dot( tangent ) < 0.0f )
+      {
+        side = -side;
+      }
+
+      if ( side > SIN_22_5 )
+      {
+        velocity.rotate( static_cast< float >( redirection * _delta ) );
+      }
+      else if ( side < -SIN_22_5 )
+      {
+        velocity.rotate( static_cast< float >( redirection * -2.0f * _delta ) );
+      }
+
+      continue;
+    }
+
+    tempDir      = direction * 2.0f;
+    angle        = DEG_TO_RAD( 45 );
+    currentColor = _reference.getPixel( position );
 
-    for ( int i = 0; i < 3; ++i )
+    nextPos[ 0 ] = position + tempDir;
+    tempDir.rotate( angle );
+    nextPos[ 1 ] = position + tempDir;
+    tempDir.rotate( angle * -2.0f );
+    nextPos[ 2 ] = position + tempDir;
+    
+    for ( int j = 0; j < 3; ++j )
     {
       // to guide thru color
-      t_c      = t_currentColor - m_referenceSurface->getPixel( t_nextPos[ i ] );
-      t_l[ i ] = t_c.lengthSquared();
+      c      = currentColor - _reference.getPixel( nextPos[ j ] );
+      l[ j ] = c.lengthSquared();
       
       // to guide thru luminance
-      // ci::ColorA c  = m_referenceSurface->getPixel( nextPos[ i ] );
-      // l[ i ] = LUMINANCE( c.r, c.g, c.b );
+      // ci::ColorA c  = _reference.getPixel( nextPos[ j ] );
+      // l[ j ] = LUMINANCE( c.r, c.g, c.b );
     }
     
-    t_angle = DEG_TO_RAD( Particle::s_colorRedirection );
-    
-    if ( t_l[ 1 ] < t_l[ 0 ] )
+    angle = redirection;
+
+    if ( l[ 1 ] < l[ 0 ] )
     {
-      m_velocity.rotate( static_cast< float >( t_angle * _delta ) );
+      velocity.rotate( static_cast< float >( angle * _delta ) );
     }
-    else if ( t_l[ 2 ] < t_l[ 0 ] )
+    else if ( l[ 2 ] < l[ 0 ] )
     {
-      m_velocity.rotate( static_cast< float >( t_angle * -2.0f * _delta ) );
+      velocity.rotate( static_cast< float >( angle * -2.0f * _delta ) );
     }
   }
 }
 
-void Particle::draw( void )
+// color and radius a particle is drawn with, averaged over a box when the
+// summed area table is there. a box under a pixel of a table built smaller
+// than the image reads the pixel instead.
+static inline void sample( const ReferenceImage& _reference, const FlockParams& _params, const ci::Vec2f& _position, ci::ColorA& _color, float& _radius )
 {
-  t_sourceArea.x1 = static_cast< int >( m_position.x - Particle::s_maxRadius );
-  t_sourceArea.y1 = static_cast< int >( m_position.y - Particle::s_maxRadius );
-  t_sourceArea.x2 = static_cast< int >( m_position.x + Particle::s_maxRadius );
-  t_sourceArea.y2 = static_cast< int >( m_position.y + Particle::s_maxRadius );
+  const SummedAreaTable* table = _reference.m_summedAreaTable;
+  float                  scale = _reference.m_tableScale;
+  float                  luminance;
+
+  if ( table && !table->empty() && _params.m_sampleRadius > 0.0f && ( scale >= 1.0f || _params.m_sampleRadius * scale >= 0.5f ) )
+  {
+    table->average( _position * scale, _params.m_sampleRadius * scale, _color, luminance );
+  }
+  else
+  {
+    _color    = _reference.getPixel( _position );
+    luminance = LUMINANCE( _color.r, _color.g, _color.b );
+  }
 
-  t_color      = m_referenceSurface->areaAverage( t_sourceArea );
-  //t_color      = m_referenceSurface->getPixel( m_position );
+  _radius = ( 1.0f + Particle::s_maxRadius * luminance ) * _params.m_particleSizeRatio;
+}
+
+// where a particle is drawn, _interpolation of the way through its last
+// step. particles that wrapped are drawn where they are now.
+static inline ci::Vec2f drawPosition( const ParticleStore& _store, size_t _index, float _interpolation, const ci::Vec2f& _bounds )
+{
+  const ci::Vec2f& current  = _store.m_position[ _index ];
+  const ci::Vec2f& previous = _store.m_stablePosition[ _index ];
+  ci::Vec2f        step     = current - previous;
 
-  t_color      = m_referenceSurface->getPixel( m_position );
-  float radius = ( 1.0f + Particle::s_maxRadius * LUMINANCE( t_color.r, t_color.g, t_color.b ) ) * Particle::s_particleSizeRatio;
+  if ( _interpolation >= 1.0f || fabs( step.x ) > _bounds.x * 0.5f || fabs( step.y ) > _bounds.y * 0.5f )
+  {
+    return current;
+  }
 
-  ci::gl::color( t_color );
-  ci::gl::drawSolidCircle( m_position + m_owner->m_position, radius );
+  return previous + step * _interpolation;
 }
 
-void Particle::debugDraw( void )
+void Particle::rasterize( const ParticleStore& _store, const ParticleRange& _range, const ReferenceImage& _reference, const FlockParams& _params, const ci::Vec2f& _offset, float _interpolation, SoftwareRasterizer& _rasterizer )
+{
+  ci::Vec2f  bounds = _reference.getSize();
+  ci::Vec2f  position;
+  ci::ColorA color;
+  float      radius;
+
+  for ( size_t i = _range.m_begin; i < _range.m_end; ++i )
+  {
+    position = drawPosition( _store, i, _interpolation, bounds );
+
+    sample( _reference, _params, position, color, radius );
+    _rasterizer.addSplat( position + _offset, radius, color );
+  }
+}
+
+#if !defined FLOCKDRAW_HEADLESS
+void Particle::draw( const ParticleStore& _store, const ParticleRange& _range, const ReferenceImage& _reference, const FlockParams& _params, const ci::Vec2f& _offset, float _interpolation )
+{
+  ci::Vec2f  bounds = _reference.getSize();
+  ci::Vec2f  position;
+  ci::ColorA color;
+  float      radius;
+
+  for ( size_t i = _range.m_begin; i < _range.m_end; ++i )
+  {
+    position = drawPosition( _store, i, _interpolation, bounds );
+
+    sample( _reference, _params, position, color, radius );
+
+    ci::gl::color( color );
+    ci::gl::drawSolidCircle( position + _offset, radius );
+  }
+}
+void Particle::debugDraw( const ParticleStore& _store, const ParticleRange& _range, const ParticleEmitter& _owner )
 {
   if ( ParticleEmitter::s_debugDraw )
   {
-    float zoneRadius = sqrt( m_owner->m_zoneRadiusSqrd );
-    ci::Vec2f pos    = m_position + m_owner->m_position;
+    float zoneRadius = sqrt( _owner.m_zoneRadiusSqrd );
 
-    ci::gl::color( 1.0f, 1.0f, 1.0f, 0.5f );
-    ci::gl::drawStrokedCircle( pos, zoneRadius );
+    for ( size_t i = _range.m_begin; i < _range.m_end; ++i )
+    {
+      ci::Vec2f pos = _store.m_position[ i ] + _owner.m_position;
 
-    ci::gl::color( 1.0f, 1.0f, 0.0f, 0.5f );
-    ci::gl::drawStrokedCircle( pos, zoneRadius * m_owner->m_highThresh );
+      ci::gl::color( 1.0f, 1.0f, 1.0f, 0.5f );
+      ci::gl::drawStrokedCircle( pos, zoneRadius );
 
-    ci::gl::color( 1.0f, 0.0f, 1.0f, 0.5f );
-    ci::gl::drawStrokedCircle( pos, zoneRadius * m_owner->m_lowThresh );
+      ci::gl::color( 1.0f, 1.0f, 0.0f, 0.5f );
+      ci::gl::drawStrokedCircle( pos, zoneRadius * _owner.m_highThresh );
 
-    ci::gl::color( 1.0f, 1.0f, 1.0f, 1.0f );
-    sgui::SimpleGUI::textureFont->drawString( boost::lexical_cast< std::string >( m_id ), pos + ci::Vec2f( 5.0f, 5.0f ) );
+      ci::gl::color( 1.0f, 0.0f, 1.0f, 0.5f );
+      ci::gl::drawStrokedCircle( pos, zoneRadius * _owner.m_lowThresh );
+
+      ci::gl::color( 1.0f, 1.0f, 1.0f, 1.0f );
+      sgui::SimpleGUI::textureFont->drawString( boost::lexical_cast< std::string >( _store.m_id[ i ] ), pos + ci::Vec2f( 5.0f, 5.0f ) );
+    }
   }
 }
+#endif // FLOCKDRAW_HEADLESS
 
-void Particle::limitSpeed()
+void Particle::limitSpeed( ParticleStore& _store, size_t _index )
 {
-	float vLengthSqrd = m_velocity.lengthSquared();
+  ci::Vec2f& velocity    = _store.m_velocity[ _index ];
+	float      vLengthSqrd = velocity.lengthSquared();
 
-	if ( vLengthSqrd > m_maxSpeedSquared )
+	if ( vLengthSqrd > _store.m_maxSpeedSquared[ _index ] )
   {
-    m_velocity = m_direction * m_maxSpeedSquared;
+    velocity = _store.m_direction[ _index ] * _store.m_maxSpeedSquared[ _index ];
 		
 	} 
-  else if ( vLengthSqrd < m_minSpeedSquared )
+  else if ( vLengthSqrd < _store.m_minSpeedSquared[ _index ] )
   {
-    m_velocity = m_direction * m_minSpeedSquared;
+    velocity = _store.m_direction[ _index ] * _store.m_minSpeedSquared[ _index ];
 	}
 }
-
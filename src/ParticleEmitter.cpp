@@ -1,11 +1,22 @@
 #include "ParticleEmitter.h"
 #include "Particle.h"
-#include "cinder/Rand.h"
+#include "SoftwareRasterizer.h"
+#include "Profiler.h"
+#include "FrameSource.h"
 #include "cinder/app/App.h"
 #include "cinder/Vector.h"
 
-#define PI            3.14159265359f
-#define PI2           6.28318530718f
+#include <chrono>
+#include <algorithm>
+
+#define PI                3.14159265359f
+#define PI2               6.28318530718f
+
+#define FNV_OFFSET        14695981039346656037ULL
+#define FNV_PRIME         1099511628211ULL
+
+#define UPDATE_CHUNK_SIZE 1024
+#define FLOCK_CHUNK_SIZE  256
 
 bool ParticleEmitter::s_debugDraw = false;
 
@@ -20,16 +31,41 @@ ParticleEmitter::ParticleEmitter(void) :
   m_attractStrength( 0.02f ),
   m_lowThresh( 0.125f ),
   m_highThresh( 0.65f ),
+  m_mergeGroups( false ),
+  m_flockSlices( 0 ),
+  m_flockBudget( 0 ),
+  m_barnesHut( false ),
+  m_openingAngle( 0.5f ),
   m_referenceSurface( 0 ),
-  m_stop( false ),
-  m_processing( 0 ),
+  m_tiledImage( 0 ),
+  m_steeringField( 0 ),
+  m_summedAreaTable( 0 ),
+  m_frameSource( 0 ),
+  m_fixedStep( 1.0 / 60.0 ),
+  m_maxSubSteps( 4 ),
+  m_threadPool( &ThreadPool::shared() ),
+  m_flockSeconds( 0.0 ),
+  m_integrateSeconds( 0.0 ),
+  m_flockTicks( 0 ),
   m_currentTime( 0.0 ),
-  m_delta( 0.0 ),
+  m_clockTime( 0.0 ),
+  m_clockAccumulator( 0.0 ),
+  m_interpolation( 1.0f ),
   m_particlesPerSecondLeftOver( 0.0f ),
   m_updateFlockEvery( 0.1 ),
   m_updateFlockTimer( 0.0 ),
-  m_lastFlockUpdateTime( 0.0 )
+  m_lastFlockUpdateTime( 0.0 ),
+  m_flockSlice( 0 ),
+  m_nextId( 0 ),
+  m_step( 0 )
 {
+  if ( FlockKernel::mode() == FlockKernel::MODE_AUTO )
+  {
+    FlockKernel::select();
+  }
+
+  m_fieldParams = fieldParams();
+  publishParams( m_fieldParams );
 }
 
 ParticleEmitter::~ParticleEmitter(void)
@@ -39,99 +75,383 @@ ParticleEmitter::~ParticleEmitter(void)
 #define EMISSION_AREA_PERCENTAGE 0.3f
 void ParticleEmitter::addParticles( int _aumont, int _group )
 {
-  ci::Vec2f refSize;
+  EpochGuard     epoch;
+  ReferenceImage reference = this->reference();
+  ci::Vec2f      refSize;
   ci::Area  emissionArea( m_position, m_position );
-  std::vector< Particle* >& particleVector = m_particles[ _group ];
 
-  if ( particleVector.size() == 0 ) // new thread?
+  if ( _aumont <= 0 )
   {
-    m_threads.push_back( std::thread( &ParticleEmitter::threadProcessParticles, this, _group ) ); 
+    return;
   }
 
-  if ( m_referenceSurface )
+  if ( m_particles.find( _group ) == m_particles.end() ) // new group?
   {
-    refSize = m_referenceSurface->getSize();
-    emissionArea.x1 = static_cast< int >( ci::randFloat( refSize.x - refSize.x * EMISSION_AREA_PERCENTAGE ) );
-    emissionArea.y1 = static_cast< int >( ci::randFloat( refSize.y - refSize.y * EMISSION_AREA_PERCENTAGE ) );
+    m_particles[ _group ] = ParticleRange( m_store.size(), m_store.size() );
+    m_slabEnd[ _group ]   = m_store.size();
+  }
+
+  ParticleRange& range   = m_particles[ _group ];
+  size_t&        slabEnd = m_slabEnd[ _group ];
+  size_t         first   = range.m_end;
+  size_t         spare   = slabEnd - range.m_end;
+
+  // out of free slots: open room at the end of the slab, pushing the
+  // following groups
+  if ( spare < static_cast< size_t >( _aumont ) )
+  {
+    size_t grow = _aumont - spare;
+    size_t at   = slabEnd;
+
+    m_store.insert( at, grow );
+
+    for ( auto& particleGroup : m_particles )
+    {
+      if ( particleGroup.first != _group && particleGroup.second.m_begin >= at )
+      {
+        particleGroup.second.m_begin    += grow;
+        particleGroup.second.m_end      += grow;
+        m_slabEnd[ particleGroup.first ] += grow;
+      }
+    }
+    slabEnd += grow;
+  }
+
+  range.m_end += _aumont;
+
+  if ( reference.valid() )
+  {
+    refSize = reference.getSize();
+    emissionArea.x1 = static_cast< int >( m_rand.nextFloat( refSize.x - refSize.x * EMISSION_AREA_PERCENTAGE ) );
+    emissionArea.y1 = static_cast< int >( m_rand.nextFloat( refSize.y - refSize.y * EMISSION_AREA_PERCENTAGE ) );
     emissionArea.x2 = static_cast< int >( emissionArea.x1 + refSize.x * EMISSION_AREA_PERCENTAGE );
     emissionArea.y2 = static_cast< int >( emissionArea.y1 + refSize.y * EMISSION_AREA_PERCENTAGE );
   }
   
   
-  float angle = ci::Rand::randFloat( 0.0f, 2 * PI );
+  float angle = m_rand.nextFloat( 0.0f, 2 * PI );
+  bool  mortal = m_maxLifeTime > 0.0;
 
-  for ( int i = 0; i < _aumont; ++i )
+  for ( size_t i = first; i < range.m_end; ++i )
   {
     
-    float angleVar  = ci::Rand::randFloat( 0.0f, 0.8f * PI );
+    float angleVar  = m_rand.nextFloat( 0.0f, 0.8f * PI );
     float u         = sin( angle + angleVar );
     float v         = cos( angle + angleVar );
 
-    Particle* p = 0;
-    if ( m_referenceSurface )
-    {
-      ci::Vec2f pos;
-      pos.x = ci::Rand::randFloat( static_cast< float >( emissionArea.x1 ), static_cast< float >( emissionArea.x2 ) );
-      pos.y = ci::Rand::randFloat( static_cast< float >( emissionArea.y1 ), static_cast< float >( emissionArea.y2 ) );
-
-      p = new Particle( this, pos, ci::Vec2f( u, v ) );
-      p->m_referenceSurface = m_referenceSurface;
-    }
-    else
+    ci::Vec2f pos   = m_position;
+    if ( reference.valid() )
     {
-      p = new Particle( this, m_position, ci::Vec2f( u, v ) );
+      pos.x = m_rand.nextFloat( static_cast< float >( emissionArea.x1 ), static_cast< float >( emissionArea.x2 ) );
+      pos.y = m_rand.nextFloat( static_cast< float >( emissionArea.y1 ), static_cast< float >( emissionArea.y2 ) );
     }
 
-    p->m_maxSpeedSquared = ci::Rand::randFloat( 10, 50 );
-    p->m_minSpeedSquared = ci::Rand::randFloat( 1, 10 );
+    // a recycled slot carries the last particle's state, set every field
+    m_store.m_position[ i ]        = pos;
+    m_store.m_stablePosition[ i ]  = pos;
+    m_store.m_velocity[ i ]        = ci::Vec2f( 0.0f, 0.0f );
+    m_store.m_direction[ i ]       = ci::Vec2f( u, v );
+    m_store.m_maxSpeedSquared[ i ] = m_rand.nextFloat( 10, 50 );
+    m_store.m_minSpeedSquared[ i ] = m_rand.nextFloat( 1, 10 );
     
-    p->m_acceleration         = p->m_direction;
-    p->m_acceleration.normalize();
-    p->m_acceleration        *= 2.5f;
-    p->m_group                = _group;
-    
-    particleVector.push_back( p );
+    m_store.m_acceleration[ i ]    = m_store.m_direction[ i ].normalized() * 2.5f;
+    m_store.m_group[ i ]           = _group;
+    m_store.m_id[ i ]              = m_nextId++;
+    m_store.m_spawnTime[ i ]       = m_currentTime;
+    m_store.m_timeOfDeath[ i ]     = mortal ? m_currentTime + m_rand.nextFloat( static_cast< float >( std::min( m_minLifeTime, m_maxLifeTime ) ), static_cast< float >( m_maxLifeTime ) ) : -1.0;
+    m_store.m_flockTime[ i ]       = -1.0;
   }
 }
 
-void ParticleEmitter::draw( void )
+size_t ParticleEmitter::liveCount() const
+{
+  size_t count = 0;
+  for ( auto& particleGroup : m_particles )
+  {
+    count += particleGroup.second.size();
+  }
+  return count;
+}
+
+size_t ParticleEmitter::pooledCount() const
+{
+  return m_store.size() - liveCount();
+}
+
+void ParticleEmitter::seed( uint32_t _seed )
+{
+  m_rand.seed( _seed );
+}
+
+static inline void hashBytes( uint64_t& _hash, const void* _data, size_t _size )
+{
+  const uint8_t* bytes = static_cast< const uint8_t* >( _data );
+
+  for ( size_t i = 0; i < _size; ++i )
+  {
+    _hash = ( _hash ^ bytes[ i ] ) * FNV_PRIME;
+  }
+}
+
+void ParticleEmitter::publishParams( const FlockParams& _params )
+{
+  m_params.publish( new FlockParams( _params ) );
+}
+
+void ParticleEmitter::publishReference( const PreparedImage* _image )
+{
+  m_reference.publish( _image );
+}
+
+FlockParams ParticleEmitter::fieldParams() const
+{
+  FlockParams params;
+  params.m_zoneRadiusSqrd     = m_zoneRadiusSqrd;
+  params.m_repelStrength      = m_repelStrength;
+  params.m_alignStrength      = m_alignStrength;
+  params.m_attractStrength    = m_attractStrength;
+  params.m_lowThresh          = m_lowThresh;
+  params.m_highThresh         = m_highThresh;
+  params.m_mergeGroups        = m_mergeGroups;
+  params.m_flockSlices        = m_flockSlices;
+  params.m_flockBudget        = m_flockBudget;
+  params.m_barnesHut          = m_barnesHut;
+  params.m_openingAngle       = m_openingAngle;
+  params.m_particleSizeRatio  = Particle::s_particleSizeRatio;
+  params.m_particleSpeedRatio = Particle::s_particleSpeedRatio;
+  params.m_dampness           = Particle::s_dampness;
+  params.m_colorRedirection   = Particle::s_colorRedirection;
+  params.m_sampleRadius       = Particle::s_sampleRadius;
+  return params;
+}
+
+void ParticleEmitter::applyParams( const FlockParams& _params )
+{
+  m_zoneRadiusSqrd  = _params.m_zoneRadiusSqrd;
+  m_repelStrength   = _params.m_repelStrength;
+  m_alignStrength   = _params.m_alignStrength;
+  m_attractStrength = _params.m_attractStrength;
+  m_lowThresh       = _params.m_lowThresh;
+  m_highThresh      = _params.m_highThresh;
+  m_mergeGroups     = _params.m_mergeGroups;
+  m_flockSlices     = _params.m_flockSlices;
+  m_flockBudget     = _params.m_flockBudget;
+  m_barnesHut       = _params.m_barnesHut;
+  m_openingAngle    = _params.m_openingAngle;
+
+  // the statics may differ from _params, syncParams() only republishes
+  // when they change
+  m_fieldParams = fieldParams();
+  publishParams( _params );
+}
+
+void ParticleEmitter::syncParams()
+{
+  // the vars are edited on the thread that steps the emitter, only an
+  // edit is published so a block published from elsewhere stays put
+  FlockParams fields = fieldParams();
+
+  if ( fields != m_fieldParams )
+  {
+    m_fieldParams = fields;
+    publishParams( fields );
+  }
+}
+
+ReferenceImage ParticleEmitter::reference() const
+{
+  const PreparedImage* image = m_frameSource ? 0 : m_reference.get();
+  ReferenceImage       reference;
+
+  if ( image )
+  {
+    reference.m_surface         = &image->m_surface;
+    reference.m_steeringField   = &image->m_steeringField;
+    reference.m_summedAreaTable = &image->m_summedAreaTable;
+  }
+  else
+  {
+    reference.m_surface         = m_referenceSurface;
+    reference.m_tiledImage      = m_tiledImage;
+    reference.m_steeringField   = m_steeringField;
+    reference.m_summedAreaTable = m_summedAreaTable;
+    reference.m_tableScale      = m_tiledImage ? m_tiledImage->overviewScale() : 1.0f;
+  }
+
+  return reference;
+}
+
+uint64_t ParticleEmitter::stateHash() const
 {
-  for ( auto particleGroup : m_particles )
+  // unordered_map order is not something to hash, sort the groups first
+  std::vector< int > groups;
+  for ( auto& particleGroup : m_particles )
   {
-    std::vector< Particle* >::iterator itr     = particleGroup.second.begin();
-    std::vector< Particle* >::iterator itr_end = particleGroup.second.end();
+    groups.push_back( particleGroup.first );
+  }
+  std::sort( groups.begin(), groups.end() );
 
-    for ( ; itr != itr_end; ++itr )
+  uint64_t hash = FNV_OFFSET;
+
+  for ( size_t g = 0; g < groups.size(); ++g )
+  {
+    const ParticleRange& range = m_particles.find( groups[ g ] )->second;
+    uint64_t             count = range.size();
+
+    hashBytes( hash, &groups[ g ], sizeof( int ) );
+    hashBytes( hash, &count, sizeof( count ) );
+
+    if ( range.empty() )
     {
-      ( *itr )->draw();
+      continue;
     }
+
+    hashBytes( hash, &m_store.m_position[ range.m_begin ],     range.size() * sizeof( ci::Vec2f ) );
+    hashBytes( hash, &m_store.m_velocity[ range.m_begin ],     range.size() * sizeof( ci::Vec2f ) );
+    hashBytes( hash, &m_store.m_acceleration[ range.m_begin ], range.size() * sizeof( ci::Vec2f ) );
+    hashBytes( hash, &m_store.m_direction[ range.m_begin ],    range.size() * sizeof( ci::Vec2f ) );
   }
+
+  return hash;
 }
 
-void ParticleEmitter::debugDraw( void )
+void ParticleEmitter::retireParticles()
 {
-  for ( auto particleGroup : m_particles )
+  ProfileScope profile( Profiler::PHASE_RETIRE );
+
+  // swap the dead with the last live particle of their group, the slot
+  // they leave at the end of the range is free for the next spawn
+  for ( auto& particleGroup : m_particles )
   {
-    std::vector< Particle* >::iterator itr     = particleGroup.second.begin();
-    std::vector< Particle* >::iterator itr_end = particleGroup.second.end();
+    ParticleRange& range = particleGroup.second;
 
-    for ( ; itr != itr_end; ++itr )
+    for ( size_t i = range.m_begin; i < range.m_end; )
     {
-      ( *itr )->debugDraw();
+      double timeOfDeath = m_store.m_timeOfDeath[ i ];
+
+      if ( timeOfDeath >= 0.0 && timeOfDeath <= m_currentTime )
+      {
+        --range.m_end;
+        m_store.copy( range.m_end, i );
+      }
+      else
+      {
+        ++i;
+      }
     }
   }
 }
 
+void ParticleEmitter::rasterize( SoftwareRasterizer& _rasterizer )
+{
+  ProfileScope profile( Profiler::PHASE_RASTERIZE );
+  EpochGuard   epoch;
+
+  syncParams();
+
+  ReferenceImage     reference = this->reference();
+  const FlockParams& params    = *m_params.get();
+
+  if ( !reference.valid() )
+  {
+    return;
+  }
+
+  for ( auto& particleGroup : m_particles )
+  {
+    Particle::rasterize( m_store, particleGroup.second, reference, params, m_position, m_interpolation, _rasterizer );
+  }
+
+  _rasterizer.flushSplats( *m_threadPool );
+}
+
+#if !defined FLOCKDRAW_HEADLESS
+void ParticleEmitter::draw( void )
+{
+  ProfileScope profile( Profiler::PHASE_DRAW );
+  EpochGuard   epoch;
+
+  syncParams();
+
+  ReferenceImage     reference = this->reference();
+  const FlockParams& params    = *m_params.get();
+
+  if ( !reference.valid() )
+  {
+    return;
+  }
+
+  for ( auto& particleGroup : m_particles )
+  {
+    Particle::draw( m_store, particleGroup.second, reference, params, m_position, m_interpolation );
+  }
+}
+
+void ParticleEmitter::debugDraw( void )
+{
+  for ( auto& particleGroup : m_particles )
+  {
+    Particle::debugDraw( m_store, particleGroup.second, *this );
+  }
+}
+#endif // FLOCKDRAW_HEADLESS
+
+int ParticleEmitter::advance( double _frameDelta )
+{
+  int steps           = 0;
+  m_clockAccumulator += _frameDelta > 0.0 ? _frameDelta : 0.0;
+
+  while ( m_clockAccumulator >= m_fixedStep && steps < m_maxSubSteps )
+  {
+    m_clockTime        += m_fixedStep;
+    m_clockAccumulator -= m_fixedStep;
+    update( m_clockTime, m_fixedStep );
+    ++steps;
+  }
+
+  // a frame too slow to catch up with does not pile up steps for later
+  if ( m_clockAccumulator >= m_fixedStep )
+  {
+    m_clockAccumulator = 0.0;
+  }
+
+  m_interpolation = static_cast< float >( m_clockAccumulator / m_fixedStep );
+  return steps;
+}
+
 void ParticleEmitter::update( double _currentTime, double _delta )
 {
+  // stepped directly, the particles are drawn where they are
+  m_interpolation = 1.0f;
+
   if ( m_lastFlockUpdateTime == 0.0 )
   {
     m_lastFlockUpdateTime = _currentTime - m_updateFlockEvery;
     m_updateFlockTimer    = m_updateFlockEvery;
   }
 
+  m_currentTime = _currentTime;
+
+  if ( m_frameSource && m_frameSource->advance() )
+  {
+    PreparedImage* frame = m_frameSource->current();
+
+    m_referenceSurface = &frame->m_surface;
+    m_steeringField    = &frame->m_steeringField;
+    m_summedAreaTable  = &frame->m_summedAreaTable;
+  }
+
+  // the step and its workers keep the snapshots they start with, whatever
+  // gets published meanwhile. the pin keeps them alive until it returns.
+  EpochGuard epoch;
+
+  syncParams();
+  m_step          = m_params.get();
+  m_stepReference = reference();
+
   if ( m_particlesPerSecond )
   { 
+    ProfileScope profile( Profiler::PHASE_EMIT );
     float particlesToEmit     = static_cast< float >( _delta ) * m_particlesPerSecond + m_particlesPerSecondLeftOver;
     int   particlesToEmmitInt = static_cast< int >( particlesToEmit );
     
@@ -145,163 +465,381 @@ void ParticleEmitter::update( double _currentTime, double _delta )
 
   m_updateFlockTimer += _delta;
 
-  if ( m_particles.size() == 0 )
+  retireParticles();
+
+  if ( m_particles.size() == 0 || !m_stepReference.valid() )
   {
     return;
   }
 
-  m_currentTime       = _currentTime;
-  m_delta             = _delta;
-  m_processing        = m_threads.size();
+  size_t slices = flockSlices( _delta );
 
+  if ( slices > 1 )
+  {
+    // one slice of every group per update, the work stays the same from
+    // one frame to the next instead of spiking every m_updateFlockEvery.
+    // each particle's forces cover the time since it was last flocked, the
+    // ratio of a whole cycle is only for particles not flocked yet.
+    size_t slice          = m_flockSlice % slices;
+    float  updateRatio    = static_cast< float >( slices * _delta / m_updateFlockEvery );
+    m_flockSlice          = ( slice + 1 ) % slices;
+    m_lastFlockUpdateTime = _currentTime;
 
-  std::unique_lock< std::mutex > cl( m_doneLock );
-  m_startCondition.notify_all();
-  m_doneCondition.wait( cl, [ this ](){ return m_processing != 0; } );
+    std::chrono::high_resolution_clock::time_point flockStart = std::chrono::high_resolution_clock::now();
+    updateFlock( updateRatio, slices, slice );
+    m_flockSeconds = std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - flockStart ).count();
+    ++m_flockTicks;
+  }
+  else if ( m_updateFlockTimer >= m_updateFlockEvery )
+  {
+    // one flock tick for every group
+    float updateRatio     = static_cast< float >( ( _currentTime - m_lastFlockUpdateTime ) / m_updateFlockEvery );
+    m_updateFlockTimer    = 0.0;
+    m_lastFlockUpdateTime = _currentTime;
+
+    std::chrono::high_resolution_clock::time_point flockStart = std::chrono::high_resolution_clock::now();
+    updateFlock( updateRatio, 1, 0 );
+    m_flockSeconds = std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - flockStart ).count();
+    ++m_flockTicks;
+  }
 
-  /*for ( auto particleGroup : m_particles )
+  // integration is independent per particle, split the whole store and
+  // skip the free slots of every slab
+  m_liveRanges.clear();
+  for ( auto& particleGroup : m_particles )
   {
-    updateParticles( _currentTime, _delta, particleGroup.second );
-  }*/
+    if ( !particleGroup.second.empty() )
+    {
+      m_liveRanges.push_back( particleGroup.second );
+    }
+  }
 
+  std::chrono::high_resolution_clock::time_point integrateStart = std::chrono::high_resolution_clock::now();
+  ProfileScope profile( Profiler::PHASE_INTEGRATE );
+  m_threadPool->parallelFor( 0, m_store.size(), UPDATE_CHUNK_SIZE, [ & ]( size_t _begin, size_t _end )
+  {
+    for ( size_t i = 0; i < m_liveRanges.size(); ++i )
+    {
+      size_t begin = std::max( _begin, m_liveRanges[ i ].m_begin );
+      size_t end   = std::min( _end,   m_liveRanges[ i ].m_end );
+
+      if ( begin < end )
+      {
+        Particle::update( m_store, ParticleRange( begin, end ), m_stepReference, *m_step, _delta );
+      }
+    }
+  } );
+  m_integrateSeconds = std::chrono::duration< double >( std::chrono::high_resolution_clock::now() - integrateStart ).count();
 }
 
-void ParticleEmitter::updateParticles( double _currentTime, double _delta, std::vector< Particle* >& _particles )
+size_t ParticleEmitter::flockSlices( double _delta ) const
 {
-  size_t itr     = 0;
-  size_t itr_end = _particles.size();
-  size_t itr2;
-  bool   updateFlock = false;
-  float  updateRatio = 0.0f;
-  ci::Vec2f dir;
-  
-  if ( m_updateFlockTimer >= m_updateFlockEvery )
+  size_t slices = 1;
+
+  if ( m_step->m_flockSlices > 0 )
   {
-    m_updateFlockTimer    = 0.0;
-    updateRatio           = static_cast< float >( ( _currentTime - m_lastFlockUpdateTime ) / m_updateFlockEvery );
-    m_lastFlockUpdateTime = _currentTime;
-    updateFlock           = true;
+    slices = static_cast< size_t >( m_step->m_flockSlices );
+  }
+  else if ( _delta > 0.0 )
+  {
+    slices = static_cast< size_t >( std::max( 1.0, floor( m_updateFlockEvery / _delta + 0.5 ) ) );
   }
 
-  // update the flocking routine
-  while ( itr < itr_end )
+  if ( m_step->m_flockBudget > 0 )
   {
-    Particle* p1 = _particles[ itr ];
-    
-    if ( updateFlock )
+    size_t budget = static_cast< size_t >( m_step->m_flockBudget );
+    slices        = std::max( slices, ( liveCount() + budget - 1 ) / budget );
+  }
+
+  return slices;
+}
+
+void ParticleEmitter::updateFlock( float _updateRatio, size_t _slices, size_t _slice )
+{
+  ProfileScope profile( Profiler::PHASE_FLOCK );
+
+  // rebuild the grid of every group, or one over the whole store
+  m_flockGroups.clear();
+  if ( m_step->m_mergeGroups )
+  {
+    // with free slots in between, gather the live particles of every slab
+    m_mergedScratch.m_range = ParticleRange( 0, m_store.size() );
+    m_mergedScratch.m_slots.clear();
+
+    if ( pooledCount() )
+    {
+      for ( auto& particleGroup : m_particles )
+      {
+        for ( size_t i = particleGroup.second.m_begin; i < particleGroup.second.m_end; ++i )
+        {
+          m_mergedScratch.m_slots.push_back( i );
+        }
+      }
+      m_mergedScratch.m_range = ParticleRange( 0, m_mergedScratch.m_slots.size() );
+    }
+
+    m_flockGroups.push_back( &m_mergedScratch );
+  }
+  else
+  {
+    for ( auto& particleGroup : m_particles )
     {
-      itr2 = itr;
-      
-      for( ++itr2; itr2 != itr_end; ++itr2 )
+      if ( !particleGroup.second.empty() )
       {
-        Particle* p2 = _particles[ itr2 ];
-        dir = p1->m_position - p2->m_position;
-        float distSqrd = dir.lengthSquared();
-		  	
-		  	if ( distSqrd < m_zoneRadiusSqrd ) // Neighbor is in the zone
-        {			
-		  		float percent = distSqrd / m_zoneRadiusSqrd;
-	        
-		  		if( percent < m_lowThresh )			// Separation
-          {
-            if ( m_repelStrength < 0.0001f )
-            {
-              continue;
-            }
-
-		  			float F = m_lowThresh * m_repelStrength * updateRatio;
-		  			dir = dir.normalized() * F;
-		  	
-		  			p1->m_acceleration += dir;
-		  			p2->m_acceleration -= dir;
-		  		} 
-          else if( percent < m_highThresh ) // Alignment
-          {	
-            if ( m_alignStrength < 0.0001f )
-            {
-              continue;
-            }
-
-		  			float threshDelta     = m_highThresh - m_lowThresh;
-		  			float adjustedPercent	= ( percent - m_lowThresh ) / threshDelta;
-		  			float F               = ( 1.0f - ( cos( adjustedPercent * PI2 ) * -0.5f + 0.5f ) ) * m_alignStrength * updateRatio;
-		  			
-		  			p1->m_acceleration += p2->m_direction * F;
-		  			p2->m_acceleration += p1->m_direction * F;
-		  			
-		  		} 
-          else 								// Cohesion
-          {
-            if ( m_attractStrength < 0.0001f )
-            {
-              continue;
-            }
-
-		  			float threshDelta     = 1.0f - m_highThresh;
-		  			float adjustedPercent	= ( percent - m_highThresh )/threshDelta;
-		  			float F               = ( 1.0f - ( cos( adjustedPercent * PI2 ) * -0.5f + 0.5f ) ) * m_attractStrength * updateRatio;
-		  								
-		  			dir.normalize();
-		  			dir *= F;
-		  	
-		  			p1->m_acceleration -= dir;
-		  			p2->m_acceleration += dir;
-		  		}
-		  	}
+        FlockScratch& scratch = m_flockScratch[ particleGroup.first ];
+        scratch.m_range       = particleGroup.second;
+        m_flockGroups.push_back( &scratch );
       }
     }
+  }
+
+  m_threadPool->parallelFor( 0, m_flockGroups.size(), 1, [ this ]( size_t _begin, size_t _end )
+  {
+    for ( ; _begin < _end; ++_begin )
+    {
+      buildFlockGroup( *m_flockGroups[ _begin ] );
+    }
+  } );
 
-    p1->update( _currentTime, _delta );
+  // then split the force pass in chunks of particles, whatever their group
+  m_flockChunks.clear();
+  for ( size_t i = 0; i < m_flockGroups.size(); ++i )
+  {
+    size_t count = m_flockGroups[ i ]->m_range.size();
 
-    ++itr;
+    for ( size_t begin = 0; begin < count; begin += FLOCK_CHUNK_SIZE )
+    {
+      FlockChunk chunk;
+      chunk.m_scratch = m_flockGroups[ i ];
+      chunk.m_begin   = begin;
+      chunk.m_end     = count - begin > FLOCK_CHUNK_SIZE ? begin + FLOCK_CHUNK_SIZE : count;
+      m_flockChunks.push_back( chunk );
+    }
   }
+
+  m_threadPool->parallelFor( 0, m_flockChunks.size(), 1, [ this, _updateRatio, _slices, _slice ]( size_t _begin, size_t _end )
+  {
+    for ( ; _begin < _end; ++_begin )
+    {
+      const FlockChunk& chunk = m_flockChunks[ _begin ];
+      flockParticles( *chunk.m_scratch, chunk.m_begin, chunk.m_end, _updateRatio, _slices, _slice );
+    }
+  } );
 }
 
-void ParticleEmitter::threadProcessParticles( int _group )
+// share of the squared zone radius taken by separation and alignment
+static inline float nearZone( float _lowThresh, float _highThresh )
 {
-  std::vector< Particle* >& _particles = m_particles[ _group ];
-  while ( !m_stop )
+  return std::min( 1.0f, std::max( 0.0f, std::max( _lowThresh, _highThresh ) ) );
+}
+
+// store slot of the _item-th particle of a flock group
+static inline size_t slot( const std::vector< size_t >& _slots, const ParticleRange& _range, size_t _item )
+{
+  return _slots.empty() ? _range.m_begin + _item : _slots[ _item ];
+}
+
+void ParticleEmitter::buildFlockGroup( FlockScratch& _scratch )
+{
+  const ParticleRange& range  = _scratch.m_range;
+  SpatialGrid&         grid   = _scratch.m_grid;
+  size_t               count  = range.size();
+
+  const ci::Vec2f*     positions = &m_store.m_position[ range.m_begin ];
+
+  if ( !_scratch.m_slots.empty() )
   {
-    std::unique_lock< std::mutex > cl( m_startLock );
-    m_startCondition.wait( cl );
-    
-    if ( m_stop )
+    _scratch.m_positions.resize( count );
+    for ( size_t i = 0; i < count; ++i )
     {
-      return;
+      _scratch.m_positions[ i ] = m_store.m_position[ _scratch.m_slots[ i ] ];
     }
+    positions = &_scratch.m_positions[ 0 ];
+  }
 
-    updateParticles( m_currentTime, m_delta, _particles );
+  // the grid is rebuilt every flock tick, bucketed by the zone radius. with
+  // the quadtree taking cohesion, only the nearer zones go through it.
+  const FlockParams&   step   = *m_step;
+  ci::Vec2f            bounds = m_stepReference.getSize();
+
+  if ( step.m_barnesHut )
+  {
+    grid.build( positions, count, bounds, sqrt( step.m_zoneRadiusSqrd * nearZone( step.m_lowThresh, step.m_highThresh ) ) );
+    _scratch.m_tree.build( positions, count, bounds );
+  }
+  else
+  {
+    grid.build( positions, count, bounds, sqrt( step.m_zoneRadiusSqrd ) );
+  }
 
-    --m_processing;
-    m_doneCondition.notify_one();
+  // neighbor directions in the grid's cell order, next to its positions
+  _scratch.m_dirX.resize( count );
+  _scratch.m_dirY.resize( count );
+  for ( size_t i = 0; i < count; ++i )
+  {
+    const ci::Vec2f& direction = m_store.m_direction[ slot( _scratch.m_slots, _scratch.m_range, grid.item( i ) ) ];
+    _scratch.m_dirX[ i ] = direction.x;
+    _scratch.m_dirY[ i ] = direction.y;
   }
 }
 
-void ParticleEmitter::killAll()
+void ParticleEmitter::flockParticles( const FlockScratch& _scratch, size_t _begin, size_t _end, float _updateRatio, size_t _slices, size_t _slice )
+{
+  const SpatialGrid& grid          = _scratch.m_grid;
+  const FlockParams& step          = *m_step;
+
+  FlockKernel::Params params;
+  params.m_bounds          = grid.bounds();
+  params.m_zoneRadiusSqrd  = step.m_zoneRadiusSqrd;
+  params.m_lowThresh       = step.m_lowThresh;
+  params.m_highThresh      = step.m_highThresh;
+  params.m_repelStrength   = step.m_repelStrength;
+  params.m_alignStrength   = step.m_alignStrength;
+  params.m_attractStrength = step.m_attractStrength;
+  params.m_updateRatio     = _updateRatio;
+
+  FlockKernel::Neighbors neighbors = { grid.sortedX(), grid.sortedY(), &_scratch.m_dirX[ 0 ], &_scratch.m_dirY[ 0 ] };
+
+  // Barnes-Hut splits the zones: the grid without cohesion, the tree with
+  // cohesion alone. its leaves have no directions, alignment is off there.
+  const QuadTree&        tree          = _scratch.m_tree;
+  FlockKernel::Params    farParams     = params;
+  FlockKernel::Neighbors farNeighbors  = { tree.sortedX(), tree.sortedY(), tree.sortedX(), tree.sortedY() };
+  float                  innerRadius   = sqrt( step.m_zoneRadiusSqrd * nearZone( step.m_lowThresh, step.m_highThresh ) );
+  float                  outerRadius   = sqrt( step.m_zoneRadiusSqrd );
+
+  if ( step.m_barnesHut )
+  {
+    params.m_attractStrength  = 0.0f;
+    farParams.m_repelStrength = 0.0f;
+    farParams.m_alignStrength = 0.0f;
+  }
+
+  // walk the particles in cell order, so neighboring cells stay in cache.
+  // everything is read from the snapshot and each particle only
+  // accumulates its own side of every pair, so chunks never write to the
+  // same particle and the result does not depend on how they are split.
+  for ( size_t itr = _begin; itr < _end; ++itr )
+  {
+    size_t index = slot( _scratch.m_slots, _scratch.m_range, grid.item( itr ) );
+
+    // slices interleave the group, each covers the whole image. slots move
+    // as particles die and slabs grow, ids stay.
+    if ( _slices > 1 && m_store.m_id[ index ] % _slices != _slice )
+    {
+      continue;
+    }
+
+    double& flockTime = m_store.m_flockTime[ index ];
+
+    if ( _slices > 1 && flockTime >= 0.0 )
+    {
+      params.m_updateRatio    = static_cast< float >( ( m_lastFlockUpdateTime - flockTime ) / m_updateFlockEvery );
+      farParams.m_updateRatio = params.m_updateRatio;
+    }
+    else
+    {
+      params.m_updateRatio    = _updateRatio;
+      farParams.m_updateRatio = _updateRatio;
+    }
+    flockTime = m_lastFlockUpdateTime;
+
+    ci::Vec2f        position( grid.sortedX()[ itr ], grid.sortedY()[ itr ] );
+    ci::Vec2f&       acceleration = m_store.m_acceleration[ index ];
+
+    auto flock = [ & ]( size_t _spanBegin, size_t _spanEnd )
+    {
+      FlockKernel::accumulate( params, neighbors, _spanBegin, _spanEnd, position, acceleration );
+    };
+
+    grid.forEachNeighborSpan( position, flock );
+
+    if ( step.m_barnesHut )
+    {
+      auto nearMass = [ & ]( size_t _spanBegin, size_t _spanEnd )
+      {
+        FlockKernel::accumulate( farParams, farNeighbors, _spanBegin, _spanEnd, position, acceleration );
+      };
+
+      auto farMass = [ & ]( const ci::Vec2f& _center, float _mass )
+      {
+        FlockKernel::cohesion( farParams, tree.wrappedDelta( position, _center ), _mass, acceleration );
+      };
+
+      tree.forEachInBand( position, innerRadius, outerRadius, step.m_openingAngle, nearMass, farMass );
+    }
+  }
+}
+
+void ParticleEmitter::populate( int _groups, int _count )
 {
-  m_stop = true;
-  m_startCondition.notify_all();
- 
-  for ( auto& thread : m_threads )
+  for ( auto& particleGroup : m_particles )
   {
-    thread.join();
+    ParticleRange& range  = particleGroup.second;
+    size_t         target = particleGroup.first >= 0 && particleGroup.first < _groups ? static_cast< size_t >( std::max( _count, 0 ) ) : 0;
+
+    if ( range.size() > target )
+    {
+      range.m_end = range.m_begin + target;
+    }
   }
-  m_threads.clear();
 
-  m_stop = false;
+  for ( int i = 0; i < _groups; ++i )
+  {
+    auto   itr  = m_particles.find( i );
+    size_t live = itr == m_particles.end() ? 0 : itr->second.size();
+
+    if ( live < static_cast< size_t >( std::max( _count, 0 ) ) )
+    {
+      addParticles( static_cast< int >( _count - live ), i );
+    }
+  }
+}
 
-  for ( auto particleGroup : m_particles )
+void ParticleEmitter::retarget( const ci::Vec2f& _fromSize, const ci::Vec2f& _toSize )
+{
+  if ( _fromSize.x <= 0.0f || _fromSize.y <= 0.0f )
   {
-    std::vector< Particle* >& particleVector   = particleGroup.second;
-    std::vector< Particle* >::iterator itr     = particleVector.begin();
-    std::vector< Particle* >::iterator itr_end = particleVector.end();
+    return;
+  }
 
-    // update the flocking routine
-    while ( itr != itr_end )
+  ci::Vec2f scale( _toSize.x / _fromSize.x, _toSize.y / _fromSize.y );
+
+  for ( auto& particleGroup : m_particles )
+  {
+    for ( size_t i = particleGroup.second.m_begin; i < particleGroup.second.m_end; ++i )
     {
-      delete *itr;
-      ++itr;
+      ci::Vec2f& position = m_store.m_position[ i ];
+
+      position.x *= scale.x;
+      position.y *= scale.y;
+
+      // nothing to interpolate from across images
+      m_store.m_stablePosition[ i ] = position;
     }
   }
+}
+
+void ParticleEmitter::killAll()
+{
+  // every slab becomes free, the next addParticles() of each group
+  // respawns into it
+  for ( auto& particleGroup : m_particles )
+  {
+    particleGroup.second.m_end = particleGroup.second.m_begin;
+  }
+}
+
+void ParticleEmitter::releasePool()
+{
+  // the thread pool outlives the particles, only the flock scratch goes away
+  m_flockScratch.clear();
+  m_mergedScratch = FlockScratch();
+  m_flockGroups.clear();
+  m_flockChunks.clear();
+  m_liveRanges.clear();
+
+  m_store.clear();
   m_particles.clear();
-}
\ No newline at end of file
+  m_slabEnd.clear();
+}
@@ -0,0 +1,56 @@
+#include "ParticleStore.h"
+
+ParticleStore::ParticleStore( void )
+{
+}
+
+void ParticleStore::insert( size_t _at, size_t _count )
+{
+  m_position.insert(        m_position.begin()        + _at, _count, ci::Vec2f( 0.0f, 0.0f ) );
+  m_velocity.insert(        m_velocity.begin()        + _at, _count, ci::Vec2f( 0.0f, 0.0f ) );
+  m_acceleration.insert(    m_acceleration.begin()    + _at, _count, ci::Vec2f( 0.0f, 0.0f ) );
+  m_direction.insert(       m_direction.begin()       + _at, _count, ci::Vec2f( 0.0f, 0.0f ) );
+  m_maxSpeedSquared.insert( m_maxSpeedSquared.begin() + _at, _count, 0.0f );
+  m_minSpeedSquared.insert( m_minSpeedSquared.begin() + _at, _count, 0.0f );
+
+  m_stablePosition.insert(  m_stablePosition.begin()  + _at, _count, ci::Vec2f( 0.0f, 0.0f ) );
+  m_group.insert(           m_group.begin()           + _at, _count, -1 );
+  m_id.insert(              m_id.begin()              + _at, _count, 0 );
+  m_spawnTime.insert(       m_spawnTime.begin()       + _at, _count, 0.0 );
+  m_timeOfDeath.insert(     m_timeOfDeath.begin()     + _at, _count, -1.0 );
+  m_flockTime.insert(       m_flockTime.begin()       + _at, _count, -1.0 );
+}
+
+void ParticleStore::copy( size_t _from, size_t _to )
+{
+  m_position[ _to ]        = m_position[ _from ];
+  m_velocity[ _to ]        = m_velocity[ _from ];
+  m_acceleration[ _to ]    = m_acceleration[ _from ];
+  m_direction[ _to ]       = m_direction[ _from ];
+  m_maxSpeedSquared[ _to ] = m_maxSpeedSquared[ _from ];
+  m_minSpeedSquared[ _to ] = m_minSpeedSquared[ _from ];
+
+  m_stablePosition[ _to ]  = m_stablePosition[ _from ];
+  m_group[ _to ]           = m_group[ _from ];
+  m_id[ _to ]              = m_id[ _from ];
+  m_spawnTime[ _to ]       = m_spawnTime[ _from ];
+  m_timeOfDeath[ _to ]     = m_timeOfDeath[ _from ];
+  m_flockTime[ _to ]       = m_flockTime[ _from ];
+}
+
+void ParticleStore::clear()
+{
+  m_position.clear();
+  m_velocity.clear();
+  m_acceleration.clear();
+  m_direction.clear();
+  m_maxSpeedSquared.clear();
+  m_minSpeedSquared.clear();
+
+  m_stablePosition.clear();
+  m_group.clear();
+  m_id.clear();
+  m_spawnTime.clear();
+  m_timeOfDeath.clear();
+  m_flockTime.clear();
+}
@@ -0,0 +1,180 @@
+#include "PosterRenderer.h"
+#include "ThreadPool.h"
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+// bands are whole rasterizer tiles
+#define POSTER_BAND_ALIGN  64
+// what a faded step weighs when it stops showing in 8 bits
+#define POSTER_INVISIBLE   ( 1.0f / 512.0f )
+
+PosterRenderer::PosterRenderer( int _width, int _height, float _decay ) :
+  m_width( _width ),
+  m_height( _height ),
+  m_decay( _decay < 0.0f ? 0.0f : ( _decay > 1.0f ? 1.0f : _decay ) ),
+  m_maxSteps( static_cast< size_t >( -1 ) ),
+  m_recorder( 1, 1 ),
+  m_first( 0 )
+{
+  if ( m_decay >= 1.0f )
+  {
+    m_maxSteps = 1;
+  }
+  else if ( m_decay > 0.0f )
+  {
+    m_maxSteps = static_cast< size_t >( ceil( log( POSTER_INVISIBLE ) / log( 1.0f - m_decay ) ) ) + 1;
+  }
+
+  m_recorder.record( &m_splats );
+}
+
+void PosterRenderer::endStep()
+{
+  m_stepEnd.push_back( m_splats.size() );
+
+  // faded out, or over the budget
+  while ( m_stepEnd.size() > 1 && ( m_stepEnd.size() > m_maxSteps || m_splats.size() - m_first > POSTER_MAX_SPLATS ) )
+  {
+    m_first = m_stepEnd.front();
+    m_stepEnd.pop_front();
+  }
+
+  // compact once the dropped splats are half of them
+  if ( m_first > 0 && m_first * 2 >= m_splats.size() )
+  {
+    m_splats.erase( m_splats.begin(), m_splats.begin() + m_first );
+
+    for ( size_t i = 0; i < m_stepEnd.size(); ++i )
+    {
+      m_stepEnd[ i ] -= m_first;
+    }
+    m_first = 0;
+  }
+}
+
+bool PosterRenderer::write( const ci::fs::path& _path, ThreadPool& _pool )
+{
+  if ( m_width <= 0 || m_height <= 0 )
+  {
+    return false;
+  }
+
+  // splats recorded after the last endStep() are the newest step
+  if ( m_stepEnd.empty() || m_stepEnd.back() != m_splats.size() )
+  {
+    endStep();
+  }
+
+  int bandRows = std::max( POSTER_BAND_ALIGN, POSTER_BAND_PIXELS / m_width / POSTER_BAND_ALIGN * POSTER_BAND_ALIGN );
+  bandRows     = std::min( bandRows, m_height );
+  int bands    = ( m_height + bandRows - 1 ) / bandRows;
+
+  // every band lists the splats that reach it, in draw order
+  std::vector< uint32_t > bandStart( bands + 1, 0 );
+  std::vector< uint32_t > bandFill( bands );
+  std::vector< uint32_t > bandSplats;
+
+  for ( int pass = 0; pass < 2; ++pass )
+  {
+    if ( pass == 1 )
+    {
+      for ( int b = 0; b < bands; ++b )
+      {
+        bandStart[ b + 1 ] += bandStart[ b ];
+        bandFill[ b ]       = bandStart[ b ];
+      }
+      bandSplats.resize( bandStart[ bands ] );
+    }
+
+    for ( size_t i = m_first; i < m_splats.size(); ++i )
+    {
+      const SoftwareRasterizer::Splat& splat = m_splats[ i ];
+      float                            reach = splat.m_radius + 0.5f;
+      int                              b0    = static_cast< int >( floor( ( splat.m_y - reach ) / bandRows ) );
+      int                              b1    = static_cast< int >( floor( ( splat.m_y + reach ) / bandRows ) );
+
+      b0 = b0 < 0 ? 0 : b0;
+      b1 = b1 >= bands ? bands - 1 : b1;
+
+      for ( int b = b0; b <= b1; ++b )
+      {
+        if ( pass == 0 )
+        {
+          ++bandStart[ b + 1 ];
+        }
+        else
+        {
+          bandSplats[ bandFill[ b ]++ ] = static_cast< uint32_t >( i - m_first );
+        }
+      }
+    }
+  }
+
+  // fade of every step, the newest one is drawn as is
+  std::vector< float >  weights( m_stepEnd.size() );
+  std::vector< size_t > stepOf( m_splats.size() - m_first );
+
+  for ( size_t s = 0, i = m_first; s < m_stepEnd.size(); ++s )
+  {
+    weights[ s ] = pow( 1.0f - m_decay, static_cast< float >( m_stepEnd.size() - 1 - s ) );
+
+    for ( ; i < m_stepEnd[ s ]; ++i )
+    {
+      stepOf[ i - m_first ] = s;
+    }
+  }
+
+  FILE* file = fopen( _path.string().c_str(), "wb" );
+  if ( !file )
+  {
+    return false;
+  }
+
+  fprintf( file, "P6\n%d %d\n255\n", m_width, m_height );
+
+  SoftwareRasterizer     canvas( m_width, bandRows );
+  std::vector< uint8_t > row( static_cast< size_t >( m_width ) * 3 );
+  bool                   written = true;
+
+  for ( int b = 0; b < bands && written; ++b )
+  {
+    float top = static_cast< float >( b * bandRows );
+
+    canvas.clear( ci::Color( 0.0f, 0.0f, 0.0f ) );
+
+    for ( uint32_t j = bandStart[ b ]; j < bandStart[ b + 1 ]; ++j )
+    {
+      const SoftwareRasterizer::Splat& splat  = m_splats[ m_first + bandSplats[ j ] ];
+      float                            weight = weights[ stepOf[ bandSplats[ j ] ] ];
+      ci::ColorA                       color( splat.m_color.r * weight, splat.m_color.g * weight, splat.m_color.b * weight, splat.m_color.a );
+
+      canvas.addSplat( ci::Vec2f( splat.m_x, splat.m_y - top ), splat.m_radius, color );
+    }
+
+    canvas.flushSplats( _pool );
+    canvas.resolve( _pool );
+
+    const ci::Surface& surface = canvas.getSurface();
+    uint8_t            inc     = surface.getPixelInc();
+    uint8_t            offsets[ 3 ] = { surface.getRedOffset(), surface.getGreenOffset(), surface.getBlueOffset() };
+    int                rows    = std::min( bandRows, m_height - b * bandRows );
+
+    for ( int y = 0; y < rows && written; ++y )
+    {
+      const uint8_t* pixel = surface.getData( ci::Vec2i( 0, y ) );
+
+      for ( int x = 0; x < m_width; ++x, pixel += inc )
+      {
+        row[ x * 3 + 0 ] = pixel[ offsets[ 0 ] ];
+        row[ x * 3 + 1 ] = pixel[ offsets[ 1 ] ];
+        row[ x * 3 + 2 ] = pixel[ offsets[ 2 ] ];
+      }
+
+      written = fwrite( &row[ 0 ], 1, row.size(), file ) == row.size();
+    }
+  }
+
+  return fclose( file ) == 0 && written;
+}
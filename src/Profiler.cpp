@@ -0,0 +1,349 @@
+#include "Profiler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#if defined __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define PROFILER_PERF
+#endif
+
+#if defined _MSC_VER
+#define THREAD_LOCAL __declspec( thread )
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+namespace
+{
+  struct Ring
+  {
+    // events [ m_floor, m_head ) are readable, the latest PROFILER_RING_SIZE of them
+    std::atomic< uint64_t > m_head;
+    std::atomic< uint64_t > m_floor;
+    Profiler::Event         m_events[ PROFILER_RING_SIZE ];
+    size_t                  m_thread;
+    char                    m_name[ 32 ];
+    bool                    m_countersOpen;
+    int                     m_cyclesFd;
+    int                     m_cacheMissesFd;
+  };
+
+  std::atomic< bool >  s_enabled( false );
+  std::atomic< bool >  s_counters( false );
+  std::mutex           s_ringsLock;
+  std::vector< Ring* > s_rings;
+
+  const std::chrono::high_resolution_clock::time_point s_epoch = std::chrono::high_resolution_clock::now();
+
+  THREAD_LOCAL Ring*   t_ring = 0;
+
+  // rings outlive their threads, a thread registers once
+  Ring& threadRing()
+  {
+    if ( !t_ring )
+    {
+      Ring* ring = new Ring();
+      ring->m_head          = 0;
+      ring->m_floor         = 0;
+      ring->m_countersOpen  = false;
+      ring->m_cyclesFd      = -1;
+      ring->m_cacheMissesFd = -1;
+
+      std::lock_guard< std::mutex > rl( s_ringsLock );
+      ring->m_thread = s_rings.size();
+      sprintf( ring->m_name, "thread %d", static_cast< int >( ring->m_thread ) );
+      s_rings.push_back( ring );
+      t_ring = ring;
+    }
+
+    return *t_ring;
+  }
+
+  // appends what is left of _ring once the copy is done: the writer may
+  // have lapped the oldest events meanwhile
+  void collect( const Ring& _ring, std::vector< Profiler::Event >& _events )
+  {
+    uint64_t head  = _ring.m_head.load( std::memory_order_acquire );
+    uint64_t floor = _ring.m_floor.load( std::memory_order_acquire );
+    uint64_t first = std::max( floor, head > PROFILER_RING_SIZE ? head - PROFILER_RING_SIZE : 0 );
+    size_t   mark  = _events.size();
+
+    for ( uint64_t i = first; i < head; ++i )
+    {
+      _events.push_back( _ring.m_events[ i % PROFILER_RING_SIZE ] );
+    }
+
+    uint64_t after = _ring.m_head.load( std::memory_order_acquire ) + 1;
+    uint64_t valid = after > PROFILER_RING_SIZE ? after - PROFILER_RING_SIZE : 0;
+
+    if ( valid > first )
+    {
+      size_t lost = static_cast< size_t >( std::min( valid - first, head - first ) );
+      _events.erase( _events.begin() + mark, _events.begin() + mark + lost );
+    }
+  }
+
+#if defined PROFILER_PERF
+  int openCounter( uint32_t _type, uint64_t _config )
+  {
+    perf_event_attr attr;
+    memset( &attr, 0, sizeof( attr ) );
+    attr.size           = sizeof( attr );
+    attr.type           = _type;
+    attr.config         = _config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+
+    // this thread, any cpu
+    return static_cast< int >( syscall( __NR_perf_event_open, &attr, 0, -1, -1, 0 ) );
+  }
+
+  uint64_t readCounter( int _fd )
+  {
+    uint64_t value = 0;
+    return _fd >= 0 && read( _fd, &value, sizeof( value ) ) == sizeof( value ) ? value : 0;
+  }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Profiler::enable( bool _enabled )
+{
+  s_enabled = _enabled;
+}
+
+bool Profiler::enabled()
+{
+  return s_enabled.load( std::memory_order_relaxed );
+}
+
+bool Profiler::enableCounters( bool _enabled )
+{
+#if defined PROFILER_PERF
+  if ( _enabled )
+  {
+    // probe on this thread, perf may be missing or locked down
+    int fd = openCounter( PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES );
+    if ( fd < 0 )
+    {
+      s_counters = false;
+      return false;
+    }
+    close( fd );
+  }
+
+  s_counters = _enabled;
+  return true;
+#else
+  s_counters = false;
+  return !_enabled;
+#endif
+}
+
+bool Profiler::countersEnabled()
+{
+  return s_counters.load( std::memory_order_relaxed );
+}
+
+void Profiler::setThreadName( const char* _name )
+{
+  Ring& ring = threadRing();
+
+  std::lock_guard< std::mutex > rl( s_ringsLock );
+  strncpy( ring.m_name, _name, sizeof( ring.m_name ) - 1 );
+  ring.m_name[ sizeof( ring.m_name ) - 1 ] = 0;
+}
+
+uint64_t Profiler::now()
+{
+  return static_cast< uint64_t >( std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::high_resolution_clock::now() - s_epoch ).count() );
+}
+
+void Profiler::record( Phase _phase, uint64_t _start, uint64_t _end, uint64_t _cycles, uint64_t _cacheMisses )
+{
+  Ring&    ring  = threadRing();
+  uint64_t head  = ring.m_head.load( std::memory_order_relaxed );
+  Event&   event = ring.m_events[ head % PROFILER_RING_SIZE ];
+
+  event.m_start       = _start;
+  event.m_duration    = _end > _start ? _end - _start : 0;
+  event.m_cycles      = _cycles;
+  event.m_cacheMisses = _cacheMisses;
+  event.m_phase       = _phase;
+
+  ring.m_head.store( head + 1, std::memory_order_release );
+}
+
+void Profiler::readCounters( uint64_t& _cycles, uint64_t& _cacheMisses )
+{
+  _cycles      = 0;
+  _cacheMisses = 0;
+
+#if defined PROFILER_PERF
+  if ( !countersEnabled() )
+  {
+    return;
+  }
+
+  Ring& ring = threadRing();
+
+  if ( !ring.m_countersOpen )
+  {
+    ring.m_countersOpen  = true;
+    ring.m_cyclesFd      = openCounter( PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES );
+    ring.m_cacheMissesFd = openCounter( PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES );
+  }
+
+  _cycles      = readCounter( ring.m_cyclesFd );
+  _cacheMisses = readCounter( ring.m_cacheMissesFd );
+#endif
+}
+
+void Profiler::summarize( double _window, Summary* _summaries )
+{
+  memset( _summaries, 0, sizeof( Summary ) * PHASE_COUNT );
+
+  std::vector< Event > events;
+  {
+    std::lock_guard< std::mutex > rl( s_ringsLock );
+    for ( size_t i = 0; i < s_rings.size(); ++i )
+    {
+      collect( *s_rings[ i ], events );
+    }
+  }
+
+  uint64_t              current = now();
+  uint64_t              since   = _window > 0.0 && current > _window * 1e9 ? current - static_cast< uint64_t >( _window * 1e9 ) : 0;
+  std::vector< double > durations[ PHASE_COUNT ];
+
+  for ( size_t i = 0; i < events.size(); ++i )
+  {
+    const Event& event = events[ i ];
+
+    if ( event.m_phase < 0 || event.m_phase >= PHASE_COUNT || event.m_start < since )
+    {
+      continue;
+    }
+
+    Summary& summary = _summaries[ event.m_phase ];
+    double   ms      = event.m_duration * 1e-6;
+    uint64_t us      = event.m_duration / 1000;
+    int      bucket  = 0;
+
+    while ( us > 1 && bucket < PROFILER_BUCKETS - 1 )
+    {
+      us >>= 1;
+      ++bucket;
+    }
+
+    durations[ event.m_phase ].push_back( ms );
+    summary.m_totalMs     += ms;
+    summary.m_cycles      += event.m_cycles;
+    summary.m_cacheMisses += event.m_cacheMisses;
+    ++summary.m_histogram[ bucket ];
+  }
+
+  for ( int phase = 0; phase < PHASE_COUNT; ++phase )
+  {
+    std::vector< double >& sorted  = durations[ phase ];
+    Summary&               summary = _summaries[ phase ];
+
+    if ( sorted.empty() )
+    {
+      continue;
+    }
+
+    std::sort( sorted.begin(), sorted.end() );
+
+    summary.m_count  = sorted.size();
+    summary.m_meanMs = summary.m_totalMs / sorted.size();
+    summary.m_p50Ms  = sorted[ sorted.size() / 2 ];
+    summary.m_p95Ms  = sorted[ std::min( sorted.size() - 1, sorted.size() * 95 / 100 ) ];
+    summary.m_maxMs  = sorted.back();
+  }
+}
+
+bool Profiler::writeChromeTrace( const ci::fs::path& _path )
+{
+  FILE* file = fopen( _path.string().c_str(), "w" );
+
+  if ( !file )
+  {
+    return false;
+  }
+
+  std::lock_guard< std::mutex > rl( s_ringsLock );
+  std::vector< Event >          events;
+  bool                          first = true;
+
+  fprintf( file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+
+  for ( size_t r = 0; r < s_rings.size(); ++r )
+  {
+    const Ring& ring = *s_rings[ r ];
+
+    fprintf( file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", static_cast< int >( ring.m_thread ), ring.m_name );
+    first = false;
+
+    events.clear();
+    collect( ring, events );
+
+    for ( size_t i = 0; i < events.size(); ++i )
+    {
+      const Event& event = events[ i ];
+
+      fprintf( file, ",\n{\"name\":\"%s\",\"cat\":\"flockdraw\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+               phaseName( static_cast< Phase >( event.m_phase ) ), static_cast< int >( ring.m_thread ), event.m_start * 1e-3, event.m_duration * 1e-3 );
+
+      if ( event.m_cycles || event.m_cacheMisses )
+      {
+        fprintf( file, ",\"args\":{\"cycles\":%llu,\"llc_misses\":%llu}", static_cast< unsigned long long >( event.m_cycles ), static_cast< unsigned long long >( event.m_cacheMisses ) );
+      }
+      fprintf( file, "}" );
+    }
+  }
+
+  fprintf( file, "\n]}\n" );
+  return fclose( file ) == 0;
+}
+
+void Profiler::reset()
+{
+  std::lock_guard< std::mutex > rl( s_ringsLock );
+  for ( size_t i = 0; i < s_rings.size(); ++i )
+  {
+    s_rings[ i ]->m_floor.store( s_rings[ i ]->m_head.load( std::memory_order_acquire ), std::memory_order_release );
+  }
+}
+
+const char* Profiler::phaseName( Phase _phase )
+{
+  switch ( _phase )
+  {
+  case PHASE_EMIT:           return "emit";
+  case PHASE_RETIRE:         return "retire";
+  case PHASE_FLOCK:          return "flock";
+  case PHASE_INTEGRATE:      return "integrate";
+  case PHASE_STEERING_BUILD: return "steering build";
+  case PHASE_RASTERIZE:      return "rasterize";
+  case PHASE_TRAIL:          return "trail";
+  case PHASE_DRAW:           return "draw";
+  case PHASE_PRESENT:        return "present";
+  case PHASE_CAPTURE:        return "capture";
+  case PHASE_ENCODE:         return "encode";
+  case PHASE_DECODE:         return "decode";
+  case PHASE_WORKER_BUSY:    return "worker busy";
+  case PHASE_WORKER_IDLE:    return "worker idle";
+  default:                   return "unknown";
+  }
+}
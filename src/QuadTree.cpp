@@ -0,0 +1,123 @@
+#include "QuadTree.h"
+
+QuadTree::QuadTree( void ) :
+  m_positions( 0 ),
+  m_bounds( 0.0f, 0.0f ),
+  m_halfBounds( 0.0f, 0.0f )
+{
+}
+
+void QuadTree::build( const ci::Vec2f* _positions, size_t _count, const ci::Vec2f& _bounds )
+{
+  m_bounds     = _bounds;
+  m_halfBounds = _bounds * 0.5f;
+  m_positions  = _positions;
+
+  m_nodes.clear();
+  m_items.resize( _count );
+  m_scratch.resize( _count );
+
+  for ( size_t i = 0; i < _count; ++i )
+  {
+    m_items[ i ] = i;
+  }
+
+  if ( _count )
+  {
+    buildNode( 0, _count, 0.0f, 0.0f, _bounds.x, _bounds.y, 0 );
+  }
+
+  m_sortedX.resize( _count );
+  m_sortedY.resize( _count );
+  for ( size_t i = 0; i < _count; ++i )
+  {
+    m_sortedX[ i ] = _positions[ m_items[ i ] ].x;
+    m_sortedY[ i ] = _positions[ m_items[ i ] ].y;
+  }
+
+  m_positions = 0;
+}
+
+int QuadTree::buildNode( size_t _begin, size_t _end, float _x0, float _y0, float _x1, float _y1, int _depth )
+{
+  int  index = static_cast< int >( m_nodes.size() );
+  Node node;
+
+  node.m_x0    = _x0;
+  node.m_y0    = _y0;
+  node.m_x1    = _x1;
+  node.m_y1    = _y1;
+  node.m_mass  = static_cast< float >( _end - _begin );
+  node.m_begin = static_cast< unsigned >( _begin );
+  node.m_end   = static_cast< unsigned >( _end );
+
+  // the center of mass of a node never leaves it, the wrap plays no part
+  float sumX = 0.0f;
+  float sumY = 0.0f;
+  for ( size_t i = _begin; i < _end; ++i )
+  {
+    sumX += m_positions[ m_items[ i ] ].x;
+    sumY += m_positions[ m_items[ i ] ].y;
+  }
+  node.m_massX = sumX / node.m_mass;
+  node.m_massY = sumY / node.m_mass;
+
+  for ( int i = 0; i < 4; ++i )
+  {
+    node.m_children[ i ] = -1;
+  }
+
+  m_nodes.push_back( node );
+
+  if ( _end - _begin <= QUAD_TREE_LEAF_SIZE || _depth >= QUAD_TREE_MAX_DEPTH )
+  {
+    return index;
+  }
+
+  // stable counting sort of the items into the quadrants
+  float  midX          = ( _x0 + _x1 ) * 0.5f;
+  float  midY          = ( _y0 + _y1 ) * 0.5f;
+  size_t quadrantStart[ 5 ] = { 0, 0, 0, 0, 0 };
+
+  for ( size_t i = _begin; i < _end; ++i )
+  {
+    const ci::Vec2f& position = m_positions[ m_items[ i ] ];
+    int              quadrant = ( position.x < midX ? 0 : 1 ) + ( position.y < midY ? 0 : 2 );
+    ++quadrantStart[ quadrant + 1 ];
+  }
+
+  for ( int i = 1; i < 5; ++i )
+  {
+    quadrantStart[ i ] += quadrantStart[ i - 1 ];
+  }
+
+  size_t fill[ 4 ] = { quadrantStart[ 0 ], quadrantStart[ 1 ], quadrantStart[ 2 ], quadrantStart[ 3 ] };
+
+  for ( size_t i = _begin; i < _end; ++i )
+  {
+    const ci::Vec2f& position = m_positions[ m_items[ i ] ];
+    int              quadrant = ( position.x < midX ? 0 : 1 ) + ( position.y < midY ? 0 : 2 );
+    m_scratch[ _begin + fill[ quadrant ]++ ] = m_items[ i ];
+  }
+
+  std::copy( m_scratch.begin() + _begin, m_scratch.begin() + _end, m_items.begin() + _begin );
+
+  // m_nodes grows below, fill the children in through the index
+  for ( int i = 0; i < 4; ++i )
+  {
+    if ( quadrantStart[ i ] == quadrantStart[ i + 1 ] )
+    {
+      continue;
+    }
+
+    float x0    = i & 1 ? midX : _x0;
+    float x1    = i & 1 ? _x1  : midX;
+    float y0    = i & 2 ? midY : _y0;
+    float y1    = i & 2 ? _y1  : midY;
+    int   child = buildNode( _begin + quadrantStart[ i ], _begin + quadrantStart[ i + 1 ], x0, y0, x1, y1, _depth + 1 );
+
+    m_nodes[ index ].m_children[ i ] = child;
+  }
+
+  return index;
+}
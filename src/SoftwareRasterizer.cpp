@@ -0,0 +1,365 @@
+#include "SoftwareRasterizer.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+#include <cmath>
+
+#if defined _M_IX86 || defined _M_X64 || defined __SSE2__
+#include <emmintrin.h>
+#define SPLAT_SSE2
+#endif
+
+#define TO_WORD( x )   ( static_cast< uint16_t >( ( x ) < 0.0f ? 0.0f : ( ( x ) > 1.0f ? 65535.0f : ( x ) * 65535.0f + 0.5f ) ) )
+#define TILE_SIZE      64
+#define TILE_GRAIN     4
+#define ROW_GRAIN      16
+#define TRAIL_CHANNELS 4
+
+// "color * alpha + destination * ( 1 - alpha )" on premultiplied 16 bit
+// channels, ( 1 - alpha ) in 0.16 fixed point. one pixel is 4 channels,
+// so 16 bytes hold 2 of them and the pattern is a single pixel twice.
+struct SplatBlend
+{
+  uint16_t m_keep;
+  uint16_t m_pattern[ 8 ];
+};
+
+static inline float blendAlpha( const ci::ColorA& _color, float _coverage )
+{
+  float alpha = _color.a < 0.0f ? 0.0f : ( _color.a > 1.0f ? 1.0f : _color.a );
+  return alpha * _coverage;
+}
+
+static inline uint16_t blendKeep( float _alpha )
+{
+  float keep = ( 1.0f - _alpha ) * 65536.0f + 0.5f;
+  return static_cast< uint16_t >( keep < 0.0f ? 0.0f : ( keep > 65535.0f ? 65535.0f : keep ) );
+}
+
+// same as _mm_adds_epu16( _mm_mulhi_epu16( destination, keep ), term )
+static inline uint16_t blendChannel( uint16_t _destination, uint16_t _keep, uint16_t _term )
+{
+  uint32_t value = ( ( static_cast< uint32_t >( _destination ) * _keep ) >> 16 ) + _term;
+  return static_cast< uint16_t >( value > 65535 ? 65535 : value );
+}
+
+static void setupBlend( SplatBlend& _blend, const ci::ColorA& _color, float _coverage )
+{
+  float alpha = blendAlpha( _color, _coverage );
+
+  _blend.m_keep                           = blendKeep( alpha );
+  _blend.m_pattern[ 0 ] = _blend.m_pattern[ 4 ] = TO_WORD( _color.r * alpha );
+  _blend.m_pattern[ 1 ] = _blend.m_pattern[ 5 ] = TO_WORD( _color.g * alpha );
+  _blend.m_pattern[ 2 ] = _blend.m_pattern[ 6 ] = TO_WORD( _color.b * alpha );
+  _blend.m_pattern[ 3 ] = _blend.m_pattern[ 7 ] = TO_WORD( alpha );
+}
+
+// single pixel with partial coverage
+static inline void blendPixel( uint16_t* _pixel, const ci::ColorA& _color, float _coverage )
+{
+  SplatBlend blend;
+  setupBlend( blend, _color, _coverage );
+
+  for ( int c = 0; c < TRAIL_CHANNELS; ++c )
+  {
+    _pixel[ c ] = blendChannel( _pixel[ c ], blend.m_keep, blend.m_pattern[ c ] );
+  }
+}
+
+static void blendSpan( uint16_t* _pixel, int _pixels, const SplatBlend& _blend )
+{
+  int i        = 0;
+  int channels = _pixels * TRAIL_CHANNELS;
+
+#if defined SPLAT_SSE2
+  __m128i keep = _mm_set1_epi16( static_cast< short >( _blend.m_keep ) );
+  __m128i term = _mm_loadu_si128( reinterpret_cast< const __m128i* >( _blend.m_pattern ) );
+
+  for ( ; i + 8 <= channels; i += 8 )
+  {
+    __m128i destination = _mm_loadu_si128( reinterpret_cast< const __m128i* >( _pixel + i ) );
+    _mm_storeu_si128( reinterpret_cast< __m128i* >( _pixel + i ), _mm_adds_epu16( _mm_mulhi_epu16( destination, keep ), term ) );
+  }
+#endif
+
+  for ( ; i < channels; ++i )
+  {
+    _pixel[ i ] = blendChannel( _pixel[ i ], _blend.m_keep, _blend.m_pattern[ i & 3 ] );
+  }
+}
+
+// exponential decay towards black: every channel, alpha included, times keep
+static void decaySpan( uint16_t* _channel, size_t _count, uint16_t _keep )
+{
+  size_t i = 0;
+
+#if defined SPLAT_SSE2
+  __m128i keep = _mm_set1_epi16( static_cast< short >( _keep ) );
+
+  for ( ; i + 8 <= _count; i += 8 )
+  {
+    __m128i value = _mm_loadu_si128( reinterpret_cast< const __m128i* >( _channel + i ) );
+    _mm_storeu_si128( reinterpret_cast< __m128i* >( _channel + i ), _mm_mulhi_epu16( value, keep ) );
+  }
+#endif
+
+  for ( ; i < _count; ++i )
+  {
+    _channel[ i ] = static_cast< uint16_t >( ( static_cast< uint32_t >( _channel[ i ] ) * _keep ) >> 16 );
+  }
+}
+
+SoftwareRasterizer::SoftwareRasterizer( int _width, int _height ) :
+  m_surface( _width, _height, false ),
+  m_trail( static_cast< size_t >( _width ) * _height * TRAIL_CHANNELS, 0 ),
+  m_tilesX( ( _width  + TILE_SIZE - 1 ) / TILE_SIZE ),
+  m_tilesY( ( _height + TILE_SIZE - 1 ) / TILE_SIZE ),
+  m_recording( 0 )
+{
+  clear( ci::Color( 0.0f, 0.0f, 0.0f ) );
+}
+
+void SoftwareRasterizer::clear( const ci::Color& _color )
+{
+  uint16_t pixel[ TRAIL_CHANNELS ] = { TO_WORD( _color.r ), TO_WORD( _color.g ), TO_WORD( _color.b ), 65535 };
+
+  for ( size_t i = 0; i < m_trail.size(); ++i )
+  {
+    m_trail[ i ] = pixel[ i & 3 ];
+  }
+
+  uint8_t offsets[ 3 ] = { m_surface.getRedOffset(), m_surface.getGreenOffset(), m_surface.getBlueOffset() };
+  resolveRows( 0, m_surface.getHeight(), m_surface.getData(), m_surface.getRowBytes(), m_surface.getPixelInc(), offsets );
+}
+
+void SoftwareRasterizer::decay( float _rate, ThreadPool& _pool )
+{
+  ProfileScope profile( Profiler::PHASE_TRAIL );
+
+  uint16_t keep = blendKeep( _rate < 0.0f ? 0.0f : ( _rate > 1.0f ? 1.0f : _rate ) );
+  size_t   row  = static_cast< size_t >( m_surface.getWidth() ) * TRAIL_CHANNELS;
+
+  if ( m_trail.empty() )
+  {
+    return;
+  }
+
+  _pool.parallelFor( 0, m_surface.getHeight(), ROW_GRAIN, [ this, keep, row ]( size_t _begin, size_t _end )
+  {
+    decaySpan( &m_trail[ _begin * row ], ( _end - _begin ) * row, keep );
+  } );
+}
+
+void SoftwareRasterizer::resolve( ThreadPool& _pool )
+{
+  uint8_t offsets[ 3 ] = { m_surface.getRedOffset(), m_surface.getGreenOffset(), m_surface.getBlueOffset() };
+
+  resolve( _pool, m_surface.getData(), m_surface.getRowBytes(), m_surface.getPixelInc(), offsets );
+}
+
+void SoftwareRasterizer::resolve( ThreadPool& _pool, uint8_t* _rgb, size_t _stride )
+{
+  uint8_t offsets[ 3 ] = { 0, 1, 2 };
+
+  resolve( _pool, _rgb, _stride, 3, offsets );
+}
+
+void SoftwareRasterizer::resolve( ThreadPool& _pool, uint8_t* _rgb, size_t _stride, uint8_t _inc, const uint8_t* _offsets )
+{
+  ProfileScope profile( Profiler::PHASE_TRAIL );
+
+  _pool.parallelFor( 0, m_surface.getHeight(), ROW_GRAIN, [ this, _rgb, _stride, _inc, _offsets ]( size_t _begin, size_t _end )
+  {
+    resolveRows( static_cast< int >( _begin ), static_cast< int >( _end ), _rgb, _stride, _inc, _offsets );
+  } );
+}
+
+void SoftwareRasterizer::resolveRows( int _begin, int _end, uint8_t* _rgb, size_t _stride, uint8_t _inc, const uint8_t* _offsets )
+{
+  // over black, the premultiplied color is the color on screen
+  int width = m_surface.getWidth();
+
+  for ( int y = _begin; y < _end; ++y )
+  {
+    const uint16_t* channel = &m_trail[ static_cast< size_t >( y ) * width * TRAIL_CHANNELS ];
+    uint8_t*        pixel   = _rgb + static_cast< size_t >( y ) * _stride;
+
+    for ( int x = 0; x < width; ++x, channel += TRAIL_CHANNELS, pixel += _inc )
+    {
+      for ( int c = 0; c < 3; ++c )
+      {
+        uint32_t value = channel[ c ] + 128u;
+        pixel[ _offsets[ c ] ] = static_cast< uint8_t >( ( value > 65535 ? 65535 : value ) >> 8 );
+      }
+    }
+  }
+}
+
+void SoftwareRasterizer::drawSolidCircle( const ci::Vec2f& _center, float _radius, const ci::ColorA& _color )
+{
+  Splat splat;
+  splat.m_x      = _center.x;
+  splat.m_y      = _center.y;
+  splat.m_radius = _radius;
+  splat.m_color  = _color;
+
+  drawSplat( splat, 0, 0, m_surface.getWidth(), m_surface.getHeight() );
+}
+
+void SoftwareRasterizer::addSplat( const ci::Vec2f& _center, float _radius, const ci::ColorA& _color )
+{
+  Splat splat;
+  splat.m_x      = _center.x;
+  splat.m_y      = _center.y;
+  splat.m_radius = _radius;
+  splat.m_color  = _color;
+
+  m_splats.push_back( splat );
+}
+
+void SoftwareRasterizer::flushSplats( ThreadPool& _pool )
+{
+  if ( m_recording )
+  {
+    m_recording->insert( m_recording->end(), m_splats.begin(), m_splats.end() );
+    m_splats.clear();
+    return;
+  }
+
+  size_t tiles = static_cast< size_t >( m_tilesX ) * m_tilesY;
+
+  m_tileStart.assign( tiles + 1, 0 );
+  m_tileFill.resize( tiles );
+
+  // bin by bounding box, counting first. every tile lists its splats in
+  // draw order, which keeps the blending order of the one by one path.
+  for ( int pass = 0; pass < 2; ++pass )
+  {
+    if ( pass == 1 )
+    {
+      for ( size_t t = 0; t < tiles; ++t )
+      {
+        m_tileStart[ t + 1 ] += m_tileStart[ t ];
+        m_tileFill[ t ]       = m_tileStart[ t ];
+      }
+      m_tileSplats.resize( m_tileStart[ tiles ] );
+    }
+
+    for ( size_t i = 0; i < m_splats.size(); ++i )
+    {
+      const Splat& splat = m_splats[ i ];
+      float        reach = splat.m_radius + 0.5f;
+      int          tx0   = static_cast< int >( floor( ( splat.m_x - reach ) / TILE_SIZE ) );
+      int          ty0   = static_cast< int >( floor( ( splat.m_y - reach ) / TILE_SIZE ) );
+      int          tx1   = static_cast< int >( floor( ( splat.m_x + reach ) / TILE_SIZE ) );
+      int          ty1   = static_cast< int >( floor( ( splat.m_y + reach ) / TILE_SIZE ) );
+
+      tx0 = tx0 < 0 ? 0 : tx0;
+      ty0 = ty0 < 0 ? 0 : ty0;
+      tx1 = tx1 >= m_tilesX ? m_tilesX - 1 : tx1;
+      ty1 = ty1 >= m_tilesY ? m_tilesY - 1 : ty1;
+
+      for ( int ty = ty0; ty <= ty1; ++ty )
+      {
+        for ( int tx = tx0; tx <= tx1; ++tx )
+        {
+          size_t tile = static_cast< size_t >( ty ) * m_tilesX + tx;
+
+          if ( pass == 0 )
+          {
+            ++m_tileStart[ tile + 1 ];
+          }
+          else
+          {
+            m_tileSplats[ m_tileFill[ tile ]++ ] = static_cast< uint32_t >( i );
+          }
+        }
+      }
+    }
+  }
+
+  // tiles never share pixels, so they rasterize side by side
+  _pool.parallelFor( 0, tiles, TILE_GRAIN, [ this ]( size_t _begin, size_t _end )
+  {
+    for ( size_t tile = _begin; tile < _end; ++tile )
+    {
+      int x0 = static_cast< int >( tile % m_tilesX ) * TILE_SIZE;
+      int y0 = static_cast< int >( tile / m_tilesX ) * TILE_SIZE;
+      int x1 = x0 + TILE_SIZE > m_surface.getWidth()  ? m_surface.getWidth()  : x0 + TILE_SIZE;
+      int y1 = y0 + TILE_SIZE > m_surface.getHeight() ? m_surface.getHeight() : y0 + TILE_SIZE;
+
+      for ( uint32_t i = m_tileStart[ tile ]; i < m_tileStart[ tile + 1 ]; ++i )
+      {
+        drawSplat( m_splats[ m_tileSplats[ i ] ], x0, y0, x1, y1 );
+      }
+    }
+  } );
+
+  m_splats.clear();
+}
+
+void SoftwareRasterizer::drawSplat( const Splat& _splat, int _x0, int _y0, int _x1, int _y1 )
+{
+  float   outer   = _splat.m_radius + 0.5f;
+  float   inner   = _splat.m_radius - 0.5f;
+  int     yBegin  = static_cast< int >( floor( _splat.m_y - outer ) );
+  int     yEnd    = static_cast< int >( ceil(  _splat.m_y + outer ) );
+  int     width   = m_surface.getWidth();
+
+  SplatBlend solid;
+  setupBlend( solid, _splat.m_color, 1.0f );
+
+  yBegin = yBegin < _y0 ? _y0 : yBegin;
+  yEnd   = yEnd   > _y1 ? _y1 : yEnd;
+
+  // per row: a fully covered span in the middle, pixels with partial
+  // coverage ( radius + 0.5 - distance ) on both sides of it
+  for ( int y = yBegin; y < yEnd; ++y )
+  {
+    float dy  = y + 0.5f - _splat.m_y;
+    float dy2 = dy * dy;
+
+    if ( dy2 >= outer * outer )
+    {
+      continue;
+    }
+
+    float outerSpan  = sqrt( outer * outer - dy2 );
+    int   xBegin     = static_cast< int >( ceil(  _splat.m_x - outerSpan - 0.5f ) );
+    int   xEnd       = static_cast< int >( floor( _splat.m_x + outerSpan - 0.5f ) ) + 1;
+    int   solidBegin = xEnd;
+    int   solidEnd   = xEnd;
+
+    if ( inner > 0.0f && dy2 <= inner * inner )
+    {
+      float innerSpan = sqrt( inner * inner - dy2 );
+      solidBegin      = static_cast< int >( ceil(  _splat.m_x - innerSpan - 0.5f ) );
+      solidEnd        = static_cast< int >( floor( _splat.m_x + innerSpan - 0.5f ) ) + 1;
+    }
+
+    xBegin     = xBegin < _x0 ? _x0 : xBegin;
+    xEnd       = xEnd   > _x1 ? _x1 : xEnd;
+    solidBegin = solidBegin < xBegin ? xBegin : ( solidBegin > xEnd ? xEnd : solidBegin );
+    solidEnd   = solidEnd   < solidBegin ? solidBegin : ( solidEnd > xEnd ? xEnd : solidEnd );
+
+    uint16_t* row = &m_trail[ static_cast< size_t >( y ) * width * TRAIL_CHANNELS ];
+
+    for ( int x = xBegin; x < xEnd; ++x )
+    {
+      if ( x == solidBegin && solidBegin < solidEnd )
+      {
+        blendSpan( row + x * TRAIL_CHANNELS, solidEnd - x, solid );
+        x = solidEnd - 1;
+        continue;
+      }
+
+      float dx       = x + 0.5f - _splat.m_x;
+      float coverage = outer - sqrt( dx * dx + dy2 );
+
+      if ( coverage > 0.0f )
+      {
+        blendPixel( row + x * TRAIL_CHANNELS, _splat.m_color, coverage > 1.0f ? 1.0f : coverage );
+      }
+    }
+  }
+}
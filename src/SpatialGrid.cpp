@@ -0,0 +1,60 @@
+#include "SpatialGrid.h"
+
+SpatialGrid::SpatialGrid( void ) :
+  m_bounds( 0.0f, 0.0f ),
+  m_halfBounds( 0.0f, 0.0f ),
+  m_cellsX( 1 ),
+  m_cellsY( 1 ),
+  m_cellWidth( 1.0f ),
+  m_cellHeight( 1.0f )
+{
+}
+
+void SpatialGrid::build( const ci::Vec2f* _positions, size_t _count, const ci::Vec2f& _bounds, float _cellSize )
+{
+  m_bounds     = _bounds;
+  m_halfBounds = _bounds * 0.5f;
+
+  // stretch the cells so they tile the wrapping area exactly
+  m_cellsX     = _cellSize > 0.0f ? static_cast< int >( _bounds.x / _cellSize ) : 1;
+  m_cellsY     = _cellSize > 0.0f ? static_cast< int >( _bounds.y / _cellSize ) : 1;
+  m_cellsX     = m_cellsX < 1 ? 1 : m_cellsX;
+  m_cellsY     = m_cellsY < 1 ? 1 : m_cellsY;
+  m_cellWidth  = _bounds.x > 0.0f ? _bounds.x / m_cellsX : 1.0f;
+  m_cellHeight = _bounds.y > 0.0f ? _bounds.y / m_cellsY : 1.0f;
+
+  size_t cellCount = static_cast< size_t >( m_cellsX ) * m_cellsY;
+
+  // counting sort of the items by cell
+  m_cellStart.assign( cellCount + 1, 0 );
+  m_itemCell.resize( _count );
+
+  for ( size_t i = 0; i < _count; ++i )
+  {
+    int cellX = wrapCell( static_cast< int >( _positions[ i ].x / m_cellWidth  ), m_cellsX );
+    int cellY = wrapCell( static_cast< int >( _positions[ i ].y / m_cellHeight ), m_cellsY );
+    int cell  = cellY * m_cellsX + cellX;
+
+    m_itemCell[ i ] = cell;
+    ++m_cellStart[ cell + 1 ];
+  }
+
+  for ( size_t i = 1; i <= cellCount; ++i )
+  {
+    m_cellStart[ i ] += m_cellStart[ i - 1 ];
+  }
+
+  m_cellFill.assign( m_cellStart.begin(), m_cellStart.end() - 1 );
+  m_cellItems.resize( _count );
+  m_sortedX.resize( _count );
+  m_sortedY.resize( _count );
+
+  for ( size_t i = 0; i < _count; ++i )
+  {
+    size_t slot = m_cellFill[ m_itemCell[ i ] ]++;
+
+    m_cellItems[ slot ] = i;
+    m_sortedX[ slot ]   = _positions[ i ].x;
+    m_sortedY[ slot ]   = _positions[ i ].y;
+  }
+}
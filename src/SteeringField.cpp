@@ -0,0 +1,142 @@
+#include "SteeringField.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+#include <cmath>
+#include <algorithm>
+
+#define FLAT_ENERGY      1e-4f
+#define MIN_COHERENCE    0.05f
+#define ROWS_PER_TASK    16
+
+SteeringField::SteeringField( void ) :
+  m_width( 0 ),
+  m_height( 0 )
+{
+}
+
+void SteeringField::clear()
+{
+  m_field.clear();
+  m_width  = 0;
+  m_height = 0;
+}
+
+void SteeringField::swap( SteeringField& _other )
+{
+  m_field.swap( _other.m_field );
+  std::swap( m_width,  _other.m_width );
+  std::swap( m_height, _other.m_height );
+}
+
+void SteeringField::build( const ci::Surface& _surface, ThreadPool& _pool )
+{
+  ProfileScope profile( Profiler::PHASE_STEERING_BUILD );
+
+  m_width  = _surface.getWidth();
+  m_height = _surface.getHeight();
+
+  if ( m_width == 0 || m_height == 0 )
+  {
+    clear();
+    return;
+  }
+
+  // the tensor is only needed while building, 12 bytes a pixel are not
+  // kept around with the field
+  size_t               pixels = static_cast< size_t >( m_width ) * m_height;
+  std::vector< float > structure( pixels * 3 );
+  m_field.resize( pixels * 2 );
+
+  const uint8_t  inc     = _surface.getPixelInc();
+  const uint8_t  offsets[ 3 ] = { _surface.getRedOffset(), _surface.getGreenOffset(), _surface.getBlueOffset() };
+  const int      width   = m_width;
+  const int      height  = m_height;
+
+  // structure tensor ( gx*gx, gx*gy, gy*gy ) of the Sobel gradients, summed
+  // over the color channels
+  _pool.parallelFor( 0, m_height, ROWS_PER_TASK, [ & ]( size_t _begin, size_t _end )
+  {
+    for ( int y = static_cast< int >( _begin ); y < static_cast< int >( _end ); ++y )
+    {
+      const uint8_t* rows[ 3 ] =
+      {
+        _surface.getData( ci::Vec2i( 0, y > 0 ? y - 1 : 0 ) ),
+        _surface.getData( ci::Vec2i( 0, y ) ),
+        _surface.getData( ci::Vec2i( 0, y < height - 1 ? y + 1 : y ) )
+      };
+      float* tensor = &structure[ static_cast< size_t >( y ) * width * 3 ];
+
+      for ( int x = 0; x < width; ++x, tensor += 3 )
+      {
+        int left  = ( x > 0         ? x - 1 : 0 ) * inc;
+        int mid   = x * inc;
+        int right = ( x < width - 1 ? x + 1 : x ) * inc;
+
+        tensor[ 0 ] = tensor[ 1 ] = tensor[ 2 ] = 0.0f;
+
+        for ( int c = 0; c < 3; ++c )
+        {
+          int o  = offsets[ c ];
+          int gx = ( rows[ 0 ][ right + o ] + 2 * rows[ 1 ][ right + o ] + rows[ 2 ][ right + o ] )
+                 - ( rows[ 0 ][ left  + o ] + 2 * rows[ 1 ][ left  + o ] + rows[ 2 ][ left  + o ] );
+          int gy = ( rows[ 2 ][ left  + o ] + 2 * rows[ 2 ][ mid   + o ] + rows[ 2 ][ right + o ] )
+                 - ( rows[ 0 ][ left  + o ] + 2 * rows[ 0 ][ mid   + o ] + rows[ 0 ][ right + o ] );
+
+          float fx = gx * ( 1.0f / 255.0f );
+          float fy = gy * ( 1.0f / 255.0f );
+
+          tensor[ 0 ] += fx * fx;
+          tensor[ 1 ] += fx * fy;
+          tensor[ 2 ] += fy * fy;
+        }
+      }
+    }
+  } );
+
+  // 3x3 box smoothing of the tensor, then its minor eigenvector
+  _pool.parallelFor( 0, m_height, ROWS_PER_TASK, [ & ]( size_t _begin, size_t _end )
+  {
+    for ( int y = static_cast< int >( _begin ); y < static_cast< int >( _end ); ++y )
+    {
+      int8_t* field = &m_field[ static_cast< size_t >( y ) * width * 2 ];
+
+      for ( int x = 0; x < width; ++x, field += 2 )
+      {
+        float a = 0.0f, b = 0.0f, c = 0.0f;
+
+        for ( int dy = -1; dy <= 1; ++dy )
+        {
+          int ny = y + dy < 0 ? 0 : ( y + dy >= height ? height - 1 : y + dy );
+
+          for ( int dx = -1; dx <= 1; ++dx )
+          {
+            int          nx     = x + dx < 0 ? 0 : ( x + dx >= width ? width - 1 : x + dx );
+            const float* tensor = &structure[ ( static_cast< size_t >( ny ) * width + nx ) * 3 ];
+
+            a += tensor[ 0 ];
+            b += tensor[ 1 ];
+            c += tensor[ 2 ];
+          }
+        }
+
+        float energy    = a + c;
+        float anisotropy = sqrt( ( a - c ) * ( a - c ) + 4.0f * b * b );
+
+        // flat or isotropic areas do not steer
+        if ( energy < FLAT_ENERGY || anisotropy < MIN_COHERENCE * energy )
+        {
+          field[ 0 ] = field[ 1 ] = 0;
+          continue;
+        }
+
+        // the gradient runs along phi, the isophote across it
+        float phi  = 0.5f * atan2( 2.0f * b, a - c );
+        field[ 0 ] = static_cast< int8_t >( floor( -sin( phi ) * 127.0f + 0.5f ) );
+        field[ 1 ] = static_cast< int8_t >( floor(  cos( phi ) * 127.0f + 0.5f ) );
+      }
+    }
+  } );
+
+  // the tensor is only scratch, the next build resizes it again
+}
@@ -0,0 +1,120 @@
+#include "SummedAreaTable.h"
+#include "ThreadPool.h"
+
+#include <cmath>
+#include <algorithm>
+
+#define ROWS_PER_TASK    16
+#define COLUMNS_PER_TASK 64
+
+SummedAreaTable::SummedAreaTable( void ) :
+  m_width( 0 ),
+  m_height( 0 )
+{
+}
+
+void SummedAreaTable::clear()
+{
+  m_sums.clear();
+  m_width  = 0;
+  m_height = 0;
+}
+
+void SummedAreaTable::swap( SummedAreaTable& _other )
+{
+  m_sums.swap( _other.m_sums );
+  std::swap( m_width,  _other.m_width );
+  std::swap( m_height, _other.m_height );
+}
+
+void SummedAreaTable::build( const ci::Surface& _surface, ThreadPool& _pool )
+{
+  m_width  = _surface.getWidth();
+  m_height = _surface.getHeight();
+
+  if ( m_width == 0 || m_height == 0 )
+  {
+    clear();
+    return;
+  }
+
+  const size_t  stride = ( static_cast< size_t >( m_width ) + 1 ) * 4;
+  const uint8_t inc    = _surface.getPixelInc();
+  const uint8_t rOff   = _surface.getRedOffset();
+  const uint8_t gOff   = _surface.getGreenOffset();
+  const uint8_t bOff   = _surface.getBlueOffset();
+  const int     width  = m_width;
+  const int     height = m_height;
+
+  m_sums.resize( stride * ( m_height + 1 ) );
+  std::fill( m_sums.begin(), m_sums.begin() + stride, 0 );
+
+  // prefix sums along every row
+  _pool.parallelFor( 0, m_height, ROWS_PER_TASK, [ & ]( size_t _begin, size_t _end )
+  {
+    for ( size_t y = _begin; y < _end; ++y )
+    {
+      const uint8_t* pixel = _surface.getData( ci::Vec2i( 0, static_cast< int >( y ) ) );
+      uint32_t*      sums  = &m_sums[ ( y + 1 ) * stride ];
+      uint32_t       r = 0, g = 0, b = 0, l = 0;
+
+      sums[ 0 ] = sums[ 1 ] = sums[ 2 ] = sums[ 3 ] = 0;
+      sums     += 4;
+
+      for ( int x = 0; x < width; ++x, pixel += inc, sums += 4 )
+      {
+        r += pixel[ rOff ];
+        g += pixel[ gOff ];
+        b += pixel[ bOff ];
+        l += ( 299 * pixel[ rOff ] + 587 * pixel[ gOff ] + 114 * pixel[ bOff ] + 500 ) / 1000;
+
+        sums[ 0 ] = r;
+        sums[ 1 ] = g;
+        sums[ 2 ] = b;
+        sums[ 3 ] = l;
+      }
+    }
+  } );
+
+  // then down every column, a strip of columns per task
+  _pool.parallelFor( 0, stride, COLUMNS_PER_TASK * 4, [ & ]( size_t _begin, size_t _end )
+  {
+    for ( int y = 1; y < height; ++y )
+    {
+      const uint32_t* above = &m_sums[ y * stride ];
+      uint32_t*       sums  = &m_sums[ ( y + 1 ) * stride ];
+
+      for ( size_t i = _begin; i < _end; ++i )
+      {
+        sums[ i ] += above[ i ];
+      }
+    }
+  } );
+}
+
+void SummedAreaTable::average( const ci::Vec2f& _position, float _radius, ci::ColorA& _color, float& _luminance ) const
+{
+  // the box covers the pixels [ x0, x1 ) x [ y0, y1 ), at least one
+  int x0 = static_cast< int >( floor( _position.x - _radius ) );
+  int y0 = static_cast< int >( floor( _position.y - _radius ) );
+  int x1 = static_cast< int >( floor( _position.x + _radius ) ) + 1;
+  int y1 = static_cast< int >( floor( _position.y + _radius ) ) + 1;
+
+  x0 = x0 < 0 ? 0 : ( x0 >= m_width  ? m_width  - 1 : x0 );
+  y0 = y0 < 0 ? 0 : ( y0 >= m_height ? m_height - 1 : y0 );
+  x1 = x1 <= x0 ? x0 + 1 : ( x1 > m_width  ? m_width  : x1 );
+  y1 = y1 <= y0 ? y0 + 1 : ( y1 > m_height ? m_height : y1 );
+
+  const size_t    stride = ( static_cast< size_t >( m_width ) + 1 ) * 4;
+  const uint32_t* a      = &m_sums[ y0 * stride + x0 * 4 ];
+  const uint32_t* b      = &m_sums[ y0 * stride + x1 * 4 ];
+  const uint32_t* c      = &m_sums[ y1 * stride + x0 * 4 ];
+  const uint32_t* d      = &m_sums[ y1 * stride + x1 * 4 ];
+  float           scale  = 1.0f / ( 255.0f * ( x1 - x0 ) * ( y1 - y0 ) );
+
+  _color.r   = ( d[ 0 ] - b[ 0 ] - c[ 0 ] + a[ 0 ] ) * scale;
+  _color.g   = ( d[ 1 ] - b[ 1 ] - c[ 1 ] + a[ 1 ] ) * scale;
+  _color.b   = ( d[ 2 ] - b[ 2 ] - c[ 2 ] + a[ 2 ] ) * scale;
+  _color.a   = 1.0f;
+  _luminance = ( d[ 3 ] - b[ 3 ] - c[ 3 ] + a[ 3 ] ) * scale;
+}
@@ -0,0 +1,229 @@
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+#include <cstdio>
+
+#if defined _MSC_VER
+#define THREAD_LOCAL __declspec( thread )
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+namespace
+{
+  // pool and queue owned by the current thread, if it is a worker
+  THREAD_LOCAL ThreadPool* t_pool  = 0;
+  THREAD_LOCAL size_t      t_queue = 0;
+}
+
+ThreadPool::ThreadPool( size_t _workers ) :
+  m_pending( 0 ),
+  m_nextQueue( 0 ),
+  m_stop( false )
+{
+  if ( _workers == THREAD_POOL_HARDWARE )
+  {
+    size_t hardware = std::thread::hardware_concurrency();
+    _workers        = hardware > 1 ? hardware - 1 : 0;
+  }
+
+  for ( size_t i = 0; i < _workers; ++i )
+  {
+    m_queues.push_back( new Queue() );
+  }
+
+  for ( size_t i = 0; i < _workers; ++i )
+  {
+    m_workers.push_back( std::thread( &ThreadPool::workerLoop, this, i ) );
+  }
+}
+
+ThreadPool::~ThreadPool( void )
+{
+  {
+    std::lock_guard< std::mutex > sl( m_sleepLock );
+    m_stop = true;
+  }
+  m_wake.notify_all();
+
+  for ( auto& worker : m_workers )
+  {
+    worker.join();
+  }
+
+  for ( auto queue : m_queues )
+  {
+    delete queue;
+  }
+}
+
+ThreadPool& ThreadPool::shared()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+void ThreadPool::parallelFor( size_t _begin, size_t _end, size_t _grain, const RangeFunction& _function )
+{
+  if ( _begin >= _end )
+  {
+    return;
+  }
+
+  _grain        = _grain ? _grain : 1;
+  size_t chunks = ( _end - _begin + _grain - 1 ) / _grain;
+
+  if ( chunks == 1 || m_queues.empty() )
+  {
+    _function( _begin, _end );
+    return;
+  }
+
+  // workers queue their own chunks, anyone else spreads them around
+  size_t own = t_pool == this ? t_queue : m_queues.size();
+  Batch  batch;
+  batch.m_remaining = chunks;
+
+  for ( size_t begin = _begin; begin < _end; begin += _grain )
+  {
+    Job job;
+    job.m_function = &_function;
+    job.m_begin    = begin;
+    job.m_end      = _end - begin > _grain ? begin + _grain : _end;
+    job.m_batch    = &batch;
+
+    push( own < m_queues.size() ? own : m_nextQueue++ % m_queues.size(), job );
+  }
+
+  {
+    std::lock_guard< std::mutex > sl( m_sleepLock );
+  }
+  m_wake.notify_all();
+
+  // help until the batch is done
+  while ( batch.m_remaining != 0 )
+  {
+    if ( runOne( own ) )
+    {
+      continue;
+    }
+
+    std::unique_lock< std::mutex > bl( batch.m_lock );
+    batch.m_done.wait( bl, [ & ](){ return batch.m_remaining == 0; } );
+  }
+
+  // the last job notifies under the lock, wait for it to let go of the batch
+  std::lock_guard< std::mutex > bl( batch.m_lock );
+}
+
+void ThreadPool::workerLoop( size_t _index )
+{
+  t_pool  = this;
+  t_queue = _index;
+
+  char name[ 32 ];
+  sprintf( name, "worker %d", static_cast< int >( _index ) );
+  Profiler::setThreadName( name );
+
+  while ( true )
+  {
+    uint64_t start = Profiler::now();
+
+    if ( runOne( _index ) )
+    {
+      if ( Profiler::enabled() )
+      {
+        Profiler::record( Profiler::PHASE_WORKER_BUSY, start, Profiler::now() );
+      }
+      continue;
+    }
+
+    std::unique_lock< std::mutex > sl( m_sleepLock );
+    m_wake.wait( sl, [ this ](){ return m_stop || m_pending != 0; } );
+
+    if ( m_stop )
+    {
+      return;
+    }
+
+    if ( Profiler::enabled() )
+    {
+      Profiler::record( Profiler::PHASE_WORKER_IDLE, start, Profiler::now() );
+    }
+  }
+}
+
+void ThreadPool::push( size_t _queue, const Job& _job )
+{
+  std::lock_guard< std::mutex > ql( m_queues[ _queue ]->m_lock );
+  m_queues[ _queue ]->m_jobs.push_back( _job );
+  ++m_pending;
+}
+
+bool ThreadPool::pop( size_t _queue, Job& _job )
+{
+  std::lock_guard< std::mutex > ql( m_queues[ _queue ]->m_lock );
+  std::deque< Job >& jobs = m_queues[ _queue ]->m_jobs;
+
+  if ( jobs.empty() )
+  {
+    return false;
+  }
+
+  _job = jobs.back();
+  jobs.pop_back();
+  --m_pending;
+  return true;
+}
+
+bool ThreadPool::steal( size_t _thief, Job& _job )
+{
+  size_t count = m_queues.size();
+
+  for ( size_t i = 1; i <= count; ++i )
+  {
+    size_t victim = ( _thief + i ) % count;
+
+    if ( victim == _thief )
+    {
+      continue;
+    }
+
+    std::lock_guard< std::mutex > ql( m_queues[ victim ]->m_lock );
+    std::deque< Job >& jobs = m_queues[ victim ]->m_jobs;
+
+    if ( !jobs.empty() )
+    {
+      _job = jobs.front();
+      jobs.pop_front();
+      --m_pending;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool ThreadPool::runOne( size_t _queue )
+{
+  Job job;
+
+  if ( ( _queue < m_queues.size() && pop( _queue, job ) ) || steal( _queue, job ) )
+  {
+    run( job );
+    return true;
+  }
+
+  return false;
+}
+
+void ThreadPool::run( const Job& _job )
+{
+  ( *_job.m_function )( _job.m_begin, _job.m_end );
+
+  std::lock_guard< std::mutex > bl( _job.m_batch->m_lock );
+  if ( --_job.m_batch->m_remaining == 0 )
+  {
+    _job.m_batch->m_done.notify_all();
+  }
+}
@@ -0,0 +1,577 @@
+#include "TiledImage.h"
+#include "Epoch.h"
+#include "cinder/ImageIo.h"
+
+#include <cstring>
+#include <algorithm>
+
+#if defined _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define TILED_IMAGE_MAGIC    "FDTILES1"
+#define TILED_IMAGE_CHANNELS 3
+#define TILE_BYTES           ( static_cast< size_t >( TILED_IMAGE_TILE_SIZE ) * TILED_IMAGE_TILE_SIZE * TILED_IMAGE_CHANNELS )
+
+namespace
+{
+  // first bytes of an .ftl, in the byte order of the machine writing it.
+  // the tiles follow at TILED_IMAGE_HEADER, row of tiles after row of
+  // tiles, then the overview as packed rows.
+  struct Header
+  {
+    char     m_magic[ 8 ];
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_tileSize;
+    uint32_t m_channels;
+    uint32_t m_overviewWidth;
+    uint32_t m_overviewHeight;
+    uint64_t m_overviewOffset;
+  };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// a mapped view, unmapped when deleted
+struct TiledImage::Mapping
+{
+  Mapping( void* _view, size_t _size ) : m_view( _view ), m_size( _size ) {}
+
+  ~Mapping()
+  {
+#if defined _WIN32
+    UnmapViewOfFile( m_view );
+#else
+    munmap( m_view, m_size );
+#endif
+  }
+
+  void*  m_view;
+  size_t m_size;
+};
+
+TiledImage::TiledImage( void ) :
+  m_width( 0 ),
+  m_height( 0 ),
+  m_tilesX( 0 ),
+  m_tilesY( 0 ),
+  m_overviewScale( 1.0f ),
+#if defined _WIN32
+  m_file( INVALID_HANDLE_VALUE ),
+  m_fileMapping( 0 ),
+#else
+  m_file( -1 ),
+#endif
+  m_tiles( 0 ),
+  m_lastUse( 0 ),
+  m_clock( 0 ),
+  m_cacheTiles( TILED_IMAGE_CACHE ),
+  m_peakResident( 0 ),
+  m_misses( 0 )
+{
+}
+
+TiledImage::~TiledImage( void )
+{
+  close();
+}
+
+bool TiledImage::open( const ci::fs::path& _path, size_t _cacheTiles )
+{
+  close();
+
+#if defined _WIN32
+  m_file = CreateFileW( _path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, 0 );
+  if ( m_file == INVALID_HANDLE_VALUE )
+  {
+    return false;
+  }
+
+  LARGE_INTEGER fileSize;
+  GetFileSizeEx( m_file, &fileSize );
+  uint64_t size = static_cast< uint64_t >( fileSize.QuadPart );
+
+  m_fileMapping = CreateFileMappingW( m_file, 0, PAGE_READONLY, 0, 0, 0 );
+  if ( !m_fileMapping )
+  {
+    close();
+    return false;
+  }
+#else
+  m_file = ::open( _path.string().c_str(), O_RDONLY );
+  if ( m_file < 0 )
+  {
+    return false;
+  }
+
+  struct stat status;
+  fstat( m_file, &status );
+  uint64_t size = static_cast< uint64_t >( status.st_size );
+#endif
+
+  Header   header;
+  Mapping* headerView = size >= TILED_IMAGE_HEADER ? map( 0, TILED_IMAGE_HEADER ) : 0;
+
+  if ( !headerView )
+  {
+    close();
+    return false;
+  }
+
+  memcpy( &header, headerView->m_view, sizeof( header ) );
+  delete headerView;
+
+  size_t   tilesX       = ( header.m_width  + TILED_IMAGE_TILE_SIZE - 1 ) / TILED_IMAGE_TILE_SIZE;
+  size_t   tilesY       = ( header.m_height + TILED_IMAGE_TILE_SIZE - 1 ) / TILED_IMAGE_TILE_SIZE;
+  uint64_t overviewSize = static_cast< uint64_t >( header.m_overviewWidth ) * header.m_overviewHeight * TILED_IMAGE_CHANNELS;
+
+  if ( memcmp( header.m_magic, TILED_IMAGE_MAGIC, 8 ) != 0 || header.m_tileSize != TILED_IMAGE_TILE_SIZE || header.m_channels != TILED_IMAGE_CHANNELS ||
+       header.m_width == 0 || header.m_height == 0 || header.m_overviewWidth == 0 || header.m_overviewHeight == 0 ||
+       header.m_overviewOffset != TILED_IMAGE_HEADER + static_cast< uint64_t >( tilesX ) * tilesY * TILE_BYTES ||
+       size < header.m_overviewOffset + overviewSize )
+  {
+    close();
+    return false;
+  }
+
+  m_width         = static_cast< int >( header.m_width );
+  m_height        = static_cast< int >( header.m_height );
+  m_tilesX        = tilesX;
+  m_tilesY        = tilesY;
+  m_overviewScale = static_cast< float >( header.m_overviewWidth ) / m_width;
+
+  // the overview is small, it is copied out once
+  Mapping* overviewView = map( header.m_overviewOffset, static_cast< size_t >( overviewSize ) );
+
+  if ( !overviewView )
+  {
+    close();
+    return false;
+  }
+
+  m_overview = ci::Surface( header.m_overviewWidth, header.m_overviewHeight, false );
+
+  const uint8_t* packed  = static_cast< const uint8_t* >( overviewView->m_view );
+  uint8_t        inc     = m_overview.getPixelInc();
+  uint8_t        offsets[ 3 ] = { m_overview.getRedOffset(), m_overview.getGreenOffset(), m_overview.getBlueOffset() };
+
+  for ( int y = 0; y < m_overview.getHeight(); ++y )
+  {
+    uint8_t* pixel = m_overview.getData( ci::Vec2i( 0, y ) );
+
+    for ( int x = 0; x < m_overview.getWidth(); ++x, pixel += inc, packed += TILED_IMAGE_CHANNELS )
+    {
+      pixel[ offsets[ 0 ] ] = packed[ 0 ];
+      pixel[ offsets[ 1 ] ] = packed[ 1 ];
+      pixel[ offsets[ 2 ] ] = packed[ 2 ];
+    }
+  }
+  delete overviewView;
+
+  size_t tiles = m_tilesX * m_tilesY;
+
+  m_tiles   = new std::atomic< const uint8_t* >[ tiles ];
+  m_lastUse = new std::atomic< uint32_t >[ tiles ];
+  for ( size_t i = 0; i < tiles; ++i )
+  {
+    m_tiles[ i ].store( 0 );
+    m_lastUse[ i ].store( 0 );
+  }
+  m_mappings.assign( tiles, 0 );
+
+  m_cacheTiles   = std::max< size_t >( _cacheTiles, 1 );
+  m_peakResident = 0;
+  m_misses       = 0;
+  m_resident.clear();
+  m_resident.reserve( m_cacheTiles );
+
+  return true;
+}
+
+void TiledImage::close()
+{
+  // nothing reads the tiles any more, they are unmapped right away
+  for ( size_t i = 0; i < m_mappings.size(); ++i )
+  {
+    delete m_mappings[ i ];
+  }
+  m_mappings.clear();
+  m_resident.clear();
+
+  delete[] m_tiles;
+  delete[] m_lastUse;
+  m_tiles   = 0;
+  m_lastUse = 0;
+
+#if defined _WIN32
+  if ( m_fileMapping )
+  {
+    CloseHandle( m_fileMapping );
+    m_fileMapping = 0;
+  }
+  if ( m_file != INVALID_HANDLE_VALUE )
+  {
+    CloseHandle( m_file );
+    m_file = INVALID_HANDLE_VALUE;
+  }
+#else
+  if ( m_file >= 0 )
+  {
+    ::close( m_file );
+    m_file = -1;
+  }
+#endif
+
+  m_width    = 0;
+  m_height   = 0;
+  m_tilesX   = 0;
+  m_tilesY   = 0;
+  m_overview = ci::Surface();
+}
+
+size_t TiledImage::resident() const
+{
+  std::lock_guard< std::mutex > lock( m_lock );
+  return m_resident.size();
+}
+
+TiledImage::Mapping* TiledImage::map( uint64_t _offset, size_t _size ) const
+{
+#if defined _WIN32
+  void* view = MapViewOfFile( m_fileMapping, FILE_MAP_READ, static_cast< DWORD >( _offset >> 32 ), static_cast< DWORD >( _offset & 0xffffffff ), _size );
+
+  return view ? new Mapping( view, _size ) : 0;
+#else
+  void* view = mmap( 0, _size, PROT_READ, MAP_SHARED, m_file, static_cast< off_t >( _offset ) );
+
+  return view != MAP_FAILED ? new Mapping( view, _size ) : 0;
+#endif
+}
+
+const uint8_t* TiledImage::loadTile( size_t _index ) const
+{
+  std::lock_guard< std::mutex > lock( m_lock );
+
+  // another reader may have mapped it while this one waited
+  const uint8_t* tile = m_tiles[ _index ].load();
+
+  if ( tile )
+  {
+    return tile;
+  }
+
+  // full: the least recently used tile goes, readers still holding it
+  // keep it mapped until they unpin
+  if ( m_resident.size() >= m_cacheTiles )
+  {
+    size_t oldest = 0;
+
+    for ( size_t i = 1; i < m_resident.size(); ++i )
+    {
+      if ( m_lastUse[ m_resident[ i ] ].load( std::memory_order_relaxed ) < m_lastUse[ m_resident[ oldest ] ].load( std::memory_order_relaxed ) )
+      {
+        oldest = i;
+      }
+    }
+
+    size_t evicted = m_resident[ oldest ];
+
+    m_tiles[ evicted ].store( 0 );
+    Epoch::retire( m_mappings[ evicted ] );
+    m_mappings[ evicted ]  = 0;
+    m_resident[ oldest ]   = m_resident.back();
+    m_resident.pop_back();
+  }
+
+  Mapping* mapping = map( TILED_IMAGE_HEADER + static_cast< uint64_t >( _index ) * TILE_BYTES, TILE_BYTES );
+
+  // out of address space, or the file shrank under us: black is better
+  // than a crash
+  if ( !mapping )
+  {
+    static const uint8_t s_black[ TILE_BYTES ] = { 0 };
+    return s_black;
+  }
+
+  tile                  = static_cast< const uint8_t* >( mapping->m_view );
+  m_mappings[ _index ]  = mapping;
+  m_lastUse[ _index ].store( m_clock.fetch_add( 1 ) + 1, std::memory_order_relaxed );
+  m_tiles[ _index ].store( tile );
+  m_resident.push_back( _index );
+
+  m_peakResident = std::max( m_peakResident, m_resident.size() );
+  ++m_misses;
+
+  return tile;
+}
+
+bool TiledImage::create( const ci::fs::path& _source, const ci::fs::path& _destination, const ci::Vec2i& _rawSize )
+{
+  TiledImageWriter writer;
+
+  if ( _rawSize.x > 0 && _rawSize.y > 0 )
+  {
+    FILE* file = 0;
+
+    if ( _source == "-" )
+    {
+#if defined _WIN32
+      _setmode( _fileno( stdin ), _O_BINARY );
+#endif
+      file = stdin;
+    }
+    else
+    {
+      file = fopen( _source.string().c_str(), "rb" );
+    }
+
+    if ( !file || !writer.open( _destination, _rawSize.x, _rawSize.y ) )
+    {
+      if ( file && file != stdin )
+      {
+        fclose( file );
+      }
+      return false;
+    }
+
+    std::vector< uint8_t > row( static_cast< size_t >( _rawSize.x ) * TILED_IMAGE_CHANNELS );
+    bool                   complete = true;
+
+    for ( int y = 0; y < _rawSize.y && complete; ++y )
+    {
+      complete = fread( &row[ 0 ], 1, row.size(), file ) == row.size() && writer.addRow( &row[ 0 ] );
+    }
+
+    if ( file != stdin )
+    {
+      fclose( file );
+    }
+
+    return writer.close() && complete;
+  }
+
+  ci::Surface image;
+
+  try
+  {
+    image = ci::loadImage( _source );
+  }
+  catch ( ... )
+  {
+    return false;
+  }
+
+  if ( !image || !writer.open( _destination, image.getWidth(), image.getHeight() ) )
+  {
+    return false;
+  }
+
+  std::vector< uint8_t > row( static_cast< size_t >( image.getWidth() ) * TILED_IMAGE_CHANNELS );
+  uint8_t                inc     = image.getPixelInc();
+  uint8_t                offsets[ 3 ] = { image.getRedOffset(), image.getGreenOffset(), image.getBlueOffset() };
+
+  for ( int y = 0; y < image.getHeight(); ++y )
+  {
+    const uint8_t* pixel = image.getData( ci::Vec2i( 0, y ) );
+
+    for ( int x = 0; x < image.getWidth(); ++x, pixel += inc )
+    {
+      row[ x * 3 + 0 ] = pixel[ offsets[ 0 ] ];
+      row[ x * 3 + 1 ] = pixel[ offsets[ 1 ] ];
+      row[ x * 3 + 2 ] = pixel[ offsets[ 2 ] ];
+    }
+
+    if ( !writer.addRow( &row[ 0 ] ) )
+    {
+      writer.close();
+      return false;
+    }
+  }
+
+  return writer.close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+TiledImageWriter::TiledImageWriter( void ) :
+  m_file( 0 ),
+  m_width( 0 ),
+  m_height( 0 ),
+  m_row( 0 ),
+  m_failed( false ),
+  m_tilesX( 0 ),
+  m_overviewWidth( 0 ),
+  m_overviewHeight( 0 ),
+  m_overviewRow( 0 )
+{
+}
+
+TiledImageWriter::~TiledImageWriter( void )
+{
+  if ( m_file )
+  {
+    fclose( m_file );
+  }
+}
+
+bool TiledImageWriter::open( const ci::fs::path& _path, int _width, int _height )
+{
+  if ( m_file || _width <= 0 || _height <= 0 )
+  {
+    return false;
+  }
+
+  m_file = fopen( _path.string().c_str(), "wb" );
+  if ( !m_file )
+  {
+    return false;
+  }
+
+  m_width  = _width;
+  m_height = _height;
+  m_row    = 0;
+  m_failed = false;
+  m_tilesX = ( _width + TILED_IMAGE_TILE_SIZE - 1 ) / TILED_IMAGE_TILE_SIZE;
+  m_band.assign( m_tilesX * TILE_BYTES, 0 );
+
+  // the overview keeps the aspect, never larger than the image
+  float scale = std::min( 1.0f, static_cast< float >( TILED_IMAGE_OVERVIEW ) / std::max( _width, _height ) );
+
+  m_overviewWidth  = std::max( 1, static_cast< int >( _width  * scale + 0.5f ) );
+  m_overviewHeight = std::max( 1, static_cast< int >( _height * scale + 0.5f ) );
+  m_overviewRow    = 0;
+  m_overviewColumn.resize( _width );
+  for ( int x = 0; x < _width; ++x )
+  {
+    m_overviewColumn[ x ] = static_cast< int >( static_cast< int64_t >( x ) * m_overviewWidth / _width );
+  }
+  m_overviewSums.assign( m_overviewWidth * TILED_IMAGE_CHANNELS, 0 );
+  m_overviewCounts.assign( m_overviewWidth, 0 );
+  m_overview.clear();
+  m_overview.reserve( static_cast< size_t >( m_overviewWidth ) * m_overviewHeight * TILED_IMAGE_CHANNELS );
+
+  // the header is written last, when the rows are all there
+  std::vector< uint8_t > header( TILED_IMAGE_HEADER, 0 );
+  return fwrite( &header[ 0 ], 1, header.size(), m_file ) == header.size();
+}
+
+bool TiledImageWriter::addRow( const uint8_t* _rgb )
+{
+  if ( !m_file || m_row >= m_height )
+  {
+    return false;
+  }
+
+  // into the tiles of the band
+  int      rowInTile = m_row & ( TILED_IMAGE_TILE_SIZE - 1 );
+  uint8_t* band      = &m_band[ 0 ];
+
+  for ( size_t t = 0; t < m_tilesX; ++t )
+  {
+    int x0    = static_cast< int >( t ) * TILED_IMAGE_TILE_SIZE;
+    int count = std::min( TILED_IMAGE_TILE_SIZE, m_width - x0 );
+
+    memcpy( band + t * TILE_BYTES + static_cast< size_t >( rowInTile ) * TILED_IMAGE_TILE_SIZE * TILED_IMAGE_CHANNELS, _rgb + static_cast< size_t >( x0 ) * TILED_IMAGE_CHANNELS, count * TILED_IMAGE_CHANNELS );
+  }
+
+  // and into the box sums of the overview row it falls in
+  int overviewRow = static_cast< int >( static_cast< int64_t >( m_row ) * m_overviewHeight / m_height );
+
+  if ( overviewRow != m_overviewRow )
+  {
+    flushOverviewRow();
+    m_overviewRow = overviewRow;
+  }
+
+  for ( int x = 0; x < m_width; ++x )
+  {
+    int column = m_overviewColumn[ x ];
+
+    m_overviewSums[ column * 3 + 0 ] += _rgb[ x * 3 + 0 ];
+    m_overviewSums[ column * 3 + 1 ] += _rgb[ x * 3 + 1 ];
+    m_overviewSums[ column * 3 + 2 ] += _rgb[ x * 3 + 2 ];
+    ++m_overviewCounts[ column ];
+  }
+
+  ++m_row;
+
+  if ( rowInTile == TILED_IMAGE_TILE_SIZE - 1 || m_row == m_height )
+  {
+    return flushBand();
+  }
+
+  return true;
+}
+
+bool TiledImageWriter::flushBand()
+{
+  bool written = fwrite( &m_band[ 0 ], 1, m_band.size(), m_file ) == m_band.size();
+
+  m_failed = m_failed || !written;
+  std::fill( m_band.begin(), m_band.end(), 0 );
+  return written;
+}
+
+void TiledImageWriter::flushOverviewRow()
+{
+  for ( int x = 0; x < m_overviewWidth; ++x )
+  {
+    uint32_t count = std::max< uint32_t >( m_overviewCounts[ x ], 1 );
+
+    for ( int c = 0; c < TILED_IMAGE_CHANNELS; ++c )
+    {
+      m_overview.push_back( static_cast< uint8_t >( ( m_overviewSums[ x * 3 + c ] + count / 2 ) / count ) );
+    }
+  }
+
+  std::fill( m_overviewSums.begin(), m_overviewSums.end(), 0 );
+  std::fill( m_overviewCounts.begin(), m_overviewCounts.end(), 0 );
+}
+
+bool TiledImageWriter::close()
+{
+  if ( !m_file )
+  {
+    return false;
+  }
+
+  bool complete = m_row == m_height && !m_failed;
+
+  if ( complete )
+  {
+    flushOverviewRow();
+
+    Header header;
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.m_magic, TILED_IMAGE_MAGIC, 8 );
+    header.m_width          = static_cast< uint32_t >( m_width );
+    header.m_height         = static_cast< uint32_t >( m_height );
+    header.m_tileSize       = TILED_IMAGE_TILE_SIZE;
+    header.m_channels       = TILED_IMAGE_CHANNELS;
+    header.m_overviewWidth  = static_cast< uint32_t >( m_overviewWidth );
+    header.m_overviewHeight = static_cast< uint32_t >( m_overviewHeight );
+    header.m_overviewOffset = TILED_IMAGE_HEADER + static_cast< uint64_t >( m_tilesX ) * ( ( m_height + TILED_IMAGE_TILE_SIZE - 1 ) / TILED_IMAGE_TILE_SIZE ) * TILE_BYTES;
+
+    complete = fwrite( &m_overview[ 0 ], 1, m_overview.size(), m_file ) == m_overview.size() &&
+               fseek( m_file, 0, SEEK_SET ) == 0 &&
+               fwrite( &header, 1, sizeof( header ), m_file ) == sizeof( header );
+  }
+
+  complete = fclose( m_file ) == 0 && complete;
+  m_file   = 0;
+
+  m_band.clear();
+  m_overview.clear();
+
+  return complete;
+}